@@ -0,0 +1,13 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+// Host stand-in for <avr/interrupt.h>: an ISR becomes a plain function
+// that the benchmarks call directly
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define cli() ((void)0)
+#define sei() ((void)0)
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+// Host stand-in for <avr/io.h>. Peripherals are plain structs (defined in
+// bench/host.c) with the register names the firmware uses, so the sources
+// compile unchanged; only the registers and bit masks used are provided.
+
+#include <stdint.h>
+#ifndef F_CPU
+#define F_CPU 3333333UL
+#endif
+typedef volatile uint8_t reg8_t;
+typedef volatile uint16_t reg16_t;
+
+typedef struct { reg8_t DIR,DIRSET,DIRCLR,DIRTGL,OUT,OUTSET,OUTCLR,OUTTGL,IN,INTFLAGS,PORTCTRL,PIN0CTRL,PIN1CTRL,PIN2CTRL,PIN3CTRL,PIN4CTRL,PIN5CTRL,PIN6CTRL,PIN7CTRL; } PORT_t;
+typedef struct { reg8_t DIR,OUT,IN,INTFLAGS; } VPORT_t;
+typedef struct { reg8_t SPIROUTEA,TCAROUTEA,USARTROUTEA,EVSYSROUTEA,TCBROUTEA; } PORTMUX_t;
+typedef struct { reg8_t CTRLA,CTRLB,INTCTRL,INTFLAGS,DATA; } SPI_t;
+typedef struct { reg8_t CTRLA,CTRLB,CTRLC,CTRLD,CTRLECLR,CTRLESET,EVCTRL,INTCTRL,INTFLAGS,DBGCTRL,TEMP; reg16_t CNT,PER,CMP0,CMP1,CMP2,PERBUF,CMP0BUF,CMP1BUF,CMP2BUF; } TCA_SINGLE_t;
+typedef union { TCA_SINGLE_t SINGLE; } TCA_t;
+typedef struct { reg8_t CTRLA,CTRLB,EVCTRL,INTCTRL,INTFLAGS,STATUS,DBGCTRL,TEMP; reg16_t CNT,CCMP; } TCB_t;
+typedef struct { reg8_t CTRLA,CTRLB,CTRLC,CTRLD,STATUS,RXDATAL,RXDATAH,TXDATAL,TXDATAH,DBGCTRL,EVCTRL,TXPLCTRL,RXPLCTRL; reg16_t BAUD; } USART_t;
+typedef struct { reg8_t CTRLA,CTRLB,CTRLC,CTRLD,CTRLE,CTRLF,COMMAND,EVCTRL,INTCTRL,INTFLAGS,STATUS,MUXPOS,MUXNEG,RESULT0,RESULT1; reg16_t RESULT; } ADC_t;
+typedef struct { reg8_t SWEVENTA,SWEVENTB,CHANNEL0,CHANNEL1,CHANNEL2,CHANNEL3,CHANNEL4,CHANNEL5,USERTCB0CAPT,USERTCB0COUNT,USERTCB1CAPT,USERTCB1COUNT,USERTCA0CNTA; } EVSYS_t;
+typedef struct { reg8_t CTRLA,CTRLB,STATUS,INTCTRL,INTFLAGS,DATAL,DATAH; reg16_t ADDR,DATA; } NVMCTRL_t;
+typedef struct { reg8_t CTRLA,STATUS,INTCTRL,INTFLAGS,TEMP,DBGCTRL,CALIB,CLKSEL,PITCTRLA,PITSTATUS,PITINTCTRL,PITINTFLAGS,PITDBGCTRL; reg16_t CNT,PER,CMP; } RTC_t;
+typedef struct { reg8_t MCLKCTRLA,MCLKCTRLB,MCLKLOCK,MCLKSTATUS; } CLKCTRL_t;
+typedef struct { reg8_t CTRLA; } SLPCTRL_t;
+typedef struct { reg8_t RSTFR,SWRR; } RSTCTRL_t;
+
+extern PORT_t PORTA,PORTB,PORTC; extern VPORT_t VPORTA,VPORTB,VPORTC; extern PORTMUX_t PORTMUX; extern SPI_t SPI0; extern TCA_t TCA0; extern TCB_t TCB0,TCB1;
+extern USART_t USART0; extern ADC_t ADC0; extern EVSYS_t EVSYS; extern NVMCTRL_t NVMCTRL; extern RTC_t RTC; extern CLKCTRL_t CLKCTRL; extern SLPCTRL_t SLPCTRL; extern RSTCTRL_t RSTCTRL;
+extern reg8_t GPIOR0,GPIOR1,GPIOR2,GPIOR3, CPU_SREG, CCP; extern reg16_t SP;
+
+#define _SFR_IO_ADDR(x) 0
+#define EEPROM_START 0x1400
+#define EEPROM_SIZE 256
+#define EEPROM_PAGE_SIZE 32
+#define MAPPED_EEPROM_START 0x1400
+#define RAMSTART 0x3800
+#define RAMEND 0x3FFF
+#define RAMSIZE 2048
+#define CPU_I_bm 0x80
+#define PIN0_bm 1
+#define PIN1_bm 2
+#define PIN2_bm 4
+#define PIN3_bm 8
+#define PIN4_bm 16
+#define PIN5_bm 32
+#define PIN6_bm 64
+#define PIN7_bm 128
+#define PIN4_bp 4
+#define PIN5_bp 5
+#define PIN6_bp 6
+#define PIN7_bp 7
+#define PORT_PULLUPEN_bm 8
+#define PORT_ISC_gm 7
+#define PORT_ISC_INTDISABLE_gc 0
+#define PORT_ISC_BOTHEDGES_gc 1
+#define PORT_ISC_RISING_gc 2
+#define PORT_ISC_FALLING_gc 3
+#define PORTMUX_SPI0_ALT1_gc 1
+#define PORTMUX_TCA00_DEFAULT_gc 0
+#define SPI_MASTER_bm 0x20
+#define SPI_ENABLE_bm 1
+#define SPI_SSD_bm 4
+#define SPI_IE_bm 1
+#define SPI_IF_bm 0x80
+#define TCA_SINGLE_WGMODE_SINGLESLOPE_gc 3
+#define TCA_SINGLE_CMP0EN_bm 0x10
+#define TCA_SINGLE_ENABLE_bm 1
+#define TCA_SINGLE_CLKSEL_DIV1_gc 0
+#define TCA_SINGLE_CLKSEL_DIV2_gc 2
+#define TCB_CNTMODE_INT_gc 0
+#define TCB_CNTMODE_TIMEOUT_gc 1
+#define TCB_CNTMODE_CAPT_gc 2
+#define TCB_CNTMODE_FRQ_gc 3
+#define TCB_CNTMODE_PW_gc 4
+#define TCB_CNTMODE_FRQPW_gc 5
+#define TCB_CNTMODE_SINGLE_gc 6
+#define TCB_CNTMODE_PWM8_gc 7
+#define TCB_CAPT_bm 1
+#define TCB_OVF_bm 2
+#define TCB_ENABLE_bm 1
+#define TCB_CASCADE_bm 0x20
+#define TCB_CLKSEL_DIV1_gc 0
+#define TCB_CLKSEL_DIV2_gc 2
+#define TCB_CLKSEL_TCA0_gc 4
+#define TCB_CLKSEL_EVENT_gc 0x0E
+#define TCB_CAPTEI_bm 1
+#define TCB_EDGE_bm 0x10
+#define TCB_FILTER_bm 0x40
+#define TCB_RUNSTDBY_bm 0x40
+#define USART_RXCIE_bm 0x80
+#define USART_TXCIE_bm 0x40
+#define USART_DREIE_bm 0x20
+#define USART_RXEN_bm 0x80
+#define USART_TXEN_bm 0x40
+#define USART_DREIF_bm 0x20
+#define USART_TXCIF_bm 0x40
+#define USART_RXCIF_bm 0x80
+#define ADC_ENABLE_bm 1
+#define ADC_PRESC_DIV2_gc 0
+#define ADC_TIMEBASE_gp 3
+#define ADC_REFSEL_VDD_gc 0
+#define ADC_LEFTADJ_bm 0x10
+#define ADC_MUXPOS_AIN2_gc 2
+#define ADC_MODE_SINGLE_8BIT_gc 0
+#define ADC_START_IMMEDIATE_gc 1
+#define ADC_RESRDY_bm 1
+#define EVSYS_CHANNEL0_PORTA_PIN4_gc 0x44
+#define EVSYS_CHANNEL0_PORTA_PIN5_gc 0x45
+#define EVSYS_CHANNEL0_TCB0_CAPT_gc 0xA0
+#define EVSYS_CHANNEL0_TCB0_OVF_gc 0xA1
+#define EVSYS_CHANNEL1_TCB0_OVF_gc 0xA1
+#define EVSYS_CHANNEL2_TCB0_OVF_gc 0xA1
+#define EVSYS_USER_CHANNEL0_gc 1
+#define EVSYS_USER_CHANNEL1_gc 2
+#define EVSYS_USER_CHANNEL2_gc 3
+#define NVMCTRL_CMD_gm 0x7F
+#define NVMCTRL_CMD_NONE_gc 0
+#define NVMCTRL_CMD_PAGEERASEWRITE_gc 3
+#define NVMCTRL_CMD_PAGEWRITE_gc 1
+#define NVMCTRL_CMD_PAGEERASE_gc 2
+#define NVMCTRL_CMD_PAGEBUFCLR_gc 4
+#define NVMCTRL_EEREADY_bm 1
+#define NVMCTRL_EEBUSY_bm 2
+#define NVMCTRL_FBUSY_bm 1
+#define CCP_SPM_gc 0x9D
+#define RTC_RTCEN_bm 1
+#define RTC_PRESCALER_DIV1_gc 0
+#define RTC_PRESCALER_DIV32_gc 0x28
+#define RTC_CLKSEL_INT32K_gc 0
+#define RTC_CMP_bm 2
+#define RTC_OVF_bm 1
+#define RTC_CTRLABUSY_bm 1
+#define RTC_CNTBUSY_bm 2
+#define RSTCTRL_PORF_bm 1
+#define SLPCTRL_SEN_bm 1
+#define SLPCTRL_SMODE_IDLE_gc 0
+
+extern reg8_t SREG;
+#define _PROTECTED_WRITE_SPM(reg, value) ((reg) = (value))
+#define _PROTECTED_WRITE(reg, value) ((reg) = (value))
+
+// The memory-mapped EEPROM is an array on the host
+extern uint8_t host_eeprom[EEPROM_SIZE];
+#undef MAPPED_EEPROM_START
+#define MAPPED_EEPROM_START ((uintptr_t)host_eeprom)
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_STDLIB_H
+#define HOST_STDLIB_H
+
+// The host C library plus the avr-libc conversions the firmware uses
+// (defined in bench/host.c)
+
+#include_next <stdlib.h>
+
+char *itoa(int value, char *buf, int radix);
+char *ultoa(unsigned long value, char *buf, int radix);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+// Runs every registered benchmark (or those whose name contains one of the
+// command-line arguments) and prints one JSON object per line:
+//   {"name": "...", "iterations": N, "ns_per_op": x, "allocs_per_op": y}
+// With -t first it runs the tests instead, printing "ok <name>" or
+// "FAIL <name>" after each, and exits 1 if any failed.
+
+#ifndef BENCH_MIN_NS
+#define BENCH_MIN_NS 200000000ULL // 0.2 s per benchmark
+#endif
+#define BENCH_MAX 64
+#define TEST_MAX 64
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+} bench_t;
+
+typedef struct {
+    const char *name;
+    test_fn_t fn;
+} test_t;
+
+static bench_t benches[BENCH_MAX];
+static int bench_count = 0;
+static test_t tests[TEST_MAX];
+static int test_count = 0;
+static const char *test_running;
+static unsigned long test_failures;
+
+volatile uint32_t bench_sink;
+
+void bench_register(const char *name, bench_fn_t fn)
+{
+    if (bench_count == BENCH_MAX) {
+        fprintf(stderr, "bench: too many benchmarks, raise BENCH_MAX\n");
+        exit(1);
+    }
+    benches[bench_count].name = name;
+    benches[bench_count].fn = fn;
+    bench_count++;
+}
+
+void test_register(const char *name, test_fn_t fn)
+{
+    if (test_count == TEST_MAX) {
+        fprintf(stderr, "bench: too many tests, raise TEST_MAX\n");
+        exit(1);
+    }
+    tests[test_count].name = name;
+    tests[test_count].fn = fn;
+    test_count++;
+}
+
+void test_fail(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", test_running);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    test_failures++;
+}
+
+// ----------------------  ALLOCATION COUNTING  ----------------------
+
+// The link wraps the heap functions (-Wl,--wrap=malloc,...), so any heap
+// use by the code under test shows up in allocs_per_op
+static unsigned long allocations = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+// ----------------------  RUNNER  ----------------------
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int selected(const char *name, int argc, char **argv)
+{
+    if (argc < 2) return 1;
+    for (int i = 1; i < argc; i++)
+        if (strstr(name, argv[i])) return 1;
+    return 0;
+}
+
+static void run(const bench_t *b)
+{
+    uint32_t n = 1;
+    unsigned long long elapsed;
+    unsigned long allocs;
+    b->fn(1); // Warm up
+    for (;;) {
+        allocations = 0;
+        unsigned long long start = now_ns();
+        b->fn(n);
+        elapsed = now_ns() - start;
+        allocs = allocations;
+        if (elapsed >= BENCH_MIN_NS || n >= 0x80000000UL) break;
+        // Aim a little past the minimum so the next run is usually the last
+        unsigned long long next = elapsed ? (unsigned long long)n * BENCH_MIN_NS * 6 / 5 / elapsed : n * 100ULL;
+        if (next <= n) next = n * 2ULL;
+        if (next > 0x80000000UL) next = 0x80000000UL;
+        n = next;
+    }
+    printf("{\"name\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f}\n",
+           b->name, n, (double)elapsed / n, (double)allocs / n);
+    fflush(stdout);
+}
+
+// ----------------------  TESTS  ----------------------
+
+static int run_tests(int argc, char **argv)
+{
+    int run = 0, failed = 0;
+    for (int i = 0; i < test_count; i++) {
+        if (!selected(tests[i].name, argc, argv)) continue;
+        unsigned long before = test_failures;
+        test_running = tests[i].name;
+        tests[i].fn();
+        run++;
+        if (test_failures != before) failed++;
+        printf("%s %s\n", test_failures != before ? "FAIL" : "ok", tests[i].name);
+        fflush(stdout);
+    }
+    printf("%d tests, %d failed\n", run, failed);
+    return failed ? 1 : 0;
+}
+
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(((const bench_t *)a)->name, ((const bench_t *)b)->name);
+}
+
+static int test_by_name(const void *a, const void *b)
+{
+    return strcmp(((const test_t *)a)->name, ((const test_t *)b)->name);
+}
+
+int main(int argc, char **argv)
+{
+    // Constructor order is up to the linker; report in a stable order
+    qsort(benches, bench_count, sizeof(bench_t), by_name);
+    qsort(tests, test_count, sizeof(test_t), test_by_name);
+    if (argc > 1 && !strcmp(argv[1], "-t"))
+        return run_tests(argc - 1, argv + 1);
+    for (int i = 0; i < bench_count; i++)
+        if (selected(benches[i].name, argc, argv))
+            run(&benches[i]);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Host micro-benchmarks of the firmware's pure logic. A benchmark is a
+// function running its operation n times:
+//
+//     BENCH(simon_get_next_step) {
+//         for (uint32_t i = 0; i < n; i++) bench_sink += get_next_step();
+//     }
+//
+// BENCH registers it at startup; the runner picks n so each benchmark runs
+// for at least BENCH_MIN_NS and reports ns/op and heap allocations/op.
+// Benchmarks reach a unit's static functions by including its .c file.
+
+typedef void (*bench_fn_t)(uint32_t n);
+
+void bench_register(const char *name, bench_fn_t fn);
+
+#define BENCH(name)                                                         \
+    static void bench_##name(uint32_t n);                                   \
+    __attribute__((constructor)) static void bench_register_##name(void)    \
+    {                                                                       \
+        bench_register(#name, bench_##name);                                \
+    }                                                                       \
+    static void bench_##name(uint32_t n)
+
+// Results are accumulated here so the work is not optimised away
+extern volatile uint32_t bench_sink;
+
+// Host tests sit beside the benchmarks and reach the same units, but run
+// once and untimed (bench -t, make -C bench test):
+//
+//     TEST(timer_millis_isr_between_bytes) {
+//         if (ms != want) test_fail("read %lu, want %lu", ms, want);
+//     }
+//
+// A failed check is reported and the test carries on; the runner exits 1
+// if any failed. Checks stay out of BENCH() loops so they are not timed.
+
+typedef void (*test_fn_t)(void);
+
+void test_register(const char *name, test_fn_t fn);
+void test_fail(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#define TEST(name)                                                          \
+    static void test_##name(void);                                          \
+    __attribute__((constructor)) static void test_register_##name(void)     \
+    {                                                                       \
+        test_register(#name, test_##name);                                  \
+    }                                                                       \
+    static void test_##name(void)
+
+#endif
@@ -0,0 +1,21 @@
+#include "bench.h"
+#include "bus.h"
+
+// ----------------------  QUEUES  ----------------------
+
+// One message through BUS_GAME, as a UART or button press takes it
+BENCH(bus_post_get) {
+    msg_t msg;
+    for (uint32_t i = 0; i < n; i++) {
+        bus_post(BUS_GAME, MSG_UART_BUTTON, i & 3);
+        bus_get(BUS_GAME, &msg);
+        bench_sink += msg.arg;
+    }
+}
+
+// Polling an empty queue, as the owners do on almost every loop pass
+BENCH(bus_get_empty) {
+    msg_t msg;
+    for (uint32_t i = 0; i < n; i++)
+        bench_sink += bus_get(BUS_GAME, &msg);
+}
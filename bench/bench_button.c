@@ -0,0 +1,216 @@
+#include "bench.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include "button_modes.h"
+#include "../src/button.c"
+
+// ----------------------  DEBOUNCE  ----------------------
+
+// One TCB1 tick of the debounce with the pins changing every few ticks,
+// draining the button messages it leads to
+BENCH(button_debounce_tick) {
+    msg_t msg;
+    for (uint32_t i = 0; i < n; i++) {
+        PORTA.IN = (i & 0x40) ? 0xFF : (uint8_t)~(0x10 << ((i >> 7) & 3));
+        button_debounce_tick();
+        update_button_states();
+        while (bus_get(BUS_GAME, &msg))
+            bench_sink += msg.type;
+    }
+}
+
+// ----------------------  BOUNCE TRACES  ----------------------
+
+static void vertical_init(void)
+{
+    PORTA.IN = 0xFF;
+    buttons_init();
+    PORTA.INTFLAGS = 0;
+    count0 = count1 = 0;
+    pin_edge_stamped = pin_edge_recent = pin_edge_quiet = 0;
+}
+
+// Falling edges only, as the pins are set up in this mode
+static void vertical_pin_change(void)
+{
+    PORTA.INTFLAGS &= ~PORTA.IN;
+    PORTA_PORT_vect();
+    PORTA.INTFLAGS = 0;
+}
+
+static uint8_t vertical_debounced(void)
+{
+    return pb_debounced_state;
+}
+
+static uint8_t vertical_locked(void)
+{
+    return 0;
+}
+
+const button_mode_t button_mode_vertical = {
+    "vertical", vertical_init, button_debounce_tick, vertical_pin_change, vertical_debounced,
+    vertical_locked,
+};
+
+static uint32_t trace_us;     // Time in the replay
+static uint32_t press_edge_us; // Passed with the last press
+static uint8_t press_count;
+
+void button_trace_press(uint8_t pressed, uint32_t edge_us)
+{
+    press_edge_us = edge_us;
+    press_count++;
+}
+
+uint32_t button_trace_micros(void)
+{
+    return trace_us;
+}
+
+// The times a button's pin changes level, in us from the first press
+// edge, starting released; every trace ends released. The bounce is
+// shaped after scope captures of tactile switches: a few sub-millisecond
+// bounces on a good switch, several milliseconds on a worn one, and a
+// contact that opens again long after it settled. spurious is the number
+// of accepted edges beyond one press and one release per real press, and
+// edges[press] is where the first real press starts.
+typedef struct {
+    const char *name;
+    uint8_t presses;
+    uint8_t press;
+    uint8_t spurious_vertical;
+    uint8_t spurious_edge;
+    uint8_t count;
+    uint32_t edges[16];
+} button_trace_t;
+
+static const button_trace_t traces[] = {
+    {"clean", 1, 0, 0, 0, 2, {0, 150000}},
+    {"bounce 1ms", 1, 0, 0, 0, 8, {0, 200, 450, 600, 900, 150000, 150300, 150500}},
+    {"bounce 5ms", 1, 0, 0, 0, 12,
+     {0, 700, 1500, 2600, 3100, 4300, 4700, 120000, 121200, 122500, 124800, 125300}},
+    {"release chatter 12ms", 1, 0, 0, 0, 6, {0, 100000, 103000, 106500, 110000, 112000}},
+    {"reopens after 24ms", 1, 0, 0, 2, 6, {0, 100000, 100400, 108000, 124000, 124300}},
+    {"2ms glitch", 0, 0, 0, 2, 2, {0, 2000}},
+    {"glitch, press 30ms on", 1, 2, 0, 2, 4, {0, 2000, 30000, 150000}},
+};
+
+#define TRACE_START_US 20000 // Ticks run this long before the first edge
+#define TRACE_SETTLE_US 100000
+#define TICK_US 5000
+
+typedef struct {
+    uint8_t presses;
+    uint8_t releases;
+    int32_t latency_us;        // Press start to the first accepted press,
+    uint32_t edge_us;          // negative if a glitch came first, and the
+                               // edge time passed with that press
+    uint32_t lock_min_us;      // Shortest and longest lockout
+    uint32_t lock_max_us;
+} replay_t;
+
+// One pass over a trace, with the first tick phase_us into the run
+static void replay(const button_mode_t *mode, const button_trace_t *trace, uint32_t phase_us,
+                   replay_t *r)
+{
+    *r = (replay_t){.latency_us = -1, .lock_min_us = UINT32_MAX};
+    mode->init();
+    press_count = 0;
+    uint8_t debounced = PIN4_bm, locked = 0;
+    uint32_t locked_at = 0;
+    uint32_t end = TRACE_START_US + trace->edges[trace->count - 1] + TRACE_SETTLE_US;
+    uint32_t tick = phase_us;
+    uint8_t next = 0;
+    while (tick < end) {
+        // A pin change at the tick's time lands first
+        uint32_t t;
+        if (next < trace->count && TRACE_START_US + trace->edges[next] <= tick) {
+            t = TRACE_START_US + trace->edges[next++];
+            trace_us = t;
+            PORTA.IN ^= PIN4_bm;
+            if (mode->pin_change) {
+                PORTA.INTFLAGS = PIN4_bm;
+                mode->pin_change();
+            }
+        } else {
+            t = tick;
+            trace_us = t;
+            tick += TICK_US;
+            mode->tick();
+        }
+
+        // An edge accepted as a lockout expires starts the next one at once
+        uint8_t now = mode->debounced() & PIN4_bm;
+        uint8_t lock = mode->locked() & PIN4_bm;
+        bool relocked = lock && locked && now != debounced;
+        if (now != debounced) {
+            if (!now && !r->presses++) {
+                r->latency_us = (int32_t)(t - TRACE_START_US - trace->edges[trace->press]);
+                r->edge_us = press_count ? press_edge_us - TRACE_START_US : UINT32_MAX;
+            }
+            if (now) r->releases++;
+            debounced = now;
+        }
+        if ((!lock && locked) || relocked) {
+            uint32_t held = t - locked_at;
+            if (held < r->lock_min_us) r->lock_min_us = held;
+            if (held > r->lock_max_us) r->lock_max_us = held;
+        }
+        if ((lock && !locked) || relocked) locked_at = t;
+        locked = lock;
+    }
+}
+
+// Every trace through both modes at tick phases 100us apart. Checks the
+// accepted edges against the trace's expected spurious count, the press
+// latency of a clean press (vertical counter: toggles on the third
+// consecutive 5ms sample, 10-15ms after the edge; edge mode: at the edge)
+// and the lockout, BUTTON_LOCKOUT_TICKS - 1 to BUTTON_LOCKOUT_TICKS ticks
+// as the first tick comes anywhere in the period. Both modes must time a
+// press from its first edge. Prints the comparison.
+TEST(button_bounce_traces) {
+    const button_mode_t *modes[] = {&button_mode_vertical, &button_mode_edge};
+    printf("  %-22s %-9s %-15s %s\n", "trace", "mode", "press ms", "spurious");
+    for (uint8_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+        const button_trace_t *trace = &traces[i];
+        for (uint8_t m = 0; m < 2; m++) {
+            int32_t lat_min = INT32_MAX, lat_max = -1;
+            int spurious_max = 0;
+            for (uint32_t phase = 0; phase < TICK_US; phase += 100) {
+                replay_t r;
+                replay(modes[m], trace, phase, &r);
+                int spurious = r.presses + r.releases - 2 * trace->presses;
+                if (spurious > spurious_max) spurious_max = spurious;
+                if (r.presses < trace->presses || r.releases != r.presses)
+                    test_fail("%s, %s mode, phase %luus: %u presses, %u releases", trace->name,
+                              modes[m]->name, (unsigned long)phase, r.presses, r.releases);
+                if (trace->presses && r.latency_us >= 0) {
+                    if (r.latency_us < lat_min) lat_min = r.latency_us;
+                    if (r.latency_us > lat_max) lat_max = r.latency_us;
+                    if (r.edge_us != trace->edges[trace->press])
+                        test_fail("%s, %s mode, phase %luus: press timed from %ldus", trace->name,
+                                  modes[m]->name, (unsigned long)phase, (long)r.edge_us);
+                }
+                if (r.lock_max_us && (r.lock_min_us < (BUTTON_LOCKOUT_TICKS - 1) * TICK_US ||
+                                      r.lock_max_us > BUTTON_LOCKOUT_TICKS * TICK_US))
+                    test_fail("%s, phase %luus: lockout %lu-%luus", trace->name,
+                              (unsigned long)phase, (unsigned long)r.lock_min_us,
+                              (unsigned long)r.lock_max_us);
+            }
+            int expected = m ? trace->spurious_edge : trace->spurious_vertical;
+            if (spurious_max != expected)
+                test_fail("%s, %s mode: up to %d spurious edges, expected %d", trace->name,
+                          modes[m]->name, spurious_max, expected);
+            if (i == 0 && (m ? lat_max != 0 || lat_min != 0 : lat_min < 2 * TICK_US || lat_max > 3 * TICK_US))
+                test_fail("clean press, %s mode: latency %ld-%ldus", modes[m]->name,
+                          (long)lat_min, (long)lat_max);
+
+            char press[16] = "-";
+            if (lat_max >= 0)
+                snprintf(press, sizeof(press), "%.1f-%.1f", lat_min / 1000.0, lat_max / 1000.0);
+            printf("  %-22s %-9s %-15s %d\n", trace->name, modes[m]->name, press, spurious_max);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include <stdint.h>
+#include "button_modes.h"
+
+// button.c again in edge mode, renamed so it links beside the default
+// vertical-counter build in bench_button.c
+#define BUTTON_DEBOUNCE_MODE BUTTON_DEBOUNCE_EDGE
+#define buttons_init edge_buttons_init
+#define update_button_states edge_update_button_states
+#define button_debounce_tick edge_button_debounce_tick
+#define button_pressed edge_button_pressed
+#define button_released edge_button_released
+#define PORTA_PORT_vect edge_PORTA_PORT_vect
+#include "../src/button.c"
+
+static void edge_init(void)
+{
+    PORTA.IN = 0xFF;
+    buttons_init();
+    PORTA.INTFLAGS = 0;
+    pb_locked = 0;
+    memset(pb_lockout, 0, sizeof(pb_lockout));
+}
+
+// The flags are cleared by writing them, which sets them on the host
+static void edge_pin_change(void)
+{
+    PORTA_PORT_vect();
+    PORTA.INTFLAGS = 0;
+}
+
+static uint8_t edge_debounced(void)
+{
+    return pb_debounced_state;
+}
+
+static uint8_t edge_locked(void)
+{
+    return pb_locked;
+}
+
+const button_mode_t button_mode_edge = {
+    "edge", edge_init, button_debounce_tick, edge_pin_change, edge_debounced, edge_locked,
+};
@@ -0,0 +1,111 @@
+#include "bench.h"
+#include <string.h>
+#include <util/crc16.h>
+#include "gamestate.h"
+#include "simon.h"
+#include "leaderboard.h"
+
+#if GAMESTATE_ENABLE
+
+// Offsets into the blob (see gamestate.h)
+#define AT_STATE 3
+#define AT_ROUND_LENGTH 13
+#define AT_PLAY_INDEX 14
+#define AT_INPUT_INDEX 15
+#define AT_STEP 16
+#define AT_DELAY 18
+
+// Recompute the CRC after editing a blob
+static void reseal(uint8_t *blob, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len - 2; i++)
+        crc = _crc_ccitt_update(crc, blob[i]);
+    blob[len - 2] = crc;
+    blob[len - 1] = crc >> 8;
+}
+
+// A blob for round 40, awaiting the first input, with two high scores
+static uint16_t round_40(uint8_t *blob)
+{
+    add_player_to_leaderboard("ada", 31, 412);
+    add_player_to_leaderboard("grace", 17, REACTION_UNKNOWN);
+    uint16_t len = gamestate_save(blob, GAMESTATE_MAX_SIZE);
+    if (!len) test_fail("save did not fit");
+    blob[AT_STATE] = AWAITING_INPUT;
+    blob[AT_ROUND_LENGTH] = 40;
+    reseal(blob, len);
+    return len;
+}
+
+// Restoring a blob and saving again gives the same blob; a blob with a bad
+// CRC or length is rejected and changes nothing
+TEST(gamestate_round_trip) {
+    uint8_t blob[GAMESTATE_MAX_SIZE], again[GAMESTATE_MAX_SIZE], copy[GAMESTATE_MAX_SIZE];
+    uint16_t len = round_40(blob);
+    memcpy(copy, blob, len);
+    if (!gamestate_restore(copy, len)) test_fail("restore rejected a valid blob");
+    uint16_t again_len = gamestate_save(again, sizeof(again));
+    if (again_len != len || memcmp(again, blob, len))
+        test_fail("save after restore differs");
+
+    memcpy(copy, blob, len);
+    copy[AT_ROUND_LENGTH] = 41;
+    if (gamestate_restore(copy, len)) test_fail("restore took a blob with a bad CRC");
+    if (gamestate_restore(copy, len - 1)) test_fail("restore took a short blob");
+    gamestate_save(again, sizeof(again));
+    if (memcmp(again, blob, len)) test_fail("rejected blob changed the state");
+}
+
+// A blob with a good CRC but values the game cannot resume from
+TEST(gamestate_rejects_bad_values) {
+    static const struct {
+        const char *what;
+        uint8_t at, value;
+    } bad[] = {
+        {"HANDLE_INPUT", AT_STATE, HANDLE_INPUT},
+        {"an unknown state", AT_STATE, ENTER_NAME + 1},
+        {"round length 0", AT_ROUND_LENGTH, 0},
+        {"play index past the round", AT_PLAY_INDEX, 41},
+        {"input index past the round", AT_INPUT_INDEX, 41},
+        {"step 4", AT_STEP, 4},
+        {"playback delay 0", AT_DELAY, 0},
+        {"playback delay over 2000ms", AT_DELAY + 1, 0x08},
+    };
+    uint8_t blob[GAMESTATE_MAX_SIZE], again[GAMESTATE_MAX_SIZE], copy[GAMESTATE_MAX_SIZE];
+    uint16_t len = round_40(blob);
+    blob[AT_DELAY] = 0xF4;  // 500ms
+    blob[AT_DELAY + 1] = 0x01;
+    reseal(blob, len);
+    memcpy(copy, blob, len);
+    if (!gamestate_restore(copy, len)) test_fail("restore rejected a valid blob");
+
+    for (uint8_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        memcpy(copy, blob, len);
+        copy[bad[i].at] = bad[i].value;
+        if (bad[i].at == AT_DELAY) copy[AT_DELAY + 1] = 0;
+        reseal(copy, len);
+        if (gamestate_restore(copy, len)) test_fail("restore took %s", bad[i].what);
+    }
+    gamestate_save(again, sizeof(again));
+    if (memcmp(again, blob, len)) test_fail("rejected blob changed the state");
+
+    // The end of the round is still a valid place to resume from
+    memcpy(copy, blob, len);
+    copy[AT_PLAY_INDEX] = 40;
+    copy[AT_INPUT_INDEX] = 40;
+    reseal(copy, len);
+    if (!gamestate_restore(copy, len)) test_fail("restore rejected indices at the round length");
+}
+
+BENCH(gamestate_round_trip) {
+    uint8_t blob[GAMESTATE_MAX_SIZE], again[GAMESTATE_MAX_SIZE], copy[GAMESTATE_MAX_SIZE];
+    uint16_t len = round_40(blob);
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(copy, blob, len);
+        bench_sink += gamestate_restore(copy, len);
+        bench_sink += gamestate_save(again, sizeof(again));
+    }
+}
+
+#endif
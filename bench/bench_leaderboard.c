@@ -0,0 +1,129 @@
+#include "bench.h"
+#include <avr/io.h>
+#include "../src/leaderboard.c"
+
+void NVMCTRL_EE_vect(void);
+
+// Scores and reaction times from a fixed pseudo-random sequence, so
+// entries land at every rank
+static uint32_t rng = 0x12236632;
+
+static uint8_t next_random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// A full table to restore before each insertion
+static leaderboard_entry_t full_table[LEADERBOARD_SIZE];
+static char full_names[LEADERBOARD_NAME_ARENA];
+static uint8_t full_count;
+static uint16_t full_names_used;
+
+static void fill_table(void) {
+    if (full_count) return;
+    leaderboard_count = 0;
+    names_used = 0;
+    for (uint8_t i = 0; i < LEADERBOARD_SIZE; i++)
+        insert_entry("abc", 10 + 2 * i, 400);
+    memcpy(full_table, leaderboard, sizeof(leaderboard));
+    memcpy(full_names, names, sizeof(names));
+    full_count = leaderboard_count;
+    full_names_used = names_used;
+}
+
+static void restore_table(void) {
+    memcpy(leaderboard, full_table, sizeof(leaderboard));
+    memcpy(names, full_names, sizeof(names));
+    leaderboard_count = full_count;
+    names_used = full_names_used;
+}
+
+// ----------------------  INSERTION  ----------------------
+
+// Includes restoring the full table before each insertion
+BENCH(leaderboard_insert) {
+    fill_table();
+    for (uint32_t i = 0; i < n; i++) {
+        restore_table();
+        bench_sink += insert_entry("player", 10 + next_random() % (2 * LEADERBOARD_SIZE), next_random());
+    }
+}
+
+// Insertion plus building and queueing the EEPROM record
+BENCH(leaderboard_add_player) {
+    fill_table();
+    for (uint32_t i = 0; i < n; i++) {
+        restore_table();
+        add_player_to_leaderboard("player", 10 + next_random() % (2 * LEADERBOARD_SIZE), next_random());
+        leaderboard_task();
+    }
+}
+
+BENCH(leaderboard_qualifies) {
+    fill_table();
+    restore_table();
+    for (uint32_t i = 0; i < n; i++)
+        bench_sink += leaderboard_qualifies(next_random() % (4 * LEADERBOARD_SIZE), next_random());
+}
+
+// ----------------------  PERSISTENCE  ----------------------
+
+static void clear_table(void) {
+    leaderboard_count = 0;
+    names_used = 0;
+}
+
+// Writes a record to the given page, the only one left out of pages_in_use
+static void put_record(uint8_t page, const char *name, uint8_t score) {
+    store_record_t record = { .score = score, .reaction_ms = 400 };
+    strcpy(record.name, name);
+    store_write(&record, (uint8_t)~(1 << page));
+}
+
+static void expect_names(const char *expected) {
+    if (names_used != strlen(expected) || memcmp(names, expected, names_used))
+        test_fail("table %.*s, expected %s", names_used, names, expected);
+}
+
+// A stale record of an evicted entry tying a live one is the newer of the
+// two, and must not take the live one's place whatever pages they are in
+TEST(leaderboard_reload_ties) {
+    memset(host_eeprom, 0xFF, EEPROM_SIZE);
+    put_record(6, "A", 5);
+    put_record(1, "C", 20);
+    put_record(2, "D", 21);
+    put_record(3, "E", 22);
+    put_record(4, "F", 30);
+    put_record(0, "B", 5); // Tied A, evicted by F in a full table
+    clear_table();
+    leaderboard_load();
+    expect_names(LEADERBOARD_SIZE == 5 ? "FEDCA" : "FEDCAB");
+    if (leaderboard[4].page != 6)
+        test_fail("A restored from page %u, expected 6", leaderboard[4].page);
+}
+
+// With the EEPROM busy and the write queue full, the new entry stays
+// pending and is written once the queue drains
+TEST(leaderboard_write_queue_full) {
+    memset(host_eeprom, 0xFF, EEPROM_SIZE);
+    clear_table();
+    NVMCTRL.STATUS = NVMCTRL_EEBUSY_bm;
+    put_record(0, "X", 1);
+    put_record(1, "Y", 1);
+    add_player_to_leaderboard("Z", 9, 400);
+    leaderboard_task();
+    if (leaderboard[0].page != PAGE_PENDING)
+        test_fail("entry given page %u with the queue full", leaderboard[0].page);
+
+    NVMCTRL.STATUS = 0;
+    NVMCTRL_EE_vect();
+    NVMCTRL_EE_vect();
+    leaderboard_task();
+    store_record_t record;
+    if (leaderboard[0].page >= STORE_PAGES || !store_read(leaderboard[0].page, &record) ||
+        strcmp(record.name, "Z") || record.score != 9)
+        test_fail("entry not written once the queue drained (page %u)", leaderboard[0].page);
+    NVMCTRL_EE_vect();
+}
@@ -0,0 +1,68 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/scheduler.c"
+
+// A stand-in task table (the firmware's is in main.c): every task but one
+// runs on every pass, one every 10ms, and one waits on a flag between steps
+static uint32_t periodic_runs, steps;
+static uint8_t go;
+
+static void every_pass(pt_t *pt)
+{
+    bench_sink++;
+}
+
+static void periodic(pt_t *pt)
+{
+    periodic_runs++;
+}
+
+static void stepper(pt_t *pt)
+{
+    PT_BEGIN(pt);
+    PT_WAIT_UNTIL(pt, go);
+    steps++;
+    PT_YIELD(pt);
+    steps++;
+    PT_END(pt);
+}
+
+const task_t sched_tasks[TASK_COUNT] = {
+    [TASK_INPUT]     = {"input",     every_pass, 0,            SCHED_MS(5)},
+    [TASK_AUDIO]     = {"audio",     every_pass, 0,            SCHED_MS(10)},
+    [TASK_REPORT]    = {"report",    stepper,    0,            SCHED_MS(100)},
+    [TASK_LINK]      = {"link",      every_pass, 0,            SCHED_MS(5)},
+    [TASK_GAME]      = {"game",      every_pass, 0,            SCHED_MS(1)},
+    [TASK_UART_TX]   = {"uart_tx",   every_pass, 0,            SCHED_MS(1)},
+    [TASK_PERSIST]   = {"persist",   periodic,   SCHED_MS(10), SCHED_MS(100)},
+    [TASK_TELEMETRY] = {"telemetry", every_pass, 0,            SCHED_MS(20)},
+};
+
+static void fail(const char *what, uint32_t got, uint32_t want)
+{
+    fprintf(stderr, "bench: scheduler %s: %lu, expected %lu\n", what,
+            (unsigned long)got, (unsigned long)want);
+    exit(1);
+}
+
+// One pass over the table a millisecond. The 10ms task runs once per period
+// of the clock, and the protothread resumes where it left off.
+BENCH(sched_pass) {
+    RTC.CTRLA = 0;
+    RTC.CNT = 0;
+    sched_init();
+    periodic_runs = steps = 0;
+    go = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        RTC.CNT = (uint16_t)((uint64_t)i * 32768 / 1000);
+        if (i == 5) go = 1;
+        sched_pass();
+    }
+    uint32_t want = (uint32_t)((uint64_t)(n - 1) * 32768 / 1000 / SCHED_MS(10)) + 1;
+    if (periodic_runs < want - 1 || periodic_runs > want + 1)
+        fail("10ms task runs", periodic_runs, want);
+    // One step a pass once the flag is up
+    if (n > 5 && steps != n - 5)
+        fail("protothread steps", steps, n - 5);
+}
@@ -0,0 +1,162 @@
+#include "bench.h"
+#include <stdio.h>
+#include "snapshot_inject.h"
+#include "../src/simon.c"
+
+// ----------------------  SEQUENCE  ----------------------
+
+BENCH(simon_get_next_step) {
+    for (uint32_t i = 0; i < n; i++)
+        bench_sink += get_next_step();
+}
+
+// FAIL timeout: rewinds the LFSR, advances it past the failed round and
+// moves on to DISP_SCORE
+static void fail_at_round(uint32_t n, uint8_t round) {
+    for (uint32_t i = 0; i < n; i++) {
+        state = FAIL;
+        round_length = round;
+        fail_event(EV_TIMEOUT);
+    }
+    bench_sink += game_seed;
+}
+
+BENCH(simon_fail_seed_advance_1) { fail_at_round(n, 1); }
+BENCH(simon_fail_seed_advance_32) { fail_at_round(n, 32); }
+BENCH(simon_fail_seed_advance_99) { fail_at_round(n, 99); }
+
+// ----------------------  DISPATCH  ----------------------
+
+// simon_task() with nothing due, as on almost every main loop pass: the
+// state's deadline is armed but far off and no input is pending
+static void idle_in(uint32_t n, simon_state_t s) {
+    state = s;
+    entry_pending = false;
+    prepare_delay();
+    state_timeout = 60000;
+    state_timeout_armed = true;
+    for (uint32_t i = 0; i < n; i++)
+        simon_task();
+    bench_sink += state;
+}
+
+BENCH(simon_task_idle_play_on) { idle_in(n, SIMON_PLAY_ON); }
+BENCH(simon_task_idle_awaiting_input) { idle_in(n, AWAITING_INPUT); }
+BENCH(simon_task_idle_disp_score) { idle_in(n, DISP_SCORE); }
+
+// ----------------------  INPUT EDGES  ----------------------
+
+// A press and its release drained in the same pass, as after a slow pass:
+// HANDLE_INPUT must still see the release. One queued before the press is
+// an earlier press's, and must not end the new one.
+static bool released_after(uint8_t first, uint8_t second) {
+    msg_t msg;
+    while (bus_get(BUS_GAME, &msg));
+    state = AWAITING_INPUT;
+    entry_pending = false;
+    awaiting_input_entry();
+    bus_post(BUS_GAME, first, PIN5_bm);
+    bus_post(BUS_GAME, second, PIN5_bm);
+    simon_task();
+    if (state != HANDLE_INPUT)
+        test_fail("state %u after the press, expected HANDLE_INPUT", state);
+    simon_task();
+    bool released = pb_released;
+    transition(AWAITING_INPUT);
+    awaiting_input_exit();
+    return released;
+}
+
+TEST(simon_press_release_same_pass) {
+    if (!released_after(MSG_BUTTON_DOWN, MSG_BUTTON_UP))
+        test_fail("release in the press's pass lost");
+    if (released_after(MSG_BUTTON_UP, MSG_BUTTON_DOWN))
+        test_fail("release before the press ended it");
+}
+
+// ----------------------  DISPLAY  ----------------------
+
+BENCH(simon_display_two_digit_number) {
+    for (uint32_t i = 0; i < n; i++)
+        display_two_digit_number(i % 100);
+}
+
+// ----------------------  SNAPSHOTS  ----------------------
+
+static void press_edge_isr(void) {
+    simon_input_edge(PIN4_bm, timer_micros());
+}
+
+// The input ISR records a new edge between the bytes of the main loop's
+// read, which must return the new edge whole
+TEST(simon_press_edge_isr_between_bytes) {
+    FLAG_CLEAR(FLAG_INPUT_ARMED);
+    for (uint32_t i = 0; i < 3 * 32; i++) {
+        press_edge_us = ~timer_micros() + (i / 3) * 0x01010101;
+        inject_arm(press_edge_isr, i % 3);
+        uint32_t edge = press_edge();
+        if (edge != press_edge_us)
+            test_fail("press_edge tore: read %08lx, edge %08lx",
+                      (unsigned long)edge, (unsigned long)press_edge_us);
+    }
+}
+
+BENCH(simon_press_edge_isr_between_bytes) {
+    FLAG_CLEAR(FLAG_INPUT_ARMED);
+    for (uint32_t i = 0; i < n; i++) {
+        press_edge_us = ~timer_micros();
+        inject_arm(press_edge_isr, i % 3);
+        bench_sink += press_edge();
+    }
+}
+
+// ----------------------  REACTION STATISTICS  ----------------------
+
+// A double-precision reference of the sample standard deviation
+static double reference_stddev(const uint32_t *us, uint16_t n, double *mean) {
+    double sum = 0, sq = 0;
+    for (uint16_t i = 0; i < n; i++) sum += us[i];
+    *mean = sum / n;
+    for (uint16_t i = 0; i < n; i++) sq += (us[i] - *mean) * (us[i] - *mean);
+    if (n < 2) return 0;
+    double var = sq / (n - 1), root = var > 1 ? var : 1;
+    for (int i = 0; i < 100; i++) root = (root + var / root) / 2;
+    return root;
+}
+
+// The 32-bit running statistics against the reference: the mean within
+// 2us and the standard deviation within 0.1% or 2us
+TEST(simon_reaction_stats) {
+    static uint32_t us[2000];
+    uint32_t rng = 0x2545F491;
+    static const struct {
+        const char *what;
+        uint16_t n;
+        uint32_t base, spread;
+    } sets[] = {
+        {"one game", 20, 300000, 300000},
+        {"a long game", 2000, 350000, 200000},
+        {"a steady player", 50, 499000, 2000},
+        {"the same every time", 10, 450000, 0},
+        {"from instant to the clamp", 40, 0, REACTION_MAX_US},
+    };
+    for (uint8_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        reaction_reset();
+        input_armed_us = 1000;
+        for (uint16_t i = 0; i < sets[s].n; i++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            us[i] = sets[s].base + (sets[s].spread ? rng % (sets[s].spread + 1) : 0);
+            reaction_add(input_armed_us + us[i]);
+        }
+        double mean, sd = reference_stddev(us, sets[s].n, &mean);
+        double got_sd = reaction_stddev_us(), tolerance = sd / 1000 > 2 ? sd / 1000 : 2;
+        if (reaction_mean_us() < mean - 2 || reaction_mean_us() > mean + 2)
+            test_fail("%s: mean %lu, reference %.1f", sets[s].what,
+                      (unsigned long)reaction_mean_us(), mean);
+        if (got_sd < sd - tolerance || got_sd > sd + tolerance)
+            test_fail("%s: standard deviation %.0f, reference %.1f", sets[s].what, got_sd, sd);
+        printf("  %-26s sd %8.0f us, reference %10.1f us\n", sets[s].what, got_sd, sd);
+    }
+}
@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "snapshot_inject.h"
+#include "../src/timer.c"
+
+// ----------------------  SNAPSHOTS  ----------------------
+// The tick ISR runs between the bytes of each read, at the point TCB1
+// raises it (CNT at CCMP). Every increment here carries into the top byte
+// of the period count, so a torn read is always detectable.
+
+static void torn(const char *what, uint32_t got, uint32_t before, uint32_t after)
+{
+    test_fail("%s tore: read %08lx, before %08lx, after %08lx", what,
+              (unsigned long)got, (unsigned long)before, (unsigned long)after);
+}
+
+// The flag is raised when the ISR runs; writing it to clear sets it on the
+// host, so clear it here
+static void tick_isr(void)
+{
+    TCB1.INTFLAGS = TCB_CAPT_bm;
+    TCB1_INT_vect();
+    TCB1.INTFLAGS = 0;
+}
+
+// Period count, TCB1.CNT at CCMP and no tick pending
+static void set_ticks(uint32_t ticks)
+{
+    tick_count = ticks;
+    TCB1.CCMP = TICK_MS - 1;
+    TCB1.CNT = TICK_MS - 1;
+    TCB1.INTFLAGS = 0;
+    TCB0.CNT = 0;
+}
+
+static uint32_t ms_at(uint32_t ticks)
+{
+    return ticks * TICK_MS - 1;
+}
+
+// Each check runs the ISR after every byte of the read in turn, across
+// carries into each byte of the count
+#define INJECT_RUNS (3 * 32)
+
+// A plain byte copy with the same injection must tear, or the checks
+// below prove nothing
+TEST(timer_injection_tears) {
+    set_ticks(0x00FFFFFF);
+    uint32_t ticks;
+    inject_arm(tick_isr, 0);
+    inject_copy(&ticks, &tick_count, sizeof(ticks));
+    if (ticks == 0x00FFFFFF || ticks == 0x01000000)
+        torn("injection had no effect, plain copy never", ticks, 0x00FFFFFF, 0x01000000);
+}
+
+TEST(timer_millis_isr_between_bytes) {
+    for (uint32_t i = 0; i < INJECT_RUNS; i++) {
+        uint32_t before = 0x00FFFFFF + (i & 0x1F) * 0x01000000;
+        set_ticks(before);
+        inject_arm(tick_isr, i % 3);
+        uint32_t ms = timer_millis();
+        if (ms != ms_at(before + 1))
+            torn("timer_millis", ms, ms_at(before), ms_at(before + 1));
+    }
+}
+
+TEST(timer_micros_isr_between_bytes) {
+    for (uint32_t i = 0; i < INJECT_RUNS; i++) {
+        set_ticks(0x00FFFFFF);
+        TCB0.CNT = 3000;
+        inject_arm(tick_isr, i % 3);
+        uint32_t us = timer_micros();
+        // 900us into the millisecond; wraps like the firmware
+        uint32_t expected = ms_at(0x01000000) * 1000 + 900;
+        if (us != expected)
+            torn("timer_micros", us, ms_at(0x00FFFFFF) * 1000 + 900, expected);
+    }
+}
+
+TEST(timer_elapsed_ms_isr_between_bytes) {
+    for (uint32_t i = 0; i < INJECT_RUNS; i++) {
+        set_ticks(0x0000FFFF);
+        delay_start_ms = ms_at(0x0000FFFF) - 0xFF;
+        inject_arm(tick_isr, i % 3);
+        uint16_t elapsed = timer_elapsed_ms();
+        if (elapsed != 0xFF + TICK_MS)
+            torn("timer_elapsed_ms", elapsed, 0xFF, 0xFF + TICK_MS);
+    }
+}
+
+// Read from an ISR (or with interrupts off) while the tick is pending:
+// counted once, whether TCB1 has restarted yet or not
+TEST(timer_millis_tick_pending) {
+    for (uint32_t i = 0; i < 2; i++) {
+        set_ticks(1000);
+        TCB1.CNT = (TICK_MS - 1 + i) % TICK_MS;
+        TCB1.INTFLAGS = TCB_CAPT_bm;
+        uint32_t ms = timer_millis();
+        if (ms != ms_at(1001) + i)
+            torn("timer_millis with the tick pending", ms, ms_at(1001), ms_at(1001) + i);
+    }
+    TCB1.INTFLAGS = 0;
+}
+
+// A read the ISR lands in: the copy, the sequence check and the retry
+BENCH(timer_millis_isr_between_bytes) {
+    for (uint32_t i = 0; i < n; i++) {
+        set_ticks(0x00FFFFFF + (i & 0x1F) * 0x01000000);
+        inject_arm(tick_isr, i % 3);
+        bench_sink += timer_millis();
+    }
+}
+
+BENCH(timer_millis_tick_pending) {
+    for (uint32_t i = 0; i < n; i++) {
+        set_ticks(1000);
+        TCB1.CNT = (TICK_MS - 1 + (i & 1)) % TICK_MS;
+        TCB1.INTFLAGS = TCB_CAPT_bm;
+        bench_sink += timer_millis();
+    }
+    TCB1.INTFLAGS = 0;
+}
+
+// Without an ISR in the way: the cost of the sequence check and the
+// three counters
+BENCH(timer_millis) {
+    set_ticks(1000);
+    for (uint32_t i = 0; i < n; i++)
+        bench_sink += timer_millis();
+}
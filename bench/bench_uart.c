@@ -0,0 +1,74 @@
+#include "bench.h"
+#include <string.h>
+#include <util/crc16.h>
+#include "../src/uart.c"
+
+// ----------------------  SEED PARSING  ----------------------
+
+BENCH(uart_hexchar_to_int) {
+    static const char chars[] = "0123456789abcdefxyz";
+    for (uint32_t i = 0; i < n; i++)
+        bench_sink += hexchar_to_int(chars[i % (sizeof(chars) - 1)]);
+}
+
+// A complete "9deadbeef" seed command through the RX interrupt handler,
+// draining the posted MSG_SEED
+BENCH(uart_seed_command) {
+    static const char command[] = "9deadbeef";
+    msg_t msg;
+    for (uint32_t i = 0; i < n; i++) {
+        for (uint8_t c = 0; c < sizeof(command) - 1; c++) {
+            USART0.RXDATAL = command[c];
+            USART0_RXC_vect();
+        }
+        while (bus_get(BUS_GAME, &msg))
+            bench_sink += msg.value;
+    }
+}
+
+// A '1'-'4' game key through the RX interrupt handler, draining the posted
+// MSG_UART_BUTTON
+BENCH(uart_button_command) {
+    msg_t msg;
+    for (uint32_t i = 0; i < n; i++) {
+        USART0.RXDATAL = '1' + (i & 3);
+        USART0_RXC_vect();
+        while (bus_get(BUS_GAME, &msg))
+            bench_sink += msg.arg;
+    }
+}
+
+// ----------------------  LINK MARK  ----------------------
+
+#if LINK_ENABLE
+
+static void rx_bytes(const char *bytes, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        USART0.RXDATAL = bytes[i];
+        USART0_RXC_vect();
+    }
+}
+
+// Outside a match a mark typed on the console reaches it, a doubled one
+// too, and a JOIN frame is still taken whole
+TEST(uart_stray_link_mark) {
+    static const char typed[] = "\x1d" "a" "\x1d\x1d" "b";
+    char join[7] = { LINK_MARK, 'J', 1, 2, 3, 4 };
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < 6; i++)
+        crc = _crc8_ccitt_update(crc, join[i]);
+    join[6] = crc;
+
+    uart_enable_name_entry();
+    rx_bytes(typed, sizeof(typed) - 1);
+    rx_bytes(join, sizeof(join));
+    rx_bytes("c", 1);
+    char got[16];
+    uint8_t count = 0;
+    while (uart_rx_available() && count < sizeof(got))
+        got[count++] = uart_receive();
+    uart_disable_name_entry();
+    if (count != sizeof(typed) || memcmp(got, typed, sizeof(typed) - 1) || got[count - 1] != 'c')
+        test_fail("console got %.*s, expected %s and c", count, got, typed);
+}
+#endif
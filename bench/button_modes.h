@@ -0,0 +1,28 @@
+#ifndef BUTTON_MODES_H
+#define BUTTON_MODES_H
+
+#include <stdint.h>
+
+// button.c in both debounce modes, for replaying the same pin traces
+// through each: bench_button.c builds it in the default vertical-counter
+// mode and bench_button_edge.c in edge mode, with its functions renamed.
+typedef struct {
+    const char *name;
+    void (*init)(void);       // All buttons released, nothing pending
+    void (*tick)(void);       // The 5ms TCB1 tick
+    void (*pin_change)(void); // PORTA ISR, with INTFLAGS set; NULL if none
+    uint8_t (*debounced)(void);
+    uint8_t (*locked)(void);  // Buttons inside their lockout window
+} button_mode_t;
+
+extern const button_mode_t button_mode_vertical;
+extern const button_mode_t button_mode_edge;
+
+// Both builds call these in place of simon_input_edge() and timer_micros(),
+// so a replay sees each press and runs on the trace's time
+#define simon_input_edge button_trace_press
+#define timer_micros button_trace_micros
+void button_trace_press(uint8_t pressed, uint32_t edge_us);
+uint32_t button_trace_micros(void);
+
+#endif
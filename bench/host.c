@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <avr/io.h>
+
+// Peripheral registers and avr-libc functions the firmware expects
+
+PORT_t PORTA, PORTB, PORTC;
+VPORT_t VPORTA, VPORTB, VPORTC;
+PORTMUX_t PORTMUX;
+SPI_t SPI0;
+TCA_t TCA0;
+TCB_t TCB0, TCB1;
+USART_t USART0;
+ADC_t ADC0;
+EVSYS_t EVSYS;
+NVMCTRL_t NVMCTRL;
+RTC_t RTC;
+CLKCTRL_t CLKCTRL;
+SLPCTRL_t SLPCTRL;
+RSTCTRL_t RSTCTRL;
+reg8_t GPIOR0, GPIOR1, GPIOR2, GPIOR3, CPU_SREG, CCP, SREG;
+reg16_t SP;
+
+uint8_t host_eeprom[EEPROM_SIZE];
+
+char *itoa(int value, char *buf, int radix)
+{
+    (void)radix;
+    sprintf(buf, "%d", value);
+    return buf;
+}
+
+char *ultoa(unsigned long value, char *buf, int radix)
+{
+    (void)radix;
+    sprintf(buf, "%lu", value);
+    return buf;
+}
@@ -0,0 +1,39 @@
+#ifndef SNAPSHOT_INJECT_H
+#define SNAPSHOT_INJECT_H
+
+// Included before a firmware .c file, makes its SNAPSHOT_READ()s copy byte
+// by byte, low byte first as on the AVR, and run an ISR after a chosen
+// byte. A reader that tears returns a value mixing bytes from before and
+// after the ISR; one that retries returns the value after it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*inject_isr_t)(void);
+
+static inject_isr_t inject_isr;  // Runs once, then cleared
+static size_t inject_after;      // Byte index it runs after
+
+static inline void inject_copy(void *dst, const volatile void *src, size_t size)
+{
+    uint8_t *d = dst;
+    const volatile uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = s[i];
+        if (inject_isr && i == inject_after) {
+            inject_isr_t isr = inject_isr;
+            inject_isr = NULL;
+            isr();
+        }
+    }
+}
+
+static inline void inject_arm(inject_isr_t isr, size_t after)
+{
+    inject_isr = isr;
+    inject_after = after;
+}
+
+#define SNAPSHOT_COPY(dst, src) inject_copy(&(dst), &(src), sizeof(dst))
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flags.h"
+
+// Boot profiling: the RTC is started from .init1, the first code after
+// reset, and each init phase records the RTC count (32.768 kHz, so ~31us
+// resolution) as it completes. Queried over UART with 'B'. The time
+// before the first instruction (the start-up delay set by the SUT fuse)
+// is not seen. Disable with -DBOOT_PROFILE=0.
+#ifndef BOOT_PROFILE
+#define BOOT_PROFILE 1
+#endif
+
+typedef enum {
+    BOOT_MAIN,        // C runtime: .data/.bss and stack painting
+    BOOT_BUTTONS,
+    BOOT_UART,
+    BOOT_DISPLAY,     // SPI and display
+    BOOT_TIMER,
+    BOOT_READY,       // Interrupts on, input is taken from here
+    BOOT_ADC,
+    BOOT_PWM,
+    BOOT_LEADERBOARD,
+    BOOT_FIRST_STEP,  // First main loop pass: the first round is playing
+    BOOT_PHASES
+} boot_phase_t;
+
+#if BOOT_PROFILE
+void boot_mark(boot_phase_t phase);
+// "BOOT <phase> <us since reset> <us in phase>" for phase line, true
+// while more follow
+bool boot_print_report(uint8_t line);
+#define BOOT_MARK(phase) boot_mark(phase)
+// End of a main loop pass; the first one completes the profile
+#define BOOT_LOOP_PASS() do { if (!FLAG_TEST(FLAG_BOOT_DONE)) boot_mark(BOOT_FIRST_STEP); } while (0)
+#else
+#define BOOT_MARK(phase) ((void)0)
+#define BOOT_LOOP_PASS() ((void)0)
+#endif
+
+#endif
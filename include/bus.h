@@ -0,0 +1,45 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Message bus between modules. Each destination owns a fixed-size queue;
+// posting is safe from ISRs and the main loop, and every queue is drained
+// by its owner from the main loop.
+
+typedef enum {
+    BUS_GAME,   // simon.c: input, UART game commands
+    BUS_AUDIO,  // buzzer.c: frequency transposition
+    BUS_REPORT, // main.c: diagnostic and high score reports
+    BUS_COUNT
+} bus_queue_t;
+
+typedef enum {
+    MSG_BUTTON_DOWN, // arg: PORTA pins newly pressed
+    MSG_BUTTON_UP,   // arg: PORTA pins newly released
+    MSG_UART_BUTTON, // arg: button 1-4 pressed over UART
+    MSG_RESET,       // Restart the game
+    MSG_SEED,        // value: new LFSR seed for the next game
+    MSG_TRANSPOSE,   // arg: TRANSPOSE_UP, TRANSPOSE_DOWN or TRANSPOSE_RESET
+    MSG_REPORT       // arg: report command character
+} msg_type_t;
+
+#define TRANSPOSE_UP 1
+#define TRANSPOSE_DOWN 2
+#define TRANSPOSE_RESET 3
+
+typedef struct {
+    uint8_t type;
+    union {
+        uint8_t arg;     // Low byte of value (AVR is little-endian)
+        uint32_t value;
+    };
+} msg_t;
+
+// Returns false (and drops the message) if the queue is full
+bool bus_post(bus_queue_t queue, uint8_t type, uint32_t value);
+// Returns false if the queue is empty
+bool bus_get(bus_queue_t queue, msg_t *msg);
+
+#endif
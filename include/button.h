@@ -4,22 +4,38 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-// Button states and edge detection
-extern volatile uint8_t pb_debounced_state;
-extern volatile uint8_t pb_state_curr;
-extern volatile uint8_t pb_state_prev;
-extern volatile uint8_t pb_falling_edge;
-extern volatile uint8_t pb_rising_edge;
-extern volatile uint8_t pb_released;
-extern volatile uint8_t pb_current;
-void update_button_states(void);
+// Debounce modes, selected at build time with -DBUTTON_DEBOUNCE_MODE=...
+// VERTICAL: vertical-counter debounce sampled every 5ms in TCB1 (default);
+//           a change is taken on its third consecutive sample, 10-15ms
+//           after the edge
+// EDGE:     act on the first PORTA pin-change edge, then ignore that
+//           button for BUTTON_LOCKOUT_MS while the contacts settle
+#define BUTTON_DEBOUNCE_VERTICAL 0
+#define BUTTON_DEBOUNCE_EDGE 1
+
+#ifndef BUTTON_DEBOUNCE_MODE
+#define BUTTON_DEBOUNCE_MODE BUTTON_DEBOUNCE_VERTICAL
+#endif
+
+// Lockout window after an accepted edge (edge mode only), counted in 5ms
+// TCB1 ticks. The first tick comes anywhere in its period, so the window
+// lasts (BUTTON_LOCKOUT_TICKS - 1) * 5 to BUTTON_LOCKOUT_TICKS * 5 ms.
+#ifndef BUTTON_LOCKOUT_MS
+#define BUTTON_LOCKOUT_MS 20
+#endif
+#define BUTTON_LOCKOUT_TICKS ((BUTTON_LOCKOUT_MS + 4) / 5)
 
-// Global latch for button presses
-extern volatile uint8_t g_latched_button_flags;
+#define BUTTON_PINS_gm (PIN4_bm | PIN5_bm | PIN6_bm | PIN7_bm)
+
+// Edge detection; posts MSG_BUTTON_DOWN/MSG_BUTTON_UP to the game queue
+void update_button_states(void);
 
 // Initialize button handling
 void buttons_init(void);
 
+// Debounce step (or edge-mode lockout expiry), called from the 5ms TCB1 tick
+void button_debounce_tick(void);
+
 // Check if specific button was pressed (using falling edge)
 bool button_pressed(uint8_t button_mask);
 
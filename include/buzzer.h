@@ -10,6 +10,5 @@ void play_tone(uint8_t tone);
 void update_current_tone_frequency(void);
 void stop_tone(void);
 
-extern volatile uint16_t current_freq;
-
-volatile uint8_t is_playing;
\ No newline at end of file
+// Apply queued frequency transpositions (BUS_AUDIO), called from the main loop
+void buzzer_task(void);
\ No newline at end of file
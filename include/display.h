@@ -7,8 +7,6 @@ void display_init(void);
 void update_display(const uint8_t left, const uint8_t right);
 void display_write(uint8_t data);
 void swap_display_digit(void);
-
-extern volatile uint8_t left_byte;
-extern volatile uint8_t right_byte;
+uint8_t display_lit_segments(void);  // Segments lit over both digits, 0-14 (HEALTH_ENERGY)
 
 #endif
\ No newline at end of file
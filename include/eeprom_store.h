@@ -0,0 +1,40 @@
+#ifndef EEPROM_STORE_H
+#define EEPROM_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Leaderboard persistence in EEPROM. Each leaderboard entry is one
+// CRC-protected record in its own EEPROM page. New entries go to the next
+// page not holding a live entry (round robin), which spreads wear and
+// means a corrupt page only loses that one entry. Page writes are queued
+// and run from the NVMCTRL EEREADY interrupt, so callers never wait for an
+// erase/write cycle.
+
+#define STORE_NAME_LEN 20
+#define STORE_PAGES 8 // 256 byte EEPROM, 32 byte pages
+#define STORE_QUEUE_FULL 0xFF // store_write(): nothing queued
+
+typedef struct {
+    uint16_t seq; // Write sequence number, set by store_read()
+    uint8_t score;
+    uint16_t reaction_ms;
+    char name[STORE_NAME_LEN + 1];
+} store_record_t;
+
+// Find where the last session stopped writing
+void store_init(void);
+
+// Read and validate the record in a page; false if blank or corrupt.
+// Records with a lower seq were written earlier (compare with wraparound).
+bool store_read(uint8_t page, store_record_t *record);
+
+// True if store_write() can queue a record
+bool store_ready(void);
+
+// Queue a record for writing to a page outside pages_in_use (bit per page)
+// and return the page chosen, or STORE_QUEUE_FULL without waiting if two
+// writes are already queued
+uint8_t store_write(const store_record_t *record, uint8_t pages_in_use);
+
+#endif
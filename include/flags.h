@@ -0,0 +1,51 @@
+#ifndef FLAGS_H
+#define FLAGS_H
+
+#include <avr/io.h>
+
+// One-bit flags kept in the general purpose I/O registers rather than
+// SRAM. GPIOR0-3 sit at I/O addresses 0x1C-0x1F, inside the range SBI,
+// CBI, SBIS and SBIC can reach, so with a constant bit each macro below
+// compiles to one of those: 1 cycle and one word, against LDS/STS plus a
+// compare in SRAM. SBI and CBI are also atomic, so flags written from the
+// main loop and from ISRs can share a register without cli().
+//
+// GPIORs reset to 0, so every flag starts clear.
+//
+//   GPIOR0  bit 0  FLAG_INPUT_ARMED    simon.c      PORTA ISR takes fast presses
+//           bit 1  FLAG_NAME_ENTRY     uart.c       RX ISR buffers a name
+//           bit 2  FLAG_RECORDING      record.c     tested by every RECORD()
+//           bit 3  FLAG_TRACE_PAUSED   trace.c      tested by every TRACE()
+//           bit 4  FLAG_TONE_PLAYING   buzzer.c     set from the PORTA ISR too
+//           bit 5  FLAG_STATE_PENDING  gamestate.c  RX ISR holds a 'Y' blob
+//   GPIOR1  bit 0  FLAG_BOOT_DONE      boot.c       tested every main loop pass
+//           bit 1  FLAG_HEALTH_STREAM  health.c     tested every main loop pass
+//           bit 2  FLAG_PASS_BUSY      health.c     set by HEALTH_BUSY()
+//           bit 3  FLAG_LINKED         link.c       tested every game pass
+//   GPIOR2         free
+//   GPIOR3         free
+//
+// GPIOR0 holds the flags read or written in ISRs, GPIOR1 the main loop's.
+// Multi-bit state (fast_press_button holds a button number) stays in SRAM.
+
+#define FLAG_INPUT_ARMED   GPIOR0, 0
+#define FLAG_NAME_ENTRY    GPIOR0, 1
+#define FLAG_RECORDING     GPIOR0, 2
+#define FLAG_TRACE_PAUSED  GPIOR0, 3
+#define FLAG_TONE_PLAYING  GPIOR0, 4
+#define FLAG_STATE_PENDING GPIOR0, 5
+#define FLAG_BOOT_DONE     GPIOR1, 0
+#define FLAG_HEALTH_STREAM GPIOR1, 1
+#define FLAG_PASS_BUSY     GPIOR1, 2
+#define FLAG_LINKED        GPIOR1, 3
+
+// The extra level expands the flag into its register and bit
+#define FLAG_SET(flag) FLAG_SET_(flag)
+#define FLAG_CLEAR(flag) FLAG_CLEAR_(flag)
+#define FLAG_TEST(flag) FLAG_TEST_(flag)
+
+#define FLAG_SET_(reg, bit) ((reg) |= (uint8_t)(1 << (bit)))
+#define FLAG_CLEAR_(reg, bit) ((reg) &= (uint8_t)~(1 << (bit)))
+#define FLAG_TEST_(reg, bit) (((reg) & (1 << (bit))) != 0)
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "leaderboard.h"
+
+// Game state snapshots: 'X' prints the whole game state as one line of
+// hex, "STATE <hex>", and 'Y' followed by that hex and a newline restores
+// it, resuming the game at the saved round and state without playing up
+// to it ("STATE OK", or "STATE BAD" if the blob was rejected and nothing
+// changed). The restored leaderboard is not written to EEPROM, so the one
+// there is loaded again after a reset. Disable with -DGAMESTATE_ENABLE=0.
+#ifndef GAMESTATE_ENABLE
+#define GAMESTATE_ENABLE 1
+#endif
+
+// Blob layout, multi-byte values little-endian:
+//   version (1), payload length (2)
+//   simon.c:        state, flags, game seed, reset seed, round length,
+//                   play index, input index, step, score, playback
+//                   delay (17)
+//   buzzer.c:       the four tone frequencies (8)
+//   leaderboard.c:  entry count, then per entry score, reaction ms,
+//                   name length and name (1 + 4 per entry + names)
+//   CRC-16/CCITT of everything before it (2)
+#define GAMESTATE_VERSION 1
+#define GAMESTATE_SIMON_SIZE 17
+#define GAMESTATE_BUZZER_SIZE 8
+#define GAMESTATE_MAX_SIZE (3 + GAMESTATE_SIMON_SIZE + GAMESTATE_BUZZER_SIZE + \
+                            1 + LEADERBOARD_SIZE * 4 + LEADERBOARD_NAME_ARENA + 2)
+
+// Cursor over a blob. Reads past the end return 0 and set bad, so a
+// restore checks once after reading everything.
+typedef struct {
+    uint8_t *data;
+    uint16_t pos;
+    uint16_t len;
+    bool bad;
+} blob_t;
+
+static inline void blob_put8(blob_t *b, uint8_t v)
+{
+    if (b->pos < b->len) b->data[b->pos++] = v;
+    else b->bad = true;
+}
+
+static inline void blob_put16(blob_t *b, uint16_t v)
+{
+    blob_put8(b, v);
+    blob_put8(b, v >> 8);
+}
+
+static inline void blob_put32(blob_t *b, uint32_t v)
+{
+    blob_put16(b, v);
+    blob_put16(b, v >> 16);
+}
+
+static inline uint8_t blob_get8(blob_t *b)
+{
+    if (b->pos < b->len) return b->data[b->pos++];
+    b->bad = true;
+    return 0;
+}
+
+static inline uint16_t blob_get16(blob_t *b)
+{
+    uint16_t lo = blob_get8(b);
+    return lo | (uint16_t)blob_get8(b) << 8;
+}
+
+static inline uint32_t blob_get32(blob_t *b)
+{
+    uint32_t lo = blob_get16(b);
+    return lo | (uint32_t)blob_get16(b) << 16;
+}
+
+#if GAMESTATE_ENABLE
+// Each module's part of the blob. A restore with apply false only checks
+// its part, so a blob is checked whole before any of it is applied.
+void simon_save(blob_t *b);
+bool simon_restore(blob_t *b, bool apply);
+void buzzer_save(blob_t *b);
+bool buzzer_restore(blob_t *b, bool apply);
+void leaderboard_save(blob_t *b);
+bool leaderboard_restore(blob_t *b, bool apply);
+
+// Write the current state into data, returns its length (0 if it did not fit)
+uint16_t gamestate_save(uint8_t *data, uint16_t size);
+// Check and apply a blob; nothing changes unless the whole blob is valid
+bool gamestate_restore(uint8_t *data, uint16_t len);
+
+void gamestate_print(void);          // 'X': "STATE <hex>"
+void gamestate_apply_received(void); // 'Y': restore the blob received over UART
+
+// Called from the UART RX ISR while 'Y' is being received
+bool gamestate_rx_begin(void);       // False while the last blob is still pending
+void gamestate_rx_byte(uint8_t byte);
+void gamestate_rx_end(bool valid);
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "simon.h"
+#include "flags.h"
+
+// Main loop health, timed with the RTC (32.768 kHz, ~31us resolution):
+// main loop passes in the last second, their mean and the longest pass,
+// and for each game state how often it was entered, the time spent in it
+// and the longest pass that ended in it.
+//
+// 'H' prints "HEALTH LOOP <passes/s> <mean us> <max us>" and one line per
+// state, "HEALTH <state> <entries> <ms> <max us>". 'M' turns a binary
+// frame every HEALTH_FRAME_MS on and off (tools/health_decode.py reads
+// them); frames are held back while a session is recorded or the board
+// is linked, whose streams they would corrupt. Each frame covers the time
+// since the last; a report goes out a line per main loop pass, each line
+// covering the time since that line was last reported.
+// Disable with -DHEALTH_ENABLE=0; HEALTH_LOOP_PASS() and HEALTH_STATE()
+// then compile to nothing.
+#ifndef HEALTH_ENABLE
+#define HEALTH_ENABLE 1
+#endif
+
+// Energy accounting, reported with the rest by 'H' (frames leave it out).
+// A pass is busy if some task had work (HEALTH_BUSY(): a bus message was
+// taken, a character sent or the game dispatched an event) and idle
+// otherwise, the time a sleeping main loop would sleep. Busy passes are
+// charged to the state as active time; also counted are the time a tone
+// plays and the time the display shows anything, and its lit segments
+// times time. Each state line gains "<active ms>", followed by
+// "HEALTH TONE <ms>" and "HEALTH DISPLAY <ms> <segment ms>";
+// tools/energy_model.py turns a report into energy per game.
+// Disable with -DHEALTH_ENERGY=0.
+#ifndef HEALTH_ENERGY
+#define HEALTH_ENERGY HEALTH_ENABLE
+#endif
+#if HEALTH_ENERGY && !HEALTH_ENABLE
+#error "HEALTH_ENERGY needs HEALTH_ENABLE"
+#endif
+
+#ifndef HEALTH_FRAME_MS
+#define HEALTH_FRAME_MS 1000
+#endif
+
+// Frame layout, multi-byte values little-endian:
+//   HEALTH_FRAME_MARK, payload length (1)
+//   passes in the last second (2), that second's length in RTC counts (2),
+//   longest pass in RTC counts (2)
+//   per state: entries (2), time in 1/1024 s (2)
+//   CRC-16/CCITT of the length and payload (2)
+#define HEALTH_FRAME_MARK '\x1f'
+#define HEALTH_PAYLOAD_SIZE (6 + 4 * SIMON_STATE_COUNT)
+#define HEALTH_FRAME_SIZE (2 + HEALTH_PAYLOAD_SIZE + 2)
+
+#if HEALTH_ENABLE
+void health_init(void);             // Once the RTC is running
+void health_loop_pass(void);        // End of each main loop pass
+void health_state(uint8_t next);    // The game entered a state
+void health_task(void);             // Sends frames while they are on (main loop)
+bool health_print_report(uint8_t line); // 'H', a line per call, true while more follow
+void health_stream_toggle(void);    // 'M'
+#define HEALTH_LOOP_PASS() health_loop_pass()
+#define HEALTH_STATE(next) health_state(next)
+#else
+#define HEALTH_LOOP_PASS() ((void)0)
+#define HEALTH_STATE(next) ((void)0)
+#endif
+
+#if HEALTH_ENERGY
+#define HEALTH_BUSY() FLAG_SET(FLAG_PASS_BUSY)
+#else
+#define HEALTH_BUSY() ((void)0)
+#endif
+
+#endif
@@ -7,6 +7,8 @@
 void system_init(void);
 // Peripheral initialisation (display, buzzer, uart, etc.)
 void peripherals_init(void);
+// Peripherals not needed until the first round (ADC, PWM), after sei()
+void peripherals_init_deferred(void);
 
 
 
@@ -0,0 +1,44 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// High score table, kept sorted best first. The capacity is set at build
+// time; names are packed back to back in a shared arena (in rank order,
+// not terminated) instead of each entry reserving MAX_NAME_LEN + 1 bytes.
+
+#ifndef LEADERBOARD_SIZE
+#define LEADERBOARD_SIZE 5
+#endif
+
+// Bytes shared by all names. When a long name does not fit, entries below
+// it are dropped to make room, and as a last resort the name is truncated.
+#ifndef LEADERBOARD_NAME_ARENA
+#define LEADERBOARD_NAME_ARENA (LEADERBOARD_SIZE * 8)
+#endif
+
+// Break leaderboard ties by mean reaction time (faster ranks higher)
+#ifndef LEADERBOARD_TIEBREAK_SPEED
+#define LEADERBOARD_TIEBREAK_SPEED 1
+#endif
+
+#define MAX_NAME_LEN 20
+#define REACTION_UNKNOWN 0xFFFF
+
+// Restore the leaderboard from EEPROM (once, at boot)
+void leaderboard_load(void);
+
+// Returns true if a game with this score would make the table
+bool leaderboard_qualifies(uint8_t score, uint16_t reaction_ms);
+
+// Adds a player to the leaderboard if eligible; leaderboard_task() then
+// saves it to EEPROM
+void add_player_to_leaderboard(const char *name, uint8_t score, uint16_t reaction_ms);
+void leaderboard_task(void);
+
+// Print the high scores table via UART, a line per call: an empty line,
+// then one per entry. Returns true while more lines follow.
+bool uart_print_high_scores(uint8_t line);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Head-to-head play between two boards. Their USART0s meet at a relay
+// that forwards link frames from one board to the other and everything
+// else between each board and its own console (sim/duel.c is a host
+// stand-in); console commands keep working while linked. 'V' on either
+// console starts a match: that board becomes the master, picks the seed
+// (its current game's) and both restart the game from it. Each round
+// starts on both boards at the same moment and the other board's inputs
+// are sent to the master as they are judged, which announces the round:
+// both correct, the one who finished first wins; a wrong input loses
+// (both wrong: a draw). The match ends with the first round someone
+// fails, and 'V' again ends it early.
+//
+// Each board prints "LINK ROUND <n> WIN|LOSE|DRAW <own us> <other us>",
+// the times from the round's start to the last input or FAIL, and at the
+// end "LINK MATCH <won> <lost> <drawn>". 'v' prints "LINK SYNC <offset us>
+// <delay us> <drift ppm> <samples> <max late us>": the master's estimate
+// of the other board's clock offset, the round trip delay of the sample
+// it is based on, the clock rate difference and the samples taken, and on
+// either board the latest a round of this match started against the
+// agreed time (the pass granularity of the main loop).
+//
+// Clock sync: the master pings every LINK_PING_MS, sending only with the
+// transmitter idle so its timestamps are taken as the mark byte goes out,
+// and receive timestamps are taken in the RX ISR as the mark arrives. Of
+// each LINK_WINDOW pings the one with the shortest round trip is kept,
+// and an alpha-beta filter over these windows tracks the offset and the
+// drift. The master sets each round's
+// start LINK_LEAD_MS ahead and sends it in the other board's clock; the
+// lead covers the START frame (10 bytes, ~10.4ms at 9600 baud) and any
+// relay delay. Either handshake frame may be lost (a bad CRC, a full
+// receive queue): the slave sends READY every LINK_PING_MS until it has
+// the START, and the master answers each one with the START again. A
+// START that only arrives after the agreed time starts that round late
+// on the slave, which shows in the 'v' max late figure.
+// Disable with -DLINK_ENABLE=0.
+#ifndef LINK_ENABLE
+#define LINK_ENABLE 1
+#endif
+#ifndef LINK_LEAD_MS
+#define LINK_LEAD_MS 250
+#endif
+#ifndef LINK_PING_MS
+#define LINK_PING_MS 50
+#endif
+#ifndef LINK_WINDOW
+#define LINK_WINDOW 16
+#endif
+// No frame from the other board for this long ends the match
+#ifndef LINK_TIMEOUT_MS
+#define LINK_TIMEOUT_MS 2000
+#endif
+
+// Frame layout, multi-byte values little-endian:
+//   LINK_MARK, type (1), payload, CRC-8/CCITT of the type and payload (1)
+// Types and their payloads ("slave": the board that did not press 'V'):
+//   'J' join       seed (4)
+//   'A' accept     -
+//   'P' ping       sequence (1)
+//   'Q' pong       sequence (1)
+//   'T' times      sequence (1), ping received and pong sent in the
+//                  slave's clock (4 + 4)
+//   'G' ready      round (1)
+//   'S' start      round (1), start in the slave's clock (4), playback
+//                  delay (2)
+//   'I' input      round (1), index (1), correct (1), us from the round's
+//                  start to the press (4)
+//   'W' result     round (1), winner (1: 0 draw, 1 master, 2 slave),
+//                  master's and slave's time in us, LINK_FAILED for a
+//                  wrong input (4 + 4)
+//   'E' end        -
+// Times are timer_micros() values, which wrap every ~71 minutes.
+#define LINK_MARK '\x1d'
+#define LINK_MAX_PAYLOAD 10
+#define LINK_FAILED 0xFFFFFFFFUL
+
+#if LINK_ENABLE
+// Payload bytes of a frame type, or 0xFF if it is not one
+uint8_t link_payload_size(uint8_t type);
+
+// USART0 RX ISR: what became of a byte. Outside link mode (joining a
+// match, in one, or up to LINK_TIMEOUT_MS after one) only a JOIN frame is
+// taken, so console input passes through; a mark not followed by a frame
+// it takes goes to the console, late, with the next byte.
+#define LINK_RX_TAKEN 1  // The byte is the link's
+#define LINK_RX_MARK  2  // The console gets the mark held before it first
+uint8_t link_rx_byte(uint8_t byte);
+
+void link_task(void);         // Main loop
+void link_toggle(void);       // 'V'
+void link_print_report(void); // 'v'
+
+// Game hooks, which do nothing unless linked. The game calls
+// link_round_ready() as it enters SIMON_GENERATE, then plays the round
+// once link_round_go() is true, with link_playback_delay() if that is not
+// 0 (the master's delay, so both play at the same speed).
+void link_round_ready(uint8_t round, uint16_t delay);
+bool link_round_go(void);
+uint16_t link_playback_delay(void);
+void link_input(uint8_t index, bool correct, uint32_t press_us);
+#endif
+
+#endif
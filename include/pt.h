@@ -0,0 +1,43 @@
+#ifndef PT_H
+#define PT_H
+
+#include <stdint.h>
+
+// Protothreads: a task function that can return part-way through and carry
+// on from the same point on its next call. The resume point is a line
+// number kept in pt_t and jumped to with a switch, so locals do not survive
+// a yield (make them static), and the PT_ macros cannot be used inside
+// another switch statement.
+//
+//     void task(pt_t *pt) {
+//         PT_BEGIN(pt);
+//         start_something();
+//         PT_WAIT_UNTIL(pt, something_done());
+//         PT_END(pt);
+//     }
+
+typedef struct {
+    uint16_t lc; // Line to resume at, 0 to start from the top
+} pt_t;
+
+#define PT_BEGIN(pt) switch ((pt)->lc) { case 0:
+
+#define PT_END(pt) } (pt)->lc = 0
+
+// Return now, resume here on the next call
+#define PT_YIELD(pt)                                \
+    do {                                            \
+        (pt)->lc = __LINE__;                        \
+        return;                                     \
+        case __LINE__:;                             \
+    } while (0)
+
+// Return until cond holds; carry straight on if it already does
+#define PT_WAIT_UNTIL(pt, cond)                     \
+    do {                                            \
+        (pt)->lc = __LINE__;                        \
+        case __LINE__:                              \
+        if (!(cond)) return;                        \
+    } while (0)
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+
+// Session recording: while on ('R' command, again to stop) every input the
+// firmware reads (button pin levels, UART bytes, ADC results) and every
+// display and tone change is streamed over UART with its time, so a field
+// session can be replayed on the host (sim/replay) and checked for
+// divergence. Starting a recording restarts the game from its current seed.
+// Disable with -DRECORD_ENABLE=0; RECORD() then compiles to nothing.
+#ifndef RECORD_ENABLE
+#define RECORD_ENABLE 1
+#endif
+
+// Events buffered between main loop passes, must be a power of two
+// (7 bytes each)
+#ifndef RECORD_SIZE
+#define RECORD_SIZE 16
+#endif
+
+// Each event is sent as one line: RECORD_MARK, the type character, the
+// milliseconds since the previous event, ':', the value, '\n' (numbers in
+// decimal). Game output never contains RECORD_MARK, so the two separate.
+#define RECORD_MARK '\x1e'
+
+typedef enum {
+    // Inputs
+    RECORD_PINS = 'P',    // value: PORTA button pins, on change only
+    RECORD_UART = 'U',    // value: byte received
+    RECORD_ADC = 'A',     // value: potentiometer reading
+    // Outputs
+    RECORD_DISPLAY = 'D', // value: left << 8 | right segment bytes
+    RECORD_TONE = 'T',    // value: TCA0 period, 0 when stopped
+    // Stream control, written by record.c
+    RECORD_START = 'R',   // Followed by an 'E' line of the EEPROM contents
+                          // in hex and an 'S' line with the game seed
+    RECORD_LOST = 'L',    // value: events dropped because the buffer was full
+    RECORD_STOP = 'X'
+} record_type_t;
+
+#if RECORD_ENABLE
+void record_log(uint8_t type, uint16_t value);
+// Start or stop recording (main loop)
+void record_toggle(void);
+// Send buffered events (main loop)
+void record_task(void);
+#define RECORD(type, value) record_log((type), (value))
+#else
+#define RECORD(type, value) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pt.h"
+
+// Cooperative scheduler for the main loop. Each pass runs the tasks that
+// are due in table order; a task runs to its next yield (see pt.h), so a
+// slow one delays all the others by its run time. A task is due every
+// period, or on every pass if that is 0, and misses its deadline when it
+// starts more than deadline after it was due (for every-pass tasks: after
+// its previous start).
+
+typedef enum {
+    TASK_INPUT,     // Button edges to BUS_GAME
+    TASK_AUDIO,     // Transpositions (BUS_AUDIO)
+    TASK_REPORT,    // UART reports and commands (BUS_REPORT), one at a time
+    TASK_LINK,      // Frames to and from the other board in a linked match
+    TASK_GAME,      // simon_task(): state timeouts, input, tone stops
+    TASK_UART_TX,   // Drains the UART transmit queue
+    TASK_PERSIST,   // New high scores to EEPROM
+    TASK_TELEMETRY, // Session recording stream
+    TASK_COUNT
+} task_id_t;
+
+// The scheduler's clock is the RTC (32.768kHz, ~31us); times in the task
+// table are RTC counts
+#define SCHED_MS(ms) ((uint16_t)(((ms) * 32768UL + 500) / 1000))
+
+typedef struct {
+    const char *name;
+    void (*run)(pt_t *pt);
+    uint16_t period;   // SCHED_MS(), 0 for every pass
+    uint16_t deadline; // SCHED_MS()
+} task_t;
+
+// Indexed by task_id_t, defined with the tasks (main.c)
+extern const task_t sched_tasks[TASK_COUNT];
+
+// Run time and deadline statistics, reported with 'K'. They are timed with
+// timer_micros(), read once per pass and once after each task that runs;
+// the RTC is read once per pass either way. Disable with -DSCHED_STATS=0.
+#ifndef SCHED_STATS
+#define SCHED_STATS 1
+#endif
+
+void sched_init(void);  // Every task due now
+void sched_pass(void);  // One main loop pass
+#if SCHED_STATS
+// "TASK <name> <runs> <worst us> <missed> <max late us>" for task line
+// (times saturate at 65535us), which then starts a new measurement window;
+// true while more tasks follow
+bool sched_print_report(uint8_t line);
+#endif
+
+#endif
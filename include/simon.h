@@ -4,17 +4,13 @@
 #include <stdint.h>
 #include "display_macros.h"
 
-// Timing configuration
-#define PLAYBACK_DELAY playback_delay // between 250ms and 2000ms, set by potentiometer
-
 // Simon game states matching state diagram
 typedef enum {
     SIMON_GENERATE,    // Generate sequence
     SIMON_PLAY_ON,     // Display pattern
     SIMON_PLAY_OFF,    // Gap between patterns
     AWAITING_INPUT,    // Wait for button press
-    HANDLE_INPUT,      // Process button press
-    EVALUATE_INPUT,    // Check if input matches sequence
+    HANDLE_INPUT,      // Play the pressed tone, then check it against the sequence
     SUCCESS,           // Show success pattern
     FAIL,              // Show failure pattern
     DISP_SCORE,        // Display final score
@@ -22,27 +18,47 @@ typedef enum {
     ENTER_NAME        // New state for name entry
 } simon_state_t;
 
+#define SIMON_STATE_COUNT (ENTER_NAME + 1)
+
 // Function prototypes
 void simon_init(void);
 void simon_task(void);
 void display_two_digit_number(uint8_t num);  // Add declaration
-void uart_print_high_scores(void);  // Print high scores table via UART
 void update_lfsr_state(uint32_t new_seed);  // Function to update LFSR state
+uint32_t simon_game_seed(void);  // Seed the current game's sequence starts from
+
+// Press-to-sound fast path. When enabled, a button pressed while the game
+// awaits input is sounded from the input ISR; state_awaiting_input() then
+// confirms (or cancels) it. Disable with -DSIMON_FAST_PATH=0.
+#ifndef SIMON_FAST_PATH
+#define SIMON_FAST_PATH 1
+#endif
+// Called from ISRs with newly pressed PORTA pins and the time (timer_micros())
+// of the lowest one's first edge
+void simon_input_edge(uint8_t pressed, uint32_t edge_us);
+void simon_print_latency(void);  // Print edge-to-tone latency stats via UART
+
+// Cycle profiling of simon_task() dispatch, reported with the 'C' command
+#ifndef SIMON_PROFILE_DISPATCH
+#define SIMON_PROFILE_DISPATCH 0
+#endif
+#if SIMON_PROFILE_DISPATCH
+void simon_print_dispatch_profile(void);
+#endif
 
-// External variable declarations for main.c
-extern uint32_t game_seed;
-
-// State handler prototypes for simon.c state machine
-void state_generate(void);
-void state_play_on(void);
-void state_play_off(void);
-void state_awaiting_input(void);
-void state_handle_input(void);
-void state_evaluate_input(void);
-void state_success(void);
-void state_fail(void);
-void state_disp_score(void);
-void state_disp_blank(void);
-void state_enter_name(void); // Prototype for state_enter_name
+// Turbo tempo for soak testing: 'Z' over UART toggles a playback delay of
+// SIMON_TURBO_DELAY_MS in place of the potentiometer's 250-2000ms, which
+// also shortens the SUCCESS, FAIL and score phases; 'z' reports the rounds
+// played and deadlines missed. Disable with -DSIMON_TURBO=0.
+#ifndef SIMON_TURBO
+#define SIMON_TURBO 1
+#endif
+#ifndef SIMON_TURBO_DELAY_MS
+#define SIMON_TURBO_DELAY_MS 8
+#endif
+#if SIMON_TURBO
+void simon_turbo_toggle(void);
+void simon_print_turbo(void);
+#endif
 
 #endif // SIMON_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Consistent snapshots of multi-byte state shared between ISRs and the
+// main loop, without turning interrupts off. Each such variable (or group
+// of variables) is volatile and has a sequence byte. Writers run in ISR
+// context, which nothing else interrupts, and bump the sequence after each
+// update; a reader copies the value and retries if the sequence changed,
+// i.e. an ISR ran part-way through the copy. A reader that is itself in an
+// ISR (or has interrupts off) always succeeds on the first pass.
+//
+//     ISR:        count++; SNAPSHOT_PUBLISH(count_seq);
+//     main loop:  SNAPSHOT_READ(count_seq, copy, count);
+//
+// State written by the main loop and read by ISRs, or written from both
+// contexts at once, still needs SREG/cli() (see bus.c). So does a 16-bit
+// peripheral register read in both contexts: all of them share one TEMP
+// latch, which a read in an ISR between the two bytes overwrites.
+
+typedef volatile uint8_t snapshot_seq_t;
+
+// The copy a reader makes. The host bench defines it to copy byte by byte
+// and run ISRs in between, to check that every reader retries.
+#ifndef SNAPSHOT_COPY
+#define SNAPSHOT_COPY(dst, src) ((dst) = (src))
+#endif
+
+static inline uint8_t snapshot_begin(const snapshot_seq_t *seq)
+{
+    return *seq;
+}
+
+// True if a writer ran since snapshot_begin() returned begin
+static inline bool snapshot_retry(const snapshot_seq_t *seq, uint8_t begin)
+{
+    return *seq != begin;
+}
+
+#define SNAPSHOT_PUBLISH(seq) ((seq)++)
+
+#define SNAPSHOT_READ(seq, dst, src)                    \
+    do {                                                \
+        uint8_t begin_;                                 \
+        do {                                            \
+            begin_ = snapshot_begin(&(seq));            \
+            SNAPSHOT_COPY(dst, src);                    \
+        } while (snapshot_retry(&(seq), begin_));       \
+    } while (0)
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef STACKMON_H
+#define STACKMON_H
+
+#include <stdint.h>
+
+// Stack high-water monitoring. SRAM between the end of static data
+// (__heap_start) and RAMEND is painted with STACK_PAINT before main() runs;
+// the stack grows down into it, so paint still found above __heap_start is
+// headroom that has never been used. Queried over UART with 'S'.
+// Disable with -DSTACK_MONITOR=0.
+#ifndef STACK_MONITOR
+#define STACK_MONITOR 1
+#endif
+
+#define STACK_PAINT 0xC5
+
+#if STACK_MONITOR
+uint16_t stack_unused(void);      // Bytes below the deepest stack use so far
+void stack_print_usage(void);     // Print "STACK <static> <peak> <unused>" via UART
+#endif
+
+#endif
@@ -1,7 +1,16 @@
 #include "stdint.h"
 
+// Timebase: TCB0 and TCB1 chained through EVSYS count milliseconds in
+// hardware. Their only interrupt is TCB1's periodic 5ms tick, which
+// debounces the buttons, multiplexes the display and extends the count;
+// no compare is armed for the scheduler's deadlines, which the main loop
+// polls. The RTC's overflow interrupt, every 2s, extends its count for
+// rtc_count32(). All readers are safe from ISRs and the main loop.
+
 void timer_init(void);
-extern volatile uint16_t elapsed_time_in_milliseconds;
-extern volatile uint16_t playback_delay;
-extern volatile uint8_t pb_debounced_state;
-void prepare_delay(void);
\ No newline at end of file
+void prepare_delay(void);
+uint16_t timer_elapsed_ms(void);  // Since the last prepare_delay()
+uint32_t timer_millis(void);      // Since timer_init()
+uint32_t timer_micros(void);      // Since timer_init(), 0.3us steps, wraps after ~71 minutes
+uint16_t rtc_count(void);         // RTC.CNT, 32.768kHz, wraps every 2s
+uint32_t rtc_count32(void);       // RTC.CNT extended by its wraps, ~36 hours
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Event trace ring: timestamped records of state transitions, inputs,
+// tones and UART commands, dumped over UART with the 'T' command.
+// Disable with -DTRACE_ENABLE=0; TRACE() then compiles to nothing.
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+
+// Number of records kept, must be a power of two (6 bytes each)
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 32
+#endif
+
+typedef enum {
+    TRACE_STATE = 1,      // arg: new simon_state_t
+    TRACE_INPUT = 2,      // arg: button pressed (1-4)
+    TRACE_TONE_START = 3, // arg: tone (0-3)
+    TRACE_TONE_STOP = 4,  // arg: unused
+    TRACE_UART_CMD = 5    // arg: command character
+} trace_type_t;
+
+typedef struct {
+    uint32_t time; // rtc_count32() when logged (32.768kHz)
+    uint8_t type;
+    uint8_t arg;
+} trace_record_t;
+
+#if TRACE_ENABLE
+void trace_log(uint8_t type, uint8_t arg);
+bool trace_dump(uint8_t line);  // A line per call, true while more follow
+#define TRACE(type, arg) trace_log((type), (arg))
+#else
+#define TRACE(type, arg) ((void)0)
+#endif
+
+#endif
@@ -1,28 +1,35 @@
 #include <stdint.h>
-// Control flags
-extern volatile uint8_t uart_play;
-extern volatile uint8_t uart_stop;
-extern volatile uint8_t uart_reset;
-extern volatile uint32_t new_uart_seed;
-// Pending seed update from UART
-extern volatile uint32_t has_pending_uart_seed;
-extern volatile uint8_t update_seed;
-extern volatile uint8_t uart_button_flag;
+#include <stdbool.h>
+// Game commands are posted to BUS_GAME, frequency changes to BUS_AUDIO and
+// report requests to BUS_REPORT (see bus.h)
 
 // Game reporting
 void report_score(uint16_t score, uint8_t is_success);
 
 void uart_puts(const char *str);
 
+// Output is queued and sent by uart_tx_task(), called from the main loop;
+// uart_send() only waits when UART_TX_SIZE characters are already queued.
+// Must be a power of two.
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE 64
+#endif
+
 void uart_send(char c);
 
+void uart_tx_task(void);
+
+bool uart_tx_idle(void);  // Nothing left in the queue
+
+uint8_t uart_tx_room(void);  // Characters uart_send() takes without waiting
+
+bool uart_tx_done(void);  // and the last character fully sent
+
 void uart_init(void);
 
 void uart_putnum(uint16_t num);
 
-extern void update_buzzer_frequencies(uint8_t button_pressed);
-
-extern volatile uint8_t uart_button_flag;
+void uart_putnum32(uint32_t num);
 
 void uart_send_str(const char* str);
 
@@ -32,6 +39,4 @@ char uart_receive(void);
 
 void uart_enable_name_entry(void);
 
-void uart_disable_name_entry(void);
-
-void uart_print_high_scores(void);
\ No newline at end of file
+void uart_disable_name_entry(void);
\ No newline at end of file
@@ -0,0 +1,578 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// The state machine, leaderboard and EEPROM store are compiled as part of
+// this file so their state can be inspected and reset between games
+#define main firmware_main
+#include "../src/main.c"
+#undef main
+#include "../src/simon.c"
+#include "../src/leaderboard.c"
+#include "../src/eeprom_store.c"
+
+// Plays many games against the firmware compiled for the host, with a
+// simulated player answering over the UART in turbo tempo, and aggregates
+// score, sequence and leaderboard statistics.
+//
+//   batch [-n seeds] [-g games] [-s first] [-j jobs] [-e error] [-r min,max]
+//         [-t grain] [-c seeds.csv]
+//
+// Each seed is one session from a blank EEPROM: -g games, the first from
+// the seed and each later one from the seed the last game over chained to.
+// The player presses the right button with probability 1 - error per step,
+// after a reaction time drawn from min..max ms, and enters a name whenever
+// the leaderboard asks. It checks the firmware against its own model of
+// the LFSR: an unexpected SUCCESS or FAIL, a wrong score or a wrong chained
+// seed is counted as a desync. At the end of each session the leaderboard
+// is reloaded from EEPROM and compared with the one in RAM.
+//
+// The firmware keeps its state in file-scope statics, so workers are
+// forked processes (one per core by default), not threads. Seed ranges are
+// shared out through a work-stealing pool in shared memory: each worker
+// splits the range it takes down to -t seeds, keeping the halves it has not
+// started on its own deque, and idle workers steal the oldest (largest)
+// range from the others. Results are the same for any -j.
+
+#if !SIMON_TURBO
+#error "batch plays in turbo tempo, build with SIMON_TURBO=1"
+#endif
+
+#ifndef BATCH_PASSES
+#define BATCH_PASSES 1
+#endif
+
+#define DEQUE_SIZE 128      // Ranges a worker can hold, at most log2(seeds) deep
+#define MAX_SCORE 256
+#define SESSION_LIMIT_MS (60UL * 60 * 1000)
+
+void TCB1_INT_vect(void);
+void USART0_RXC_vect(void);
+void NVMCTRL_EE_vect(void);
+void RTC_CNT_vect(void);
+
+// ----------------------  OUTPUT  ----------------------
+
+// The game's UART output is not needed; the player watches state directly
+void __wrap_uart_send(char c) { (void)c; }
+void __wrap_uart_puts(const char *str) { (void)str; }
+void __wrap_uart_send_str(const char *str) { (void)str; }
+void __wrap_uart_putnum(uint16_t num) { (void)num; }
+void __wrap_uart_putnum32(uint32_t num) { (void)num; }
+
+// ----------------------  STATISTICS  ----------------------
+
+typedef struct {
+    uint32_t seed;
+    uint16_t games;
+    uint16_t min_score, max_score;
+    uint32_t total_score;
+    uint16_t entries;    // Names entered
+    uint16_t evictions;  // Entries pushed off a full table
+    uint16_t new_best;   // Entries that took first place
+    uint8_t desyncs;
+    uint8_t persist_errors;
+} seed_result_t;
+
+typedef struct {
+    uint64_t seeds, games, steals, ms;
+    uint64_t score_hist[MAX_SCORE];
+    uint64_t steps[4];   // Steps of each game's sequence, up to its score
+    uint64_t entries, evictions, new_best;
+    uint64_t desyncs, persist_errors;
+    double seconds;
+} worker_stats_t;
+
+// ----------------------  WORK-STEALING POOL  ----------------------
+// Chase-Lev deques of seed index ranges, packed as lo << 32 | hi. The owner
+// pushes and pops at the bottom; thieves take from the top.
+
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic uint64_t ranges[DEQUE_SIZE];
+    worker_stats_t stats;
+} worker_t;
+
+typedef struct {
+    _Atomic uint64_t remaining;  // Seeds not yet finished
+    unsigned workers;
+    worker_t worker[];
+} pool_t;
+
+static uint64_t pack(uint32_t lo, uint32_t hi) { return (uint64_t)lo << 32 | hi; }
+
+static int deque_push(worker_t *w, uint64_t range)
+{
+    int64_t b = atomic_load(&w->bottom);
+    if (b - atomic_load(&w->top) >= DEQUE_SIZE) return 0;
+    atomic_store(&w->ranges[b % DEQUE_SIZE], range);
+    atomic_store(&w->bottom, b + 1);
+    return 1;
+}
+
+static int deque_pop(worker_t *w, uint64_t *range)
+{
+    int64_t b = atomic_load(&w->bottom) - 1;
+    atomic_store(&w->bottom, b);
+    int64_t t = atomic_load(&w->top);
+    if (t > b) {
+        atomic_store(&w->bottom, b + 1);
+        return 0;
+    }
+    *range = atomic_load(&w->ranges[b % DEQUE_SIZE]);
+    if (t < b) return 1;
+    // Last range: race the thieves for it
+    int won = atomic_compare_exchange_strong(&w->top, &t, t + 1);
+    atomic_store(&w->bottom, b + 1);
+    return won;
+}
+
+static int deque_steal(worker_t *w, uint64_t *range)
+{
+    int64_t t = atomic_load(&w->top);
+    if (t >= atomic_load(&w->bottom)) return 0;
+    *range = atomic_load(&w->ranges[t % DEQUE_SIZE]);
+    return atomic_compare_exchange_strong(&w->top, &t, t + 1);
+}
+
+// ----------------------  PLAYER  ----------------------
+
+typedef struct {
+    double error;
+    unsigned reaction_min, reaction_max;
+    unsigned games;
+} player_config_t;
+
+static uint64_t rng_state;
+
+// splitmix64, so each session's player is reproducible from its seed alone
+static uint64_t rng_next(void)
+{
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(void) { return (rng_next() >> 11) * (1.0 / 9007199254740992.0); }
+
+// The player's own model of the sequence, independent of simon.c
+static uint8_t model_step(uint32_t *lfsr)
+{
+    uint8_t bit = *lfsr & 1;
+    *lfsr >>= 1;
+    if (bit) *lfsr ^= LFSR_MASK;
+    return *lfsr & 0b11;
+}
+
+static uint32_t now;
+
+static void uart_rx(char c)
+{
+    USART0.RXDATAL = c;
+    USART0_RXC_vect();
+}
+
+// The RTC (timer.c): overflows as the count wraps, every 2s
+static void rtc_set(uint16_t cnt)
+{
+    uint16_t last = RTC.CNT;
+    RTC.CNT = cnt;
+    if (cnt < last) {
+        RTC.INTFLAGS = RTC_OVF_bm;
+        RTC_CNT_vect();
+        RTC.INTFLAGS = 0; // Write-one-to-clear on the board
+    }
+}
+
+static void tick(void)
+{
+    // The timebase (timer.c): TCB1 counts the millisecond, and raises
+    // CAPT as it reaches CCMP
+    TCB1.CNT = TCB1.CNT == TCB1.CCMP ? 0 : TCB1.CNT + 1;
+    if (TCB1.CNT == TCB1.CCMP) {
+        TCB1.INTFLAGS = TCB_CAPT_bm;
+        TCB1_INT_vect();
+        TCB1.INTFLAGS = 0; // Write-one-to-clear on the board
+    }
+    while (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm)
+        NVMCTRL_EE_vect();
+    // The scheduler's clock (scheduler.c), 32768 counts a second
+    rtc_set((uint16_t)(now * 32768ULL / 1000));
+    for (int pass = 0; pass < BATCH_PASSES; pass++)
+        sched_pass();
+    now++;
+}
+
+// Back to a blank EEPROM and an empty leaderboard, as on a new board
+static void reset_storage(void)
+{
+    while (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm)
+        NVMCTRL_EE_vect();
+    memset(host_eeprom, 0xFF, EEPROM_SIZE);
+    queue_count = 0;
+    queue_head = 0;
+    next_seq = 0;
+    next_page = 0;
+    leaderboard_count = 0;
+    names_used = 0;
+    leaderboard_load();
+}
+
+// Reload the leaderboard from EEPROM and compare the persisted entries
+static int leaderboard_persisted(void)
+{
+    // Writes the persistence task has not started yet (it runs every 10ms)
+    for (uint8_t i = 0; i < STORE_LIVE; i++) {
+        leaderboard_task();
+        while (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm)
+            NVMCTRL_EE_vect();
+    }
+    leaderboard_entry_t saved[LEADERBOARD_SIZE];
+    char saved_names[LEADERBOARD_NAME_ARENA];
+    uint8_t count = leaderboard_count < STORE_LIVE ? leaderboard_count : STORE_LIVE;
+    uint16_t used = name_offset(count);
+    memcpy(saved, leaderboard, sizeof(saved));
+    memcpy(saved_names, names, used);
+
+    leaderboard_count = 0;
+    names_used = 0;
+    leaderboard_load();
+    int ok = leaderboard_count >= count && !memcmp(names, saved_names, used);
+    for (uint8_t i = 0; ok && i < count; i++)
+        ok = leaderboard[i].score == saved[i].score &&
+             leaderboard[i].reaction_ms == saved[i].reaction_ms &&
+             leaderboard[i].name_len == saved[i].name_len;
+    return ok;
+}
+
+static void play_session(uint32_t seed, const player_config_t *cfg,
+                         seed_result_t *result, worker_stats_t *stats)
+{
+    char hex[9];
+    rng_state = seed;
+    reset_storage();
+    snprintf(hex, sizeof(hex), "%08lx", (unsigned long)seed);
+    uart_rx('9');
+    for (int i = 0; i < 8; i++) uart_rx(hex[i]);
+    uart_rx('0');
+    tick();
+
+    memset(result, 0, sizeof(*result));
+    result->seed = seed;
+    result->min_score = 0xFFFF;
+
+    uint32_t game_seed_model = seed;
+    uint8_t round = 1, index = 0;
+    uint8_t wrong = 0;           // Pressed a wrong button this round
+    uint32_t press_at = 0;       // 0: no press scheduled
+    uint8_t press = 0;
+    const char *name = NULL;
+    char name_buf[8];
+    simon_state_t seen = state;
+    uint32_t start = now;
+
+    while (result->games < cfg->games || seen == ENTER_NAME || seen == DISP_SCORE ||
+           seen == DISP_BLANK || seen == FAIL) {
+        if (now - start > SESSION_LIMIT_MS) {
+            result->desyncs++;
+            break;
+        }
+        if (press_at && now >= press_at) {
+            uart_rx('0' + press);
+            press_at = 0;
+        }
+        if (name) {
+            char c = *name ? *name++ : '\n';
+            uart_rx(c);
+            if (c == '\n') name = NULL;
+        }
+        tick();
+
+        simon_state_t s = state;
+        if (s == seen) continue;
+        simon_state_t from = seen;
+        seen = s;
+
+        if (s == AWAITING_INPUT) {
+            if (from == SIMON_PLAY_OFF) {
+                index = 0;
+                wrong = 0;
+            }
+            uint32_t lfsr = game_seed_model;
+            uint8_t step = 0;
+            for (uint8_t i = 0; i <= index; i++) step = model_step(&lfsr);
+            if (rng_unit() < cfg->error) {
+                step = (step + 1 + rng_next() % 3) & 3;
+                wrong = 1;
+            }
+            index++;
+            press = step + 1;
+            press_at = now + cfg->reaction_min +
+                       rng_next() % (cfg->reaction_max - cfg->reaction_min + 1);
+        } else if (s == SUCCESS) {
+            if (wrong || index != round || round_length != round) result->desyncs++;
+            round++;
+        } else if (s == FAIL) {
+            if (!wrong || round_length != round) result->desyncs++;
+            uint32_t lfsr = game_seed_model;
+            for (uint8_t i = 0; i < round; i++)
+                stats->steps[model_step(&lfsr)]++;
+            stats->score_hist[round < MAX_SCORE ? round : MAX_SCORE - 1]++;
+            result->games++;
+            result->total_score += round;
+            if (round < result->min_score) result->min_score = round;
+            if (round > result->max_score) result->max_score = round;
+            game_seed_model = lfsr;
+        } else if (s == DISP_SCORE) {
+            if (game_seed != game_seed_model) result->desyncs++;
+            round = 1;
+        } else if (s == ENTER_NAME) {
+            result->entries++;
+            if (leaderboard_count == LEADERBOARD_SIZE) result->evictions++;
+            leaderboard_entry_t entry = { .score = score_to_display, .reaction_ms = reaction_mean_ms() };
+            if (!leaderboard_count || ranks_below(&leaderboard[0], &entry))
+                result->new_best++;
+            snprintf(name_buf, sizeof(name_buf), "g%u", (unsigned)result->games);
+            name = name_buf;
+        }
+    }
+    stats->ms += now - start;
+    result->persist_errors = !leaderboard_persisted();
+}
+
+// ----------------------  WORKERS  ----------------------
+
+typedef struct {
+    uint32_t first, count, grain;
+    player_config_t player;
+} batch_config_t;
+
+static void merge_result(worker_stats_t *stats, const seed_result_t *r)
+{
+    stats->seeds++;
+    stats->games += r->games;
+    stats->entries += r->entries;
+    stats->evictions += r->evictions;
+    stats->new_best += r->new_best;
+    stats->desyncs += r->desyncs;
+    stats->persist_errors += r->persist_errors;
+}
+
+static void worker_run(pool_t *pool, unsigned id, const batch_config_t *cfg, seed_result_t *results)
+{
+    worker_t *self = &pool->worker[id];
+    worker_stats_t *stats = &self->stats;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // Same init as main(), once per worker
+    PORTA.IN = 0xFF;
+    ADC0.INTFLAGS = ADC_RESRDY_bm;
+    board_init();
+    simon_turbo_toggle();
+
+    unsigned victim = id;
+    while (atomic_load(&pool->remaining)) {
+        uint64_t range;
+        if (!deque_pop(self, &range)) {
+            victim = (victim + 1) % pool->workers;
+            if (victim == id || !deque_steal(&pool->worker[victim], &range)) {
+                sched_yield();
+                continue;
+            }
+            stats->steals++;
+        }
+        uint32_t lo = range >> 32, hi = (uint32_t)range;
+        // Leave the upper halves for this worker later, or for thieves
+        while (hi - lo > cfg->grain) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (!deque_push(self, pack(mid, hi))) break;
+            hi = mid;
+        }
+        for (uint32_t i = lo; i < hi; i++) {
+            play_session(cfg->first + i, &cfg->player, &results[i], stats);
+            merge_result(stats, &results[i]);
+        }
+        atomic_fetch_sub(&pool->remaining, hi - lo);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+// ----------------------  REPORT  ----------------------
+
+static void report(const pool_t *pool, const seed_result_t *results, uint32_t count, double seconds)
+{
+    worker_stats_t total = { 0 };
+    for (unsigned w = 0; w < pool->workers; w++) {
+        const worker_stats_t *s = &pool->worker[w].stats;
+        total.seeds += s->seeds;
+        total.games += s->games;
+        total.steals += s->steals;
+        total.ms += s->ms;
+        for (int i = 0; i < MAX_SCORE; i++) total.score_hist[i] += s->score_hist[i];
+        for (int i = 0; i < 4; i++) total.steps[i] += s->steps[i];
+        total.entries += s->entries;
+        total.evictions += s->evictions;
+        total.new_best += s->new_best;
+        total.desyncs += s->desyncs;
+        total.persist_errors += s->persist_errors;
+    }
+
+    printf("%lu seeds, %lu games, %.1f h of play in %.2f s (%.0f games/s, %u workers, %lu steals)\n",
+           (unsigned long)total.seeds, (unsigned long)total.games, total.ms / 3.6e6, seconds,
+           seconds > 0 ? total.games / seconds : 0, pool->workers, (unsigned long)total.steals);
+    for (unsigned w = 0; w < pool->workers; w++) {
+        const worker_stats_t *s = &pool->worker[w].stats;
+        printf("  worker %-3u %8lu seeds %8lu steals %7.2f s\n", w, (unsigned long)s->seeds,
+               (unsigned long)s->steals, s->seconds);
+    }
+
+    // Scores, and the spread of each seed's mean score
+    uint64_t games = 0, sum = 0;
+    int top = 0;
+    for (int i = 0; i < MAX_SCORE; i++) {
+        games += total.score_hist[i];
+        sum += total.score_hist[i] * (uint64_t)i;
+        if (total.score_hist[i]) top = i;
+    }
+    printf("\nscore    games      share\n");
+    for (int i = 1; i <= top; i++)
+        if (total.score_hist[i])
+            printf("%5d %8lu %9.4f%%\n", i, (unsigned long)total.score_hist[i],
+                   100.0 * total.score_hist[i] / games);
+    double mean = games ? (double)sum / games : 0, low = 1e9, high = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!results[i].games) continue;
+        double m = (double)results[i].total_score / results[i].games;
+        if (m < low) low = m;
+        if (m > high) high = m;
+    }
+    printf("mean %.3f, per-seed means %.3f..%.3f\n", mean, count ? low : 0, high);
+
+    // Each step should come up a quarter of the time
+    uint64_t steps = total.steps[0] + total.steps[1] + total.steps[2] + total.steps[3];
+    double chi2 = 0;
+    printf("\nsteps   ");
+    for (int i = 0; i < 4; i++) {
+        double expected = steps / 4.0;
+        chi2 += expected ? (total.steps[i] - expected) * (total.steps[i] - expected) / expected : 0;
+        printf(" %d: %.4f%%", i, steps ? 100.0 * total.steps[i] / steps : 0);
+    }
+    printf("  chi2 %.2f (3 dof, 7.81 at p=0.05)\n", chi2);
+
+    printf("\nleaderboard %lu entries (%.3f/game), %lu evictions, %lu new best\n",
+           (unsigned long)total.entries, games ? (double)total.entries / games : 0,
+           (unsigned long)total.evictions, (unsigned long)total.new_best);
+    printf("desyncs %lu, leaderboard persistence errors %lu\n",
+           (unsigned long)total.desyncs, (unsigned long)total.persist_errors);
+}
+
+static void write_csv(const char *path, const seed_result_t *results, uint32_t count)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "seed,games,min,mean,max,entries,evictions,new_best,desyncs,persist_errors\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const seed_result_t *r = &results[i];
+        fprintf(f, "%08lx,%u,%u,%.3f,%u,%u,%u,%u,%u,%u\n", (unsigned long)r->seed, r->games,
+                r->games ? r->min_score : 0, r->games ? (double)r->total_score / r->games : 0,
+                r->max_score, r->entries, r->evictions, r->new_best, r->desyncs, r->persist_errors);
+    }
+    fclose(f);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n seeds] [-g games] [-s first] [-j jobs] [-e error] "
+                    "[-r min,max] [-t grain] [-c seeds.csv]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    batch_config_t cfg = {
+        .first = INITIAL_SEED, .count = 1000, .grain = 16,
+        .player = { .error = 0.02, .reaction_min = 150, .reaction_max = 450, .games = 10 },
+    };
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *csv = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:g:s:j:e:r:t:c:")) != -1) {
+        switch (opt) {
+            case 'n': cfg.count = strtoul(optarg, NULL, 0); break;
+            case 'g': cfg.player.games = strtoul(optarg, NULL, 0); break;
+            case 's': cfg.first = strtoul(optarg, NULL, 16); break;
+            case 'j': jobs = strtol(optarg, NULL, 0); break;
+            case 'e': cfg.player.error = strtod(optarg, NULL); break;
+            case 'r':
+                if (sscanf(optarg, "%u,%u", &cfg.player.reaction_min, &cfg.player.reaction_max) != 2)
+                    usage(argv[0]);
+                break;
+            case 't': cfg.grain = strtoul(optarg, NULL, 0); break;
+            case 'c': csv = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (jobs < 1 || !cfg.count || !cfg.grain || !cfg.player.games || cfg.player.error <= 0 ||
+        cfg.player.reaction_max < cfg.player.reaction_min)
+        usage(argv[0]);
+    if ((uint64_t)cfg.first + cfg.count > 0x100000000ULL) {
+        fprintf(stderr, "batch: seeds past ffffffff\n");
+        return 2;
+    }
+
+    size_t pool_size = sizeof(pool_t) + jobs * sizeof(worker_t);
+    pool_t *pool = mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    seed_result_t *results = mmap(NULL, cfg.count * sizeof(seed_result_t), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED || results == MAP_FAILED) {
+        perror("mmap");
+        return 2;
+    }
+    pool->workers = jobs;
+    atomic_store(&pool->remaining, cfg.count);
+    for (long w = 0; w < jobs; w++)
+        deque_push(&pool->worker[w], pack(cfg.count * w / jobs, cfg.count * (w + 1) / jobs));
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (long w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 2;
+        }
+        if (pid == 0) {
+            worker_run(pool, w, &cfg, results);
+            _exit(0);
+        }
+    }
+    int failed = 0, status;
+    while (wait(&status) > 0)
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (failed) {
+        fprintf(stderr, "batch: a worker failed\n");
+        return 2;
+    }
+
+    report(pool, results, cfg.count, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    if (csv)
+        write_csv(csv, results, cfg.count);
+    return 0;
+}
@@ -0,0 +1,565 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+// The game is compiled as part of this file so the players can see its
+// state, as in batch.c
+#define main firmware_main
+#include "../src/main.c"
+#undef main
+#include "../src/simon.c"
+
+// Two boards playing a linked match (see include/link.h) through a relay,
+// all on the host, to test the link without hardware.
+//
+//   duel [-l latency] [-j jitter] [-d ppm] [-o ms] [-f round] [-r min,max]
+//        [-s seed] [-x types] [-v]
+//
+// Each board is a forked process running the firmware, and the parent is
+// the relay between them. Their clocks differ: board B boots -o ms after A
+// (default 1234) and its clock runs -d ppm fast (default 5000, 0.5%;
+// negative for slow). Both UARTs run at 9600 baud, a byte every BYTE_US.
+// The relay forwards each link frame once it has all of it, after -l us
+// plus up to -j us more (defaults 2000 and 1000), and prints each board's
+// other output as console lines; only LINK lines unless -v. -x drops the
+// first frame of each frame type listed, as a bad CRC would (-x GS: the
+// first READY and START).
+// It presses 'V' on A's console to start the match, and 'v' on it once
+// the match is over (not on B's, which may be entering a name by then).
+//
+// Each board has a simulated player pressing its buttons: the right one
+// after a reaction time drawn from -r ms (default 300,600), held for
+// HOLD_US. B presses a wrong one in round -f (default 8), which ends the
+// match. The sync skew reported is how far apart, in true time, the two
+// boards started playing each round.
+//
+// The boards run in lockstep quanta of QUANTUM_US, each in steps of
+// STEP_US (one main loop pass a step). Nothing sent in one quantum can
+// arrive before the next ends, a byte taking BYTE_US to send, so the relay
+// only has to exchange bytes between quanta.
+
+#define BYTE_US 1042          // 10 bits at 9600 baud
+#define STEP_US 10
+#define QUANTUM_US 500
+#define HOLD_US 100000
+#define CONSOLE_AT_US 1000000 // 'V' on A's console
+#define LIMIT_US 600000000UL  // Give up after 10 minutes
+#define MAX_BYTES 4096        // In flight to or from a board in one quantum
+#define MAX_ROUNDS 256
+
+#if BYTE_US <= QUANTUM_US
+#error "A byte must take longer to send than a quantum"
+#endif
+
+void TCB1_INT_vect(void);
+void USART0_RXC_vect(void);
+void NVMCTRL_EE_vect(void);
+void RTC_CNT_vect(void);
+
+typedef struct {
+    uint32_t at;  // True time, us: when it ends
+    uint8_t byte;
+} timed_byte_t;
+
+typedef struct {
+    uint32_t end;       // Run up to this true time, 0 to exit
+    uint16_t rx_count;  // timed_byte_t that follow
+} quantum_t;
+
+typedef struct {
+    uint16_t tx_count;  // timed_byte_t that follow
+    uint8_t started;    // A round started (round, start_us)
+    uint8_t round;
+    uint32_t start_us;
+} reply_t;
+
+typedef struct {
+    uint32_t boot_us;   // True time the board starts
+    int32_t ppm;        // Its clock's rate error
+    unsigned reaction_min, reaction_max;
+    uint8_t fail_round; // Press a wrong button in this round, 0 never
+    uint64_t seed;
+} board_config_t;
+
+static void read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len) {
+        ssize_t got = read(fd, p, len);
+        if (got <= 0) {
+            fprintf(stderr, "duel: board pipe closed\n");
+            exit(2);
+        }
+        p += got;
+        len -= got;
+    }
+}
+
+static void write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len) {
+        ssize_t put = write(fd, p, len);
+        if (put <= 0) {
+            fprintf(stderr, "duel: board pipe closed\n");
+            exit(2);
+        }
+        p += put;
+        len -= put;
+    }
+}
+
+// ----------------------  BOARD  ----------------------
+// Runs in each forked process
+
+static board_config_t board;
+static uint32_t now_us;      // True time
+static uint64_t board_ms;    // Milliseconds the board's timebase has counted
+
+// The UART transmitter: a queue, and the byte in the shift register
+static uint8_t tx_fifo[MAX_BYTES];
+static uint16_t tx_head, tx_count;
+static uint32_t tx_busy_until;
+static timed_byte_t tx_out[MAX_BYTES];
+static uint16_t tx_out_count;
+
+static void tx_start(uint32_t at, uint8_t byte)
+{
+    tx_busy_until = at + BYTE_US;
+    if (tx_out_count < MAX_BYTES)
+        tx_out[tx_out_count++] = (timed_byte_t){ tx_busy_until, byte };
+}
+
+// Start queued bytes whose turn came by the current time, back to back
+static void tx_run(void)
+{
+    while (tx_count && (int32_t)(now_us - tx_busy_until) >= 0) {
+        tx_start(tx_busy_until, tx_fifo[tx_head]);
+        tx_head = (tx_head + 1) % MAX_BYTES;
+        tx_count--;
+    }
+}
+
+void __wrap_uart_send(char c)
+{
+    if (!tx_count && (int32_t)(now_us - tx_busy_until) >= 0) {
+        tx_start(now_us, c);
+        return;
+    }
+    if (tx_count < MAX_BYTES)
+        tx_fifo[(tx_head + tx_count++) % MAX_BYTES] = c;
+}
+
+void __wrap_uart_puts(const char *str)
+{
+    while (*str)
+        __wrap_uart_send(*str++);
+}
+
+void __wrap_uart_send_str(const char *str)
+{
+    __wrap_uart_puts(str);
+}
+
+void __wrap_uart_putnum(uint16_t num)
+{
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%u", num);
+    __wrap_uart_puts(buf);
+}
+
+void __wrap_uart_putnum32(uint32_t num)
+{
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)num);
+    __wrap_uart_puts(buf);
+}
+
+bool __wrap_uart_tx_idle(void)
+{
+    return tx_count == 0;
+}
+
+// The firmware's queue holds UART_TX_SIZE; this one never fills, so a
+// report writer waits for room as it would on the board
+uint8_t __wrap_uart_tx_room(void)
+{
+    return tx_count < UART_TX_SIZE ? UART_TX_SIZE - tx_count : 0;
+}
+
+bool __wrap_uart_tx_done(void)
+{
+    return tx_count == 0 && (int32_t)(now_us - tx_busy_until) >= 0;
+}
+
+// The RTC (timer.c): overflows as the count wraps, every 2s
+static void rtc_set(uint16_t cnt)
+{
+    uint16_t last = RTC.CNT;
+    RTC.CNT = cnt;
+    if (cnt < last) {
+        RTC.INTFLAGS = RTC_OVF_bm;
+        RTC_CNT_vect();
+        RTC.INTFLAGS = 0; // Write-one-to-clear on the board
+    }
+}
+
+// The board's clock at true time t: the timebase (timer.c) and the RTC
+static void set_clock(uint32_t t)
+{
+    uint64_t local = (uint64_t)(t - board.boot_us) * (1000000 + board.ppm) / 1000000;
+    while (board_ms < local / 1000) {
+        board_ms++;
+        TCB1.CNT = TCB1.CNT == TCB1.CCMP ? 0 : TCB1.CNT + 1;
+        if (TCB1.CNT == TCB1.CCMP) {
+            TCB1.INTFLAGS = TCB_CAPT_bm;
+            TCB1_INT_vect();
+            TCB1.INTFLAGS = 0;
+        }
+        while (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm)
+            NVMCTRL_EE_vect();
+    }
+    // Never TOP, which timer.c reads as a wrap in progress
+    uint32_t cnt = (uint32_t)(local % 1000) * 3333 / 1000;
+    TCB0.CNT = cnt < 3332 ? cnt : 3331;
+    rtc_set((uint16_t)(local * 32768 / 1000000));
+}
+
+static uint64_t rng_state;
+
+// splitmix64, as in batch.c
+static uint64_t rng_next(void)
+{
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// The player: waits, presses and holds. The right button is read from the
+// game's own sequence.
+static uint32_t press_at, release_at;
+static uint8_t pressed_pin;
+
+static uint8_t expected_step(void)
+{
+    uint32_t saved = lfsr_state;
+    uint8_t step = 0;
+    lfsr_state = game_seed;
+    for (uint8_t i = 0; i <= user_input_index; i++)
+        step = get_next_step();
+    lfsr_state = saved;
+    return step;
+}
+
+static void player_step(void)
+{
+    if (release_at && (int32_t)(now_us - release_at) >= 0) {
+        PORTA.IN |= pressed_pin;
+        release_at = 0;
+    }
+    if (press_at && (int32_t)(now_us - press_at) >= 0) {
+        PORTA.IN &= ~pressed_pin;
+        press_at = 0;
+        release_at = now_us + HOLD_US;
+    }
+    if (state != AWAITING_INPUT || press_at || release_at)
+        return;
+    uint8_t step = expected_step();
+    if (round_length == board.fail_round && FLAG_TEST(FLAG_LINKED))
+        step = (step + 1) & 3;
+    pressed_pin = PIN4_bm << step;
+    unsigned span = board.reaction_max - board.reaction_min + 1;
+    press_at = now_us + (board.reaction_min + rng_next() % span) * 1000;
+}
+
+static void board_run(int in, int out)
+{
+    // Bytes due after the last step of a quantum wait for the next
+    static timed_byte_t rx[2 * MAX_BYTES];
+    uint16_t rx_count = 0;
+    quantum_t q;
+    bool booted = false;
+    simon_state_t last_state = state;
+    rng_state = board.seed;
+
+    while (1) {
+        read_full(in, &q, sizeof(q));
+        if (!q.end)
+            _exit(0);
+        read_full(in, rx + rx_count, q.rx_count * sizeof(rx[0]));
+        rx_count += q.rx_count;
+        reply_t reply = { 0 };
+        tx_out_count = 0;
+        uint16_t next_rx = 0;
+
+        for (; (int32_t)(now_us - q.end) < 0; now_us += STEP_US) {
+            if ((int32_t)(now_us - board.boot_us) < 0) {
+                next_rx = rx_count; // Lost on a board that is not running
+                continue;
+            }
+            if (!booted) {
+                // Same init as main()
+                PORTA.IN = 0xFF;
+                ADC0.INTFLAGS = ADC_RESRDY_bm;
+                set_clock(now_us);
+                board_init();
+                booted = true;
+            }
+            // Received bytes, with the clock as each one's stop bit ends
+            while (next_rx < rx_count && (int32_t)(rx[next_rx].at - now_us) <= 0) {
+                set_clock(rx[next_rx].at);
+                USART0.RXDATAL = rx[next_rx++].byte;
+                USART0_RXC_vect();
+            }
+            set_clock(now_us);
+            tx_run();
+            sched_pass();
+            HEALTH_LOOP_PASS();
+            if (state == SIMON_PLAY_ON && last_state == SIMON_GENERATE && FLAG_TEST(FLAG_LINKED)) {
+                reply.started = 1;
+                reply.round = round_length;
+                reply.start_us = now_us;
+            }
+            last_state = state;
+            player_step();
+        }
+        memmove(rx, rx + next_rx, (rx_count - next_rx) * sizeof(rx[0]));
+        rx_count -= next_rx;
+        reply.tx_count = tx_out_count;
+        write_full(out, &reply, sizeof(reply));
+        write_full(out, tx_out, tx_out_count * sizeof(tx_out[0]));
+    }
+}
+
+// ----------------------  RELAY  ----------------------
+
+typedef struct {
+    const char *name;
+    int to, from;                     // Pipes
+    pid_t pid;
+    timed_byte_t rx[MAX_BYTES];       // Bytes on their way to the board
+    uint16_t rx_count;
+    uint32_t line_free;               // The relay's line to the board
+    uint8_t frame[LINK_MAX_PAYLOAD + 3];
+    uint8_t frame_len, frame_need;    // Frame being received, 0 between frames
+    char line[128];
+    uint8_t line_len;
+    bool done;                        // "LINK MATCH" or "LINK LOST" printed
+    uint32_t start_us[MAX_ROUNDS];
+} relay_board_t;
+
+static uint32_t latency_us = 2000, jitter_us = 1000;
+static bool verbose = false;
+static char drop_types[16];  // Frame types whose next frame is dropped (-x)
+
+// Queue a byte on the relay's line to a board, starting no sooner than at
+static void relay_send(relay_board_t *b, uint32_t at, uint8_t byte)
+{
+    uint32_t start = (int32_t)(at - b->line_free) > 0 ? at : b->line_free;
+    b->line_free = start + BYTE_US;
+    if (b->rx_count < MAX_BYTES)
+        b->rx[b->rx_count++] = (timed_byte_t){ b->line_free, byte };
+}
+
+static void console_char(relay_board_t *b, char c)
+{
+    if (c != '\n') {
+        if (b->line_len < sizeof(b->line) - 1)
+            b->line[b->line_len++] = c;
+        return;
+    }
+    b->line[b->line_len] = 0;
+    b->line_len = 0;
+    if (!strncmp(b->line, "LINK MATCH", 10) || !strncmp(b->line, "LINK LOST", 9))
+        b->done = true;
+    if (verbose || !strncmp(b->line, "LINK", 4))
+        printf("%s| %s\n", b->name, b->line);
+}
+
+// A byte from one board: a frame is forwarded to the other once complete,
+// anything else goes to the board's console
+static void relay_byte(relay_board_t *from, relay_board_t *to, timed_byte_t tb)
+{
+    if (!from->frame_need) {
+        if (tb.byte == LINK_MARK) {
+            from->frame[0] = tb.byte;
+            from->frame_len = 1;
+            from->frame_need = 2;
+        } else {
+            console_char(from, tb.byte);
+        }
+        return;
+    }
+    from->frame[from->frame_len++] = tb.byte;
+    if (from->frame_len == 2) {
+        uint8_t size = link_payload_size(tb.byte);
+        if (size == 0xFF) {
+            // Not a frame type: the mark was console output, and this byte
+            // is either that too or the mark of a real frame
+            from->frame_need = 0;
+            console_char(from, LINK_MARK);
+            relay_byte(from, to, tb);
+            return;
+        }
+        from->frame_need = 2 + size + 1;
+    }
+    if (from->frame_len < from->frame_need)
+        return;
+    from->frame_need = 0;
+    char *drop = strchr(drop_types, from->frame[1]);
+    if (drop) {
+        memmove(drop, drop + 1, strlen(drop));
+        printf("%s| (frame %c dropped)\n", from->name, from->frame[1]);
+        return;
+    }
+    uint32_t at = tb.at + latency_us + (jitter_us ? rng_next() % (jitter_us + 1) : 0);
+    for (uint8_t i = 0; i < from->frame_len; i++)
+        relay_send(to, at, from->frame[i]);
+}
+
+static pid_t spawn(relay_board_t *b, const board_config_t *cfg)
+{
+    int down[2], up[2];
+    if (pipe(down) || pipe(up)) {
+        perror("pipe");
+        exit(2);
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(2);
+    }
+    if (pid == 0) {
+        close(down[1]);
+        close(up[0]);
+        board = *cfg;
+        board_run(down[0], up[1]);
+    }
+    close(down[0]);
+    close(up[1]);
+    b->to = down[1];
+    b->from = up[0];
+    return pid;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-l latency] [-j jitter] [-d ppm] [-o ms] [-f round] "
+                    "[-r min,max] [-s seed] [-x types] [-v]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    board_config_t cfg[2] = {
+        { .boot_us = 0, .ppm = 0, .reaction_min = 300, .reaction_max = 600, .fail_round = 0, .seed = 1 },
+        { .boot_us = 1234000, .ppm = 5000, .reaction_min = 300, .reaction_max = 600, .fail_round = 8, .seed = 2 },
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "l:j:d:o:f:r:s:x:v")) != -1) {
+        switch (opt) {
+            case 'l': latency_us = strtoul(optarg, NULL, 0); break;
+            case 'j': jitter_us = strtoul(optarg, NULL, 0); break;
+            case 'd': cfg[1].ppm = strtol(optarg, NULL, 0); break;
+            case 'o': cfg[1].boot_us = strtoul(optarg, NULL, 0) * 1000; break;
+            case 'f': cfg[1].fail_round = strtoul(optarg, NULL, 0); break;
+            case 'r':
+                if (sscanf(optarg, "%u,%u", &cfg[0].reaction_min, &cfg[0].reaction_max) != 2)
+                    usage(argv[0]);
+                cfg[1].reaction_min = cfg[0].reaction_min;
+                cfg[1].reaction_max = cfg[0].reaction_max;
+                break;
+            case 's':
+                cfg[0].seed = strtoull(optarg, NULL, 0) * 2 + 1;
+                cfg[1].seed = cfg[0].seed + 1;
+                break;
+            case 'x':
+                strncpy(drop_types, optarg, sizeof(drop_types) - 1);
+                break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (cfg[0].reaction_max < cfg[0].reaction_min || cfg[1].ppm <= -1000000)
+        usage(argv[0]);
+    rng_state = cfg[0].seed ^ 0xD0E1;
+
+    static relay_board_t boards[2] = { { .name = "A" }, { .name = "B" } };
+    for (int i = 0; i < 2; i++)
+        boards[i].pid = spawn(&boards[i], &cfg[i]);
+
+    uint32_t over_us = 0;  // Both matches over, then the 'v' report
+    bool started = false;
+    for (uint32_t end = QUANTUM_US; end < LIMIT_US; end += QUANTUM_US) {
+        if (!started && end >= CONSOLE_AT_US) {
+            relay_send(&boards[0], end, 'V');
+            started = true;
+        }
+        if (!over_us && boards[0].done && boards[1].done) {
+            over_us = end;
+            relay_send(&boards[0], end, 'v');
+        }
+        if (over_us && end - over_us > 200000)
+            break;
+
+        // Bytes due by the end of this quantum go down with it
+        for (int i = 0; i < 2; i++) {
+            relay_board_t *b = &boards[i];
+            uint16_t due = 0;
+            while (due < b->rx_count && (int32_t)(b->rx[due].at - end) < 0)
+                due++;
+            quantum_t q = { end, due };
+            write_full(b->to, &q, sizeof(q));
+            write_full(b->to, b->rx, due * sizeof(b->rx[0]));
+            memmove(b->rx, b->rx + due, (b->rx_count - due) * sizeof(b->rx[0]));
+            b->rx_count -= due;
+        }
+        for (int i = 0; i < 2; i++) {
+            static timed_byte_t tx[MAX_BYTES];
+            reply_t reply;
+            read_full(boards[i].from, &reply, sizeof(reply));
+            read_full(boards[i].from, tx, reply.tx_count * sizeof(tx[0]));
+            for (uint16_t k = 0; k < reply.tx_count; k++)
+                relay_byte(&boards[i], &boards[1 - i], tx[k]);
+            if (reply.started && reply.round < MAX_ROUNDS)
+                boards[i].start_us[reply.round] = reply.start_us;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        quantum_t q = { 0, 0 };
+        write_full(boards[i].to, &q, sizeof(q));
+        waitpid(boards[i].pid, NULL, 0);
+    }
+    if (!over_us) {
+        fprintf(stderr, "duel: the match did not finish\n");
+        return 1;
+    }
+
+    printf("\nround  A start us  B start us  skew us\n");
+    unsigned rounds = 0;
+    uint32_t max_skew = 0;
+    uint64_t total_skew = 0;
+    for (unsigned r = 1; r < MAX_ROUNDS; r++) {
+        uint32_t a = boards[0].start_us[r], b = boards[1].start_us[r];
+        if (!a || !b)
+            continue;
+        uint32_t skew = a > b ? a - b : b - a;
+        printf("%5u  %10lu  %10lu  %7lu\n", r, (unsigned long)a, (unsigned long)b, (unsigned long)skew);
+        rounds++;
+        total_skew += skew;
+        if (skew > max_skew) max_skew = skew;
+    }
+    if (!rounds) {
+        fprintf(stderr, "duel: no round started on both boards\n");
+        return 1;
+    }
+    printf("sync skew over %u rounds: max %lu us, mean %lu us\n", rounds,
+           (unsigned long)max_skew, (unsigned long)(total_skew / rounds));
+    return 0;
+}
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The firmware's main loop pieces (report_task) are static, so main.c is
+// compiled as part of this file with its main() renamed
+#define main firmware_main
+#include "../src/main.c"
+#undef main
+
+// Replays a session recorded with the 'R' command through the firmware
+// compiled for the host, and reports where its display, tone and UART
+// output diverge from what the board did.
+//
+//   replay session.log
+//
+// The log is everything captured from the board's UART; recording lines
+// (RECORD_MARK ... '\n', see record.h) are split from the game output. The
+// first recording in the log is replayed. Time advances in whole
+// milliseconds: inputs due are applied, the tick ISR runs (TCB1 every 5th
+// ms, in the phase the recorded pin samples show) and the main loop makes
+// REPLAY_PASSES passes. Outputs are compared in order; their times may
+// differ by a millisecond or so.
+
+#ifndef REPLAY_PASSES
+#define REPLAY_PASSES 2
+#endif
+
+void TCB1_INT_vect(void);
+void USART0_RXC_vect(void);
+void NVMCTRL_EE_vect(void);
+void RTC_CNT_vect(void);
+#if BUTTON_DEBOUNCE_MODE == BUTTON_DEBOUNCE_EDGE
+void PORTA_PORT_vect(void);
+#endif
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t type;
+    uint16_t value;
+} event_t;
+
+typedef struct {
+    event_t *items;
+    size_t count, size;
+} events_t;
+
+typedef struct {
+    char *bytes;
+    size_t count, size;
+} text_t;
+
+static void grow(void **items, size_t *size, size_t count, size_t item)
+{
+    if (count < *size) return;
+    *size = *size ? *size * 2 : 256;
+    *items = realloc(*items, *size * item);
+    if (!*items) {
+        fprintf(stderr, "replay: out of memory\n");
+        exit(2);
+    }
+}
+
+static void events_add(events_t *e, uint32_t time_ms, uint8_t type, uint16_t value)
+{
+    grow((void **)&e->items, &e->size, e->count, sizeof(event_t));
+    e->items[e->count++] = (event_t){ time_ms, type, value };
+}
+
+static void text_add(text_t *t, char c)
+{
+    grow((void **)&t->bytes, &t->size, t->count, 1);
+    t->bytes[t->count++] = c;
+}
+
+// ----------------------  RECORDING  ----------------------
+
+typedef struct {
+    events_t inputs;   // P and U, in time order
+    uint16_t *adc;     // A values, in read order
+    size_t adc_count;
+    events_t outputs;  // D and T
+    text_t text;       // Game output while recording
+    uint8_t eeprom[EEPROM_SIZE];
+    uint32_t seed;
+    uint32_t end_ms;
+    unsigned lost;
+    int stopped;
+} recording_t;
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static int parse(const char *log, size_t len, recording_t *rec)
+{
+    int started = 0;
+    uint32_t t = 0;
+    size_t adc_size = 0;
+
+    memset(rec, 0, sizeof(*rec));
+    memset(rec->eeprom, 0xFF, sizeof(rec->eeprom));
+    for (size_t i = 0; i < len && !rec->stopped; i++) {
+        if (log[i] != RECORD_MARK) {
+            if (started)
+                text_add(&rec->text, log[i]);
+            continue;
+        }
+
+        const char *line = &log[i + 1];
+        const char *end = memchr(line, '\n', len - i - 1);
+        if (!end) break;
+        i = end - log;
+        char type = line[0];
+        if (type == RECORD_START) {
+            if (started) break; // Next recording; this one was not stopped
+            started = 1;
+            continue;
+        }
+        if (!started) continue;
+
+        if (type == 'E') {
+            for (int k = 0; k < EEPROM_SIZE && line + 2 + 2 * k < end; k++)
+                rec->eeprom[k] = hex_digit(line[1 + 2 * k]) << 4 | hex_digit(line[2 + 2 * k]);
+            continue;
+        }
+        if (type == 'S') {
+            rec->seed = strtoul(line + 1, NULL, 10);
+            continue;
+        }
+
+        char *colon;
+        t += strtoul(line + 1, &colon, 10);
+        uint16_t value = *colon == ':' ? strtoul(colon + 1, NULL, 10) : 0;
+        switch (type) {
+            case RECORD_PINS:
+            case RECORD_UART:
+                events_add(&rec->inputs, t, type, value);
+                break;
+            case RECORD_ADC:
+                grow((void **)&rec->adc, &adc_size, rec->adc_count, sizeof(uint16_t));
+                rec->adc[rec->adc_count++] = value;
+                break;
+            case RECORD_DISPLAY:
+            case RECORD_TONE:
+                events_add(&rec->outputs, t, type, value);
+                break;
+            case RECORD_LOST:
+                rec->lost += value;
+                break;
+            case RECORD_STOP:
+                rec->stopped = 1;
+                break;
+        }
+        rec->end_ms = t;
+    }
+    return started;
+}
+
+// ----------------------  HOST OUTPUT  ----------------------
+
+// The link wraps these (see Makefile), so the game's output lands here
+
+static uint32_t now_ms;
+static events_t host_outputs;
+static text_t host_text;
+static const recording_t *replaying;
+static size_t adc_next;
+
+void __wrap_record_log(uint8_t type, uint16_t value)
+{
+    if (type == RECORD_DISPLAY || type == RECORD_TONE)
+        events_add(&host_outputs, now_ms, type, value);
+}
+
+void __wrap_record_toggle(void)
+{
+    // The 'R' that ended the recording is replayed too
+}
+
+void __wrap_uart_send(char c)
+{
+    text_add(&host_text, c);
+}
+
+void __wrap_uart_puts(const char *str)
+{
+    while (*str)
+        text_add(&host_text, *str++);
+}
+
+void __wrap_uart_send_str(const char *str)
+{
+    __wrap_uart_puts(str);
+}
+
+void __wrap_uart_putnum(uint16_t num)
+{
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%u", num);
+    __wrap_uart_puts(buf);
+}
+
+void __wrap_uart_putnum32(uint32_t num)
+{
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)num);
+    __wrap_uart_puts(buf);
+}
+
+// ADC readings are handed out in the order the board took them
+uint16_t __real_get_potentiometer_delay(void);
+
+uint16_t __wrap_get_potentiometer_delay(void)
+{
+    if (adc_next < replaying->adc_count)
+        ADC0.RESULT0 = replaying->adc[adc_next];
+    adc_next++;
+    return __real_get_potentiometer_delay();
+}
+
+// ----------------------  REPLAY  ----------------------
+
+// ms within each 5 ms period that TCB1 fires on
+// The RTC (timer.c): overflows as the count wraps, every 2s
+static void rtc_set(uint16_t cnt)
+{
+    uint16_t last = RTC.CNT;
+    RTC.CNT = cnt;
+    if (cnt < last) {
+        RTC.INTFLAGS = RTC_OVF_bm;
+        RTC_CNT_vect();
+        RTC.INTFLAGS = 0; // Write-one-to-clear on the board
+    }
+}
+
+static uint8_t tcb1_phase = 0;
+
+static void apply(const event_t *e)
+{
+    if (e->type == RECORD_UART) {
+        USART0.RXDATAL = e->value;
+        USART0_RXC_vect();
+        return;
+    }
+#if BUTTON_DEBOUNCE_MODE != BUTTON_DEBOUNCE_EDGE
+    // Pins are sampled in the TCB1 tick, so each sample shows its phase.
+    // Keep following it: on older firmware the period was not a whole
+    // number of ms.
+    tcb1_phase = e->time_ms % 5;
+#endif
+    uint8_t changed = (PORTA.IN ^ e->value) & BUTTON_PINS_gm;
+    PORTA.IN = (PORTA.IN & ~BUTTON_PINS_gm) | e->value;
+#if BUTTON_DEBOUNCE_MODE == BUTTON_DEBOUNCE_EDGE
+    if (changed) {
+        PORTA.INTFLAGS = changed;
+        PORTA_PORT_vect();
+    }
+#else
+    (void)changed;
+#endif
+}
+
+static void replay(const recording_t *rec)
+{
+    replaying = rec;
+    memcpy(host_eeprom, rec->eeprom, EEPROM_SIZE);
+    PORTA.IN = 0xFF;
+    ADC0.INTFLAGS = ADC_RESRDY_bm; // Conversions are always complete
+
+    // Same init as main()
+    board_init();
+
+    // Same restart as record_start(), in the main loop pass it runs in
+    host_outputs.count = 0;
+    host_text.count = 0;
+    update_button_states();
+    buzzer_task();
+    simon_init();
+    bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_RESET);
+    bus_post(BUS_GAME, MSG_SEED, rec->seed);
+    simon_task();
+
+#if BUTTON_DEBOUNCE_MODE != BUTTON_DEBOUNCE_EDGE
+    // Tick in the phase of the first pin sample from the start, the
+    // timebase follows the tick
+    for (size_t i = 0; i < rec->inputs.count; i++) {
+        if (rec->inputs.items[i].type == RECORD_PINS) {
+            tcb1_phase = rec->inputs.items[i].time_ms % 5;
+            break;
+        }
+    }
+#endif
+
+    size_t next = 0;
+    for (now_ms = 0; now_ms <= rec->end_ms; now_ms++) {
+        while (next < rec->inputs.count && rec->inputs.items[next].time_ms <= now_ms)
+            apply(&rec->inputs.items[next++]);
+        // TCB1 counts the millisecond and reaches CCMP on the tick's phase
+        TCB1.CNT = (now_ms + TCB1.CCMP - tcb1_phase) % (TCB1.CCMP + 1);
+        if (TCB1.CNT == TCB1.CCMP) {
+            TCB1.INTFLAGS = TCB_CAPT_bm;
+            TCB1_INT_vect();
+            TCB1.INTFLAGS = 0; // Write-one-to-clear on the board
+        }
+        while (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm)
+            NVMCTRL_EE_vect();
+        // The scheduler's clock (scheduler.c), 32768 counts a second
+        rtc_set((uint16_t)(now_ms * 32768ULL / 1000));
+        for (int pass = 0; pass < REPLAY_PASSES; pass++) {
+            sched_pass();
+            HEALTH_LOOP_PASS();
+        }
+    }
+}
+
+// ----------------------  COMPARISON  ----------------------
+
+static const event_t *nth(const events_t *e, uint8_t type, size_t n)
+{
+    for (size_t i = 0; i < e->count; i++)
+        if (e->items[i].type == type && n-- == 0)
+            return &e->items[i];
+    return NULL;
+}
+
+static int compare_events(const char *what, uint8_t type, const events_t *board, const events_t *host)
+{
+    uint32_t skew = 0;
+    for (size_t n = 0;; n++) {
+        const event_t *b = nth(board, type, n);
+        const event_t *h = nth(host, type, n);
+        if (!b && !h) {
+            printf("%-8s %6zu events match, max skew %lu ms\n", what, n, (unsigned long)skew);
+            return 0;
+        }
+        if (!b || !h || b->value != h->value) {
+            printf("%-8s diverged at event %zu:", what, n);
+            if (b) printf(" board %lu ms 0x%04x", (unsigned long)b->time_ms, b->value);
+            else printf(" board none");
+            if (h) printf(", host %lu ms 0x%04x\n", (unsigned long)h->time_ms, h->value);
+            else printf(", host none\n");
+            return 1;
+        }
+        uint32_t d = b->time_ms > h->time_ms ? b->time_ms - h->time_ms : h->time_ms - b->time_ms;
+        if (d > skew) skew = d;
+    }
+}
+
+// Timing figures depend on where presses fell within a millisecond and on
+// the board's clock, which the recording does not capture. Each run of
+// digits in the timing reports, and in reaction times ("<n>ms"), becomes
+// a single '#' before the output is compared.
+static const char *const timed_reports[] = { "REACTION ", "LATENCY ", "DISPATCH ", "STACK ", "TURBO ", "BOOT ", "TASK ", "HEALTH " };
+
+static void mask_timings(const text_t *in, text_t *out)
+{
+    int in_trace = 0;
+    for (size_t i = 0; i < in->count;) {
+        size_t end = i;
+        while (end < in->count && in->bytes[end] != '\n') end++;
+        const char *line = in->bytes + i;
+        size_t len = end - i;
+
+        int timed = in_trace;
+        for (size_t r = 0; r < sizeof(timed_reports) / sizeof(timed_reports[0]); r++)
+            if (len >= strlen(timed_reports[r]) && !memcmp(line, timed_reports[r], strlen(timed_reports[r])))
+                timed = 1;
+        if (len >= 6 && !memcmp(line, "TRACE ", 6))
+            in_trace = 1;
+        else if (len == 3 && !memcmp(line, "END", 3))
+            in_trace = 0;
+
+        for (size_t k = 0; k < len;) {
+            if (line[k] < '0' || line[k] > '9') {
+                text_add(out, line[k++]);
+                continue;
+            }
+            size_t digits = k;
+            while (digits < len && line[digits] >= '0' && line[digits] <= '9') digits++;
+            if (timed || (digits + 1 < len && line[digits] == 'm' && line[digits + 1] == 's')) {
+                text_add(out, '#');
+            } else {
+                while (k < digits) text_add(out, line[k++]);
+            }
+            k = digits;
+        }
+        if (end < in->count)
+            text_add(out, '\n');
+        i = end + 1;
+    }
+}
+
+static void print_line(const char *label, const text_t *t, size_t at)
+{
+    size_t start = at, end = at;
+    while (start > 0 && t->bytes[start - 1] != '\n') start--;
+    while (end < t->count && t->bytes[end] != '\n') end++;
+    printf("  %s: \"%.*s\"\n", label, (int)(end - start), t->bytes + start);
+}
+
+static int compare_text(const text_t *board_raw, const text_t *host_raw)
+{
+    static text_t masked[2];
+    const text_t *board = &masked[0], *host = &masked[1];
+    mask_timings(board_raw, &masked[0]);
+    mask_timings(host_raw, &masked[1]);
+
+    size_t n = 0;
+    while (n < board->count && n < host->count && board->bytes[n] == host->bytes[n]) n++;
+    if (n == board->count && n == host->count) {
+        printf("%-8s %6zu bytes match, timing figures masked\n", "uart", n);
+        return 0;
+    }
+    printf("%-8s diverged at byte %zu\n", "uart", n);
+    print_line("board", board, n);
+    print_line("host ", host, n);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s session.log\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+    text_t log = { 0 };
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        text_add(&log, c);
+    fclose(f);
+
+    static recording_t rec;
+    if (!parse(log.bytes, log.count, &rec)) {
+        fprintf(stderr, "%s: no recording found\n", argv[1]);
+        return 2;
+    }
+    if (!rec.stopped)
+        printf("warning: recording was not stopped, replaying up to its last event\n");
+    if (rec.lost)
+        printf("warning: %u events were lost on the board, divergence is likely\n", rec.lost);
+
+    clock_t start = clock();
+    replay(&rec);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("replayed %.1f s of play in %.3f s", rec.end_ms / 1000.0, seconds);
+    if (seconds > 0)
+        printf(" (%.0fx real time)", rec.end_ms / 1000.0 / seconds);
+    printf("\n");
+
+    int diverged = compare_events("display", RECORD_DISPLAY, &rec.outputs, &host_outputs);
+    diverged |= compare_events("tone", RECORD_TONE, &rec.outputs, &host_outputs);
+    diverged |= compare_text(&rec.text, &host_text);
+    if (adc_next != rec.adc_count) {
+        printf("adc      %zu readings recorded, %zu taken\n", rec.adc_count, adc_next);
+        diverged = 1;
+    }
+    return diverged;
+}
@@ -0,0 +1,501 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+// The firmware's LFSR (get_next_step() and LFSR_MASK) is the reference
+#include "../src/simon.c"
+
+// Ranks seeds for the UART '9' command by the sequence they start: the
+// first N steps of a game played from the seed (the steps of round N).
+//
+//   seedscan [-n steps] [-k top] [-m run] [-r first:count] [-j threads] [-b]
+//
+// For each seed it measures, over those steps:
+//   run       longest run of one button, in repeats (0: no step repeats
+//             the one before it)
+//   pairs     distinct pairs of consecutive steps; a sequence that cycles
+//             through a short pattern has few. Only 8 of the 16 can occur:
+//             a step's low bit follows from the one before (LFSR_MASK has
+//             bits 0 and 1 set)
+//   balance   most common button's count minus the least common's
+//   repeats   steps that repeat the one before
+// and lists the -k best seeds with a run of at most -m (default 1),
+// ordered by pairs (most first), then balance, run, repeats and seed,
+// ready to be sent as "9<seed>". Run alone is a poor guide: the seeds with
+// no repeats at all only reach 6 pairs in 32 steps. The default range
+// is the full 32-bit seed space; the distribution of longest runs over
+// the range is printed as well.
+//
+// The LFSR is evaluated bit-sliced: vec_t holds bit k of the state of
+// SEEDSCAN_VECTOR_BYTES * 8 consecutive seeds, one seed per bit, so a step
+// of all of them is a handful of XORs on 32 vectors (the shift is only a
+// change of which vector holds which bit), and the metrics are kept as
+// bit-sliced counters the same way. The compiler maps vec_t onto whatever
+// SIMD registers the target has (-march in the Makefile). -b benchmarks it
+// against the firmware's scalar get_next_step() and cross-checks the two.
+
+#ifndef SEEDSCAN_VECTOR_BYTES
+#define SEEDSCAN_VECTOR_BYTES 32
+#endif
+
+typedef uint64_t vec_t __attribute__((vector_size(SEEDSCAN_VECTOR_BYTES)));
+
+#define WORDS (SEEDSCAN_VECTOR_BYTES / 8)
+#define LANES (WORDS * 64)
+#define PLANES 8             // Bits of each counter, so at most 255 steps
+#define MAX_STEPS 255
+#define RUN_BUCKETS 16       // Longest runs counted separately, the rest are lumped
+#define CHUNK (1UL << 20)    // Seeds a thread takes at a time
+
+_Static_assert((LANES & (LANES - 1)) == 0 && LANES >= 64, "vector must be a power of two words");
+
+typedef struct {
+    uint32_t seed;
+    uint8_t run, pairs, balance, repeats;
+    uint8_t count[4];
+} seed_metrics_t;
+
+// ----------------------  SCALAR REFERENCE  ----------------------
+
+static void metrics_scalar(uint32_t seed, unsigned steps, seed_metrics_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->seed = seed;
+    update_lfsr_state(seed);
+    uint8_t prev = 0, run = 0;
+    uint16_t pairs = 0;
+    for (unsigned t = 0; t < steps; t++) {
+        uint8_t step = get_next_step();
+        m->count[step]++;
+        if (t) pairs |= 1 << (prev << 2 | step);
+        if (t && step == prev) {
+            m->repeats++;
+            if (++run > m->run) m->run = run;
+        } else {
+            run = 0;
+        }
+        prev = step;
+    }
+    uint8_t low = 255, high = 0;
+    for (int i = 0; i < 4; i++) {
+        if (m->count[i] < low) low = m->count[i];
+        if (m->count[i] > high) high = m->count[i];
+    }
+    m->balance = high - low;
+    m->pairs = __builtin_popcount(pairs);
+}
+
+// Orders seeds best first
+static int metrics_better(const seed_metrics_t *a, const seed_metrics_t *b)
+{
+    if (a->pairs != b->pairs) return a->pairs > b->pairs;
+    if (a->balance != b->balance) return a->balance < b->balance;
+    if (a->run != b->run) return a->run < b->run;
+    if (a->repeats != b->repeats) return a->repeats < b->repeats;
+    return a->seed < b->seed;
+}
+
+// ----------------------  BIT-SLICED COUNTERS  ----------------------
+
+static inline void counter_add(vec_t c[PLANES], vec_t mask)
+{
+    for (int i = 0; i < PLANES; i++) {
+        vec_t carry = c[i] & mask;
+        c[i] ^= mask;
+        mask = carry;
+    }
+}
+
+// Lanes where a > b
+static inline vec_t counter_greater(const vec_t a[PLANES], const vec_t b[PLANES])
+{
+    vec_t gt = { 0 }, eq = ~gt;
+    for (int i = PLANES - 1; i >= 0; i--) {
+        gt |= eq & a[i] & ~b[i];
+        eq &= ~(a[i] ^ b[i]);
+    }
+    return gt;
+}
+
+static inline void counter_set(vec_t c[PLANES], unsigned value)
+{
+    for (int i = 0; i < PLANES; i++) {
+        vec_t v = { 0 };
+        c[i] = (value >> i & 1) ? ~v : v;
+    }
+}
+
+// Lanes where c == value
+static inline vec_t counter_equal(const vec_t c[PLANES], unsigned value)
+{
+    vec_t eq = { 0 };
+    eq = ~eq;
+    for (int i = 0; i < PLANES; i++)
+        eq &= (value >> i & 1) ? c[i] : ~c[i];
+    return eq;
+}
+
+static inline unsigned lane_bit(vec_t v, unsigned lane)
+{
+    return v[lane / 64] >> (lane % 64) & 1;
+}
+
+static unsigned counter_lane(const vec_t c[PLANES], unsigned lane)
+{
+    unsigned value = 0;
+    for (int i = 0; i < PLANES; i++)
+        value |= lane_bit(c[i], lane) << i;
+    return value;
+}
+
+static unsigned popcount(vec_t v)
+{
+    unsigned n = 0;
+    for (int w = 0; w < WORDS; w++)
+        n += __builtin_popcountll(v[w]);
+    return n;
+}
+
+// ----------------------  BIT-SLICED SCAN  ----------------------
+
+typedef struct {
+    vec_t run[PLANES], max_run[PLANES], repeats[PLANES];
+    vec_t count[3][PLANES];  // The fourth is steps minus the others
+    vec_t pairs[16];         // Lanes that have had step i followed by step j
+} block_t;
+
+// Bit k of seeds base .. base + LANES - 1 (base a multiple of LANES)
+static vec_t seed_plane(uint32_t base, unsigned k)
+{
+    static const uint64_t pattern[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL,
+    };
+    vec_t v;
+    for (int w = 0; w < WORDS; w++) {
+        if (k < 6) v[w] = pattern[k];
+        else if ((1UL << k) < LANES) v[w] = (w >> (k - 6) & 1) ? ~0ULL : 0;
+        else v[w] = (base >> k & 1) ? ~0ULL : 0;
+    }
+    return v;
+}
+
+// One LFSR step of every lane. Logical state bit k lives in
+// state[(k + t) % 32] after t steps, so the right shift moves nothing.
+// Bit 31 of the new state is the old bit 0 (LFSR_MASK has bit 31 set),
+// which is already in place.
+_Static_assert(LFSR_MASK >> 31, "seedscan relies on bit 31 of LFSR_MASK");
+
+#define LFSR_STEP(state, t) do {                                    \
+        vec_t out = (state)[(t) & 31];                              \
+        _Pragma("GCC unroll 31")                                    \
+        for (unsigned k = 0; k < 31; k++)                           \
+            if (LFSR_MASK >> k & 1)                                 \
+                (state)[(k + (t) + 1) & 31] ^= out;                 \
+    } while (0)
+
+static void scan_block(uint32_t base, unsigned steps, block_t *b)
+{
+    vec_t state[32];
+    for (unsigned k = 0; k < 32; k++)
+        state[k] = seed_plane(base, k);
+    memset(b, 0, sizeof(*b));
+    vec_t prev[4] = { { 0 } };
+
+    for (unsigned t0 = 0; t0 < steps; t0 += 32) {
+        _Pragma("GCC unroll 32")
+        for (unsigned t = 0; t < 32; t++) {
+            if (t0 + t >= steps) break;
+            LFSR_STEP(state, t);
+            vec_t s0 = state[(t + 1) & 31], s1 = state[(t + 2) & 31];
+            vec_t is[4] = { ~s1 & ~s0, ~s1 & s0, s1 & ~s0, s1 & s0 };
+            if (t0 + t) {
+                for (int i = 0; i < 4; i++)
+                    for (int j = 0; j < 4; j++)
+                        b->pairs[i << 2 | j] |= prev[i] & is[j];
+                vec_t same = { 0 };
+                for (int i = 0; i < 4; i++)
+                    same |= prev[i] & is[i];
+                counter_add(b->repeats, same);
+                counter_add(b->run, same);
+                for (int i = 0; i < PLANES; i++)
+                    b->run[i] &= same;
+                vec_t longer = counter_greater(b->run, b->max_run);
+                for (int i = 0; i < PLANES; i++)
+                    b->max_run[i] = (b->run[i] & longer) | (b->max_run[i] & ~longer);
+            }
+            for (int i = 0; i < 3; i++)
+                counter_add(b->count[i], is[i]);
+            for (int i = 0; i < 4; i++)
+                prev[i] = is[i];
+        }
+    }
+}
+
+static void block_lane(const block_t *b, uint32_t base, unsigned lane, unsigned steps,
+                       seed_metrics_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->seed = base + lane;
+    m->run = counter_lane(b->max_run, lane);
+    m->repeats = counter_lane(b->repeats, lane);
+    unsigned rest = steps, low = 255, high = 0;
+    for (int i = 0; i < 4; i++) {
+        m->count[i] = i < 3 ? counter_lane(b->count[i], lane) : rest;
+        rest -= m->count[i];
+        if (m->count[i] < low) low = m->count[i];
+        if (m->count[i] > high) high = m->count[i];
+    }
+    m->balance = high - low;
+    for (int i = 0; i < 16; i++)
+        m->pairs += lane_bit(b->pairs[i], lane);
+}
+
+// ----------------------  RANKING  ----------------------
+
+typedef struct {
+    seed_metrics_t *best;   // Sorted best first
+    unsigned count, size;
+    uint64_t runs[RUN_BUCKETS + 1];
+    uint64_t seeds;
+} ranking_t;
+
+static void ranking_add(ranking_t *r, const seed_metrics_t *m)
+{
+    if (r->count == r->size && !metrics_better(m, &r->best[r->count - 1]))
+        return;
+    unsigned i = r->count < r->size ? r->count++ : r->count - 1;
+    while (i > 0 && metrics_better(m, &r->best[i - 1])) {
+        r->best[i] = r->best[i - 1];
+        i--;
+    }
+    r->best[i] = *m;
+}
+
+// Scan seeds first .. first + count - 1, any alignment
+static void scan_range(uint64_t first, uint64_t count, unsigned steps, unsigned max_run,
+                       ranking_t *r)
+{
+    block_t block;
+    vec_t limit[PLANES], pairs[PLANES];
+    uint64_t end = first + count;
+    for (uint64_t base = first & ~(uint64_t)(LANES - 1); base < end; base += LANES) {
+        scan_block(base, steps, &block);
+
+        // Only lanes in range that could make the list
+        vec_t candidates;
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t lo = base + w * 64;
+            uint64_t word = ~0ULL;
+            if (lo < first) word = first - lo >= 64 ? 0 : word << (first - lo);
+            if (lo + 64 > end) word &= end <= lo ? 0 : ~0ULL >> (lo + 64 - end);
+            candidates[w] = word;
+        }
+        for (unsigned run = 0; run < RUN_BUCKETS; run++)
+            r->runs[run] += popcount(counter_equal(block.max_run, run) & candidates);
+        r->seeds += popcount(candidates);
+        counter_set(limit, max_run);
+        candidates &= ~counter_greater(block.max_run, limit);
+        if (r->count == r->size) {
+            memset(pairs, 0, sizeof(pairs));
+            for (int i = 0; i < 16; i++)
+                counter_add(pairs, block.pairs[i]);
+            counter_set(limit, r->best[r->count - 1].pairs);
+            candidates &= ~counter_greater(limit, pairs);
+        }
+
+        for (int w = 0; w < WORDS; w++) {
+            for (uint64_t bits = candidates[w]; bits; bits &= bits - 1) {
+                seed_metrics_t m;
+                block_lane(&block, base, w * 64 + __builtin_ctzll(bits), steps, &m);
+                ranking_add(r, &m);
+            }
+        }
+    }
+}
+
+// ----------------------  THREADS  ----------------------
+
+typedef struct {
+    uint64_t first, count;
+    unsigned steps, max_run;
+    _Atomic uint64_t next;  // Offset of the next chunk to take
+} scan_job_t;
+
+typedef struct {
+    scan_job_t *job;
+    ranking_t ranking;
+    pthread_t thread;
+} scan_thread_t;
+
+static void *scan_thread(void *arg)
+{
+    scan_thread_t *self = arg;
+    scan_job_t *job = self->job;
+    for (;;) {
+        uint64_t offset = atomic_fetch_add(&job->next, CHUNK);
+        if (offset >= job->count) break;
+        uint64_t n = job->count - offset < CHUNK ? job->count - offset : CHUNK;
+        scan_range(job->first + offset, n, job->steps, job->max_run, &self->ranking);
+    }
+    return NULL;
+}
+
+static void ranking_init(ranking_t *r, unsigned size)
+{
+    memset(r, 0, sizeof(*r));
+    r->size = size;
+    r->best = calloc(size, sizeof(seed_metrics_t));
+    if (!r->best) {
+        perror("seedscan");
+        exit(2);
+    }
+}
+
+static double seconds_since(const struct timespec *t0)
+{
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static void scan(uint64_t first, uint64_t count, unsigned steps, unsigned max_run,
+                 unsigned top, unsigned threads, ranking_t *total)
+{
+    scan_job_t job = { .first = first, .count = count, .steps = steps, .max_run = max_run };
+    scan_thread_t *t = calloc(threads, sizeof(scan_thread_t));
+    for (unsigned i = 0; i < threads; i++) {
+        t[i].job = &job;
+        ranking_init(&t[i].ranking, top);
+        pthread_create(&t[i].thread, NULL, scan_thread, &t[i]);
+    }
+    ranking_init(total, top);
+    for (unsigned i = 0; i < threads; i++) {
+        pthread_join(t[i].thread, NULL);
+        for (unsigned k = 0; k < t[i].ranking.count; k++)
+            ranking_add(total, &t[i].ranking.best[k]);
+        for (int k = 0; k <= RUN_BUCKETS; k++)
+            total->runs[k] += t[i].ranking.runs[k];
+        total->seeds += t[i].ranking.seeds;
+        free(t[i].ranking.best);
+    }
+    total->runs[RUN_BUCKETS] = total->seeds;
+    for (int k = 0; k < RUN_BUCKETS; k++)
+        total->runs[RUN_BUCKETS] -= total->runs[k];
+    free(t);
+}
+
+// ----------------------  BENCHMARK  ----------------------
+
+static volatile unsigned bench_sink;
+
+// Bit-sliced against scalar throughput on one thread, and a cross-check
+static int bench(unsigned steps)
+{
+    const uint64_t sliced_seeds = 1UL << 24, scalar_seeds = 1UL << 20;
+    struct timespec t0;
+    ranking_t r;
+    ranking_init(&r, 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    scan_range(0, sliced_seeds, steps, 1, &r);
+    double sliced = sliced_seeds / seconds_since(&t0);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    seed_metrics_t m;
+    for (uint64_t s = 0; s < scalar_seeds; s++) {
+        metrics_scalar(s, steps, &m);
+        bench_sink += m.run;
+    }
+    double scalar = scalar_seeds / seconds_since(&t0);
+
+    printf("%u steps, %u seeds per vector\n", steps, LANES);
+    printf("bit-sliced %12.0f seeds/s (full space in %.0f s per thread)\n",
+           sliced, 4294967296.0 / sliced);
+    printf("scalar     %12.0f seeds/s (%.1fx slower)\n", scalar, sliced / scalar);
+
+    // Same metrics for a spread of blocks, including seed 0
+    unsigned mismatches = 0;
+    block_t block;
+    for (uint64_t base = 0; base < (1ULL << 32); base += 0x01000000ULL + LANES * 3) {
+        scan_block(base, steps, &block);
+        for (unsigned lane = 0; lane < LANES; lane++) {
+            seed_metrics_t a, b;
+            block_lane(&block, base, lane, steps, &a);
+            metrics_scalar(base + lane, steps, &b);
+            if (memcmp(&a, &b, sizeof(a)) && mismatches++ < 5)
+                printf("mismatch at seed %08lx\n", (unsigned long)(base + lane));
+        }
+    }
+    printf("cross-check against get_next_step(): %s\n", mismatches ? "FAILED" : "ok");
+    free(r.best);
+    return mismatches != 0;
+}
+
+// ----------------------  MAIN  ----------------------
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n steps] [-k top] [-m run] [-r first:count] [-j threads] [-b]\n",
+            argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned steps = 32, top = 20, max_run = 1;
+    uint64_t first = 0, count = 1ULL << 32;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int benchmark = 0, opt;
+    while ((opt = getopt(argc, argv, "n:k:m:r:j:b")) != -1) {
+        switch (opt) {
+            case 'n': steps = strtoul(optarg, NULL, 0); break;
+            case 'k': top = strtoul(optarg, NULL, 0); break;
+            case 'm': max_run = strtoul(optarg, NULL, 0); break;
+            case 'r': {
+                char *colon;
+                first = strtoull(optarg, &colon, 16);
+                if (*colon != ':') usage(argv[0]);
+                count = strtoull(colon + 1, NULL, 0);
+                break;
+            }
+            case 'j': threads = strtol(optarg, NULL, 0); break;
+            case 'b': benchmark = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (!steps || steps > MAX_STEPS || !top || threads < 1 || !count ||
+        first + count > (1ULL << 32))
+        usage(argv[0]);
+    if (benchmark)
+        return bench(steps);
+
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ranking_t r;
+    scan(first, count, steps, max_run, top, threads, &r);
+    double seconds = seconds_since(&t0);
+
+    printf("%lu seeds, %u steps each, in %.1f s (%.0f seeds/s, %ld threads)\n",
+           (unsigned long)r.seeds, steps, seconds, r.seeds / seconds, threads);
+    printf("\nlongest run    seeds\n");
+    for (int k = 0; k <= RUN_BUCKETS; k++) {
+        if (!r.runs[k]) continue;
+        printf("%s%-9d %10lu %8.4f%%\n", k == RUN_BUCKETS ? ">=" : "  ", k,
+               (unsigned long)r.runs[k], 100.0 * r.runs[k] / r.seeds);
+    }
+    printf("\nrank  seed      run pairs balance repeats  counts\n");
+    for (unsigned i = 0; i < r.count; i++) {
+        const seed_metrics_t *m = &r.best[i];
+        printf("%4u  %08lx  %3u %5u %7u %7u  %u %u %u %u\n", i + 1, (unsigned long)m->seed,
+               m->run, m->pairs, m->balance, m->repeats, m->count[0], m->count[1], m->count[2], m->count[3]);
+    }
+    free(r.best);
+    return 0;
+}
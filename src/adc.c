@@ -3,7 +3,7 @@
 #include "stdio.h"
 #include "adc.h"
 #include "uart.h"
-#include "uart.h"
+#include "record.h"
 
 void adc_init()
 {
@@ -41,7 +41,9 @@ uint8_t adc_read()
     ADC0.INTFLAGS = ADC_RESRDY_bm;
     
     // Return the 8-bit result
-    return ADC0.RESULT0;
+    uint8_t result = ADC0.RESULT0;
+    RECORD(RECORD_ADC, result);
+    return result;
 }
 
 uint16_t get_potentiometer_delay(void)
@@ -0,0 +1,55 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include "boot.h"
+#include "uart.h"
+#include "flags.h"
+#include "timer.h"
+
+#if BOOT_PROFILE
+
+static uint16_t boot_ticks[BOOT_PHASES];
+
+static const char *const phase_names[BOOT_PHASES] = {
+    "main", "buttons", "uart", "display", "timer", "ready",
+    "adc", "pwm", "leaderboard", "first_step",
+};
+
+// ----------------------  CAPTURE  ----------------------
+
+// Runs from .init1, before the stack pointer and zero register are set up,
+// so it must not use either. The RTC clock (OSCULP32K) is always running.
+void boot_start(void) __attribute__((naked, used, section(".init1")));
+void boot_start(void)
+{
+    RTC.CTRLA = RTC_RTCEN_bm;
+}
+
+void boot_mark(boot_phase_t phase)
+{
+    boot_ticks[phase] = rtc_count();
+    // The RTC keeps running, it is the scheduler's clock
+    if (phase == BOOT_FIRST_STEP)
+        FLAG_SET(FLAG_BOOT_DONE);
+}
+
+// ----------------------  REPORT  ----------------------
+
+static uint32_t ticks_to_us(uint16_t ticks)
+{
+    return (uint32_t)ticks * 15625 / 512; // 1000000 / 32768
+}
+
+bool boot_print_report(uint8_t line)
+{
+    uint16_t prev = line ? boot_ticks[line - 1] : 0;
+    uart_send_str("BOOT ");
+    uart_send_str(phase_names[line]);
+    uart_send(' ');
+    uart_putnum32(ticks_to_us(boot_ticks[line]));
+    uart_send(' ');
+    uart_putnum32(ticks_to_us(boot_ticks[line] - prev));
+    uart_send('\n');
+    return line + 1 < BOOT_PHASES;
+}
+
+#endif
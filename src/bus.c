@@ -0,0 +1,62 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "bus.h"
+#include "health.h"
+
+// Queue lengths, powers of two
+#define GAME_QUEUE_SIZE 8
+#define AUDIO_QUEUE_SIZE 4
+#define REPORT_QUEUE_SIZE 4
+
+typedef struct {
+    msg_t *buf;
+    uint8_t mask;
+    uint8_t head; // Next slot to write
+    uint8_t tail; // Next slot to read
+} queue_t;
+
+static msg_t game_buf[GAME_QUEUE_SIZE];
+static msg_t audio_buf[AUDIO_QUEUE_SIZE];
+static msg_t report_buf[REPORT_QUEUE_SIZE];
+
+static queue_t queues[BUS_COUNT] = {
+    [BUS_GAME] = { game_buf, GAME_QUEUE_SIZE - 1, 0, 0 },
+    [BUS_AUDIO] = { audio_buf, AUDIO_QUEUE_SIZE - 1, 0, 0 },
+    [BUS_REPORT] = { report_buf, REPORT_QUEUE_SIZE - 1, 0, 0 },
+};
+
+bool bus_post(bus_queue_t queue, uint8_t type, uint32_t value)
+{
+    queue_t *q = &queues[queue];
+    bool posted = false;
+
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t next = (q->head + 1) & q->mask;
+    if (next != q->tail) {
+        msg_t *m = &q->buf[q->head];
+        m->type = type;
+        m->value = value;
+        q->head = next;
+        posted = true;
+    }
+    SREG = sreg;
+    return posted;
+}
+
+bool bus_get(bus_queue_t queue, msg_t *msg)
+{
+    queue_t *q = &queues[queue];
+    bool got = false;
+
+    uint8_t sreg = SREG;
+    cli();
+    if (q->tail != q->head) {
+        *msg = q->buf[q->tail];
+        q->tail = (q->tail + 1) & q->mask;
+        got = true;
+        HEALTH_BUSY();
+    }
+    SREG = sreg;
+    return got;
+}
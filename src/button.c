@@ -1,28 +1,37 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "button.h"
-#include "uart.h"
+#include "simon.h"
+#include "bus.h"
+#include "record.h"
+#include "timer.h"
 
 // Button state variables
-volatile uint8_t pb_debounced_state;
-volatile uint8_t pb_state_curr;
-volatile uint8_t pb_state_prev;
-volatile uint8_t pb_falling_edge;
-volatile uint8_t pb_rising_edge;
-volatile uint8_t pb_released = 1;
-volatile uint8_t pb_current = 0;
-
-// Define and initialize the global latch for button presses
-volatile uint8_t g_latched_button_flags = 0;
+static volatile uint8_t pb_debounced_state = 0xFF;
+static uint8_t pb_state_curr;
+static uint8_t pb_state_prev;
+static uint8_t pb_falling_edge;
+static uint8_t pb_rising_edge;
 
 void buttons_init(void)
 {
     // Set PORTA PIN4-7 as inputs with pull-ups
-    PORTA.DIRCLR = PIN4_bm | PIN5_bm | PIN6_bm | PIN7_bm;
-    PORTA.PIN4CTRL = PORT_PULLUPEN_bm;
-    PORTA.PIN5CTRL = PORT_PULLUPEN_bm;
-    PORTA.PIN6CTRL = PORT_PULLUPEN_bm;
-    PORTA.PIN7CTRL = PORT_PULLUPEN_bm;
+    PORTA.DIRCLR = BUTTON_PINS_gm;
+#if BUTTON_DEBOUNCE_MODE == BUTTON_DEBOUNCE_EDGE
+    // Interrupt on both edges so presses and releases are seen immediately
+    PORTA.PIN4CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+    PORTA.PIN5CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+    PORTA.PIN6CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+    PORTA.PIN7CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+    PORTA.INTFLAGS = BUTTON_PINS_gm;
+#else
+    // Falling edges only timestamp presses; the debounce samples the pins
+    PORTA.PIN4CTRL = PORT_PULLUPEN_bm | PORT_ISC_FALLING_gc;
+    PORTA.PIN5CTRL = PORT_PULLUPEN_bm | PORT_ISC_FALLING_gc;
+    PORTA.PIN6CTRL = PORT_PULLUPEN_bm | PORT_ISC_FALLING_gc;
+    PORTA.PIN7CTRL = PORT_PULLUPEN_bm | PORT_ISC_FALLING_gc;
+    PORTA.INTFLAGS = BUTTON_PINS_gm;
+#endif
 
     // Initialize states
     pb_debounced_state = PORTA.IN;
@@ -41,10 +50,11 @@ void update_button_states(void)
     pb_falling_edge = (pb_state_prev ^ pb_state_curr) & pb_state_prev;
     pb_rising_edge = (pb_state_prev ^ pb_state_curr) & pb_state_curr;
 
-    // Update the global latch with any new falling edges
-    if (pb_falling_edge) {
-        g_latched_button_flags |= pb_falling_edge;
-    }
+    // Tell the game about any new presses or releases
+    if (pb_falling_edge & BUTTON_PINS_gm)
+        bus_post(BUS_GAME, MSG_BUTTON_DOWN, pb_falling_edge & BUTTON_PINS_gm);
+    if (pb_rising_edge & BUTTON_PINS_gm)
+        bus_post(BUS_GAME, MSG_BUTTON_UP, pb_rising_edge & BUTTON_PINS_gm);
 }
 
 bool button_pressed(uint8_t button_mask)
@@ -57,17 +67,126 @@ bool button_released(uint8_t button_mask)
     return (pb_rising_edge & button_mask) != 0;
 }
 
-// extern volatile uint8_t pb_debounced_state;
-// volatile uint8_t pb_previous_state = 0xFF; // Assume all buttons are unpressed.
-// uint8_t get_button_pressed()
-// {
+// ----------------------  EDGE-TRIGGERED DEBOUNCE  ----------------------
+
+#if BUTTON_DEBOUNCE_MODE == BUTTON_DEBOUNCE_EDGE
+
+// Remaining lockout ticks per button (index 0 = PIN4 ... 3 = PIN7)
+static uint8_t pb_lockout[4];
+// Buttons currently inside their lockout window
+static uint8_t pb_locked = 0;
+
+// Accept the new level of every unlocked button in 'pins' and lock it
+static void accept_edges(uint8_t pins, uint8_t sample)
+{
+    pins &= ~pb_locked;
+    if (!pins) return;
+
+    pb_debounced_state = (pb_debounced_state & ~pins) | (sample & pins);
+    pb_locked |= pins;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (pins & (PIN4_bm << i))
+            pb_lockout[i] = BUTTON_LOCKOUT_TICKS;
+    }
+
+    // Newly pressed buttons (active low) go straight to the game fast path
+    uint8_t pressed = pins & ~sample;
+    if (pressed)
+        simon_input_edge(pressed, timer_micros());
+}
+
+// First edge wins: the debounced state follows the pin straight away and
+// any bounce inside the lockout window is ignored
+ISR(PORTA_PORT_vect)
+{
+    uint8_t flags = PORTA.INTFLAGS & BUTTON_PINS_gm;
+    PORTA.INTFLAGS = flags;
+    uint8_t sample = PORTA.IN;
+    RECORD(RECORD_PINS, sample & BUTTON_PINS_gm);
+    accept_edges(flags, sample);
+}
+
+// Edges are taken in the PORTA ISR; the 5ms tick only expires lockouts
+void button_debounce_tick(void)
+{
+    if (!pb_locked) return;
+
+    uint8_t expired = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (pb_lockout[i] && --pb_lockout[i] == 0)
+            expired |= PIN4_bm << i;
+    }
+    if (!expired) return;
+
+    pb_locked &= ~expired;
+    // A release (or press) that settled during the lockout raised no edge
+    // we acted on, so pick it up from the current pin level
+    uint8_t sample = PORTA.IN;
+    RECORD(RECORD_PINS, sample & BUTTON_PINS_gm);
+    accept_edges((sample ^ pb_debounced_state) & expired, sample);
+}
+
+#else
+
+// ----------------------  VERTICAL-COUNTER DEBOUNCE  ----------------------
+
+static uint8_t count0 = 0;
+static uint8_t count1 = 0;
+
+// A press is accepted 10-15ms after its first edge, so the PORTA ISR times
+// that edge for the fast path. Only ISRs touch these.
+static uint32_t pin_edge_us[4];      // Index 0 = PIN4 ... 3 = PIN7
+static uint8_t pin_edge_stamped = 0; // Released buttons with a time above
+static uint8_t pin_edge_recent = 0;  // Falling edges since the last tick
+static uint8_t pin_edge_quiet = 0;   // Read released, no edge, last tick
+
+// First falling edge on a released button
+ISR(PORTA_PORT_vect)
+{
+    uint8_t flags = PORTA.INTFLAGS & BUTTON_PINS_gm;
+    PORTA.INTFLAGS = flags;
+    pin_edge_recent |= flags;
+    flags &= pb_debounced_state & ~pin_edge_stamped;
+    if (!flags) return;
+
+    uint32_t now = timer_micros();
+    for (uint8_t i = 0; i < 4; i++) {
+        if (flags & (PIN4_bm << i))
+            pin_edge_us[i] = now;
+    }
+    pin_edge_stamped |= flags;
+}
+
+void button_debounce_tick(void)
+{
+    uint8_t pb_sample = PORTA.IN;
+    RECORD(RECORD_PINS, pb_sample & BUTTON_PINS_gm);
+    uint8_t pb_changed = pb_sample ^ pb_debounced_state;
     
-//     uint8_t pb_current_state = pb_debounced_state;
-//     uint8_t pb_change = pb_current_state ^ pb_previous_state;
-//     uint8_t pb_falling_edge = pb_change & ~pb_current_state;
-//     pb_previous_state = pb_current_state;
-//     return pb_falling_edge;
-// }
+    // Two-step debouncing algorithm
+    count1 = (count1 ^ count0) & pb_changed;
+    count0 = ~count0 & pb_changed;
+    uint8_t pb_toggled = count1 & count0;
+    pb_debounced_state ^= pb_toggled;
+
+    // A glitch too short to be accepted leaves its button released with no
+    // new edge for two ticks; forget its time. Bounce keeps making edges.
+    uint8_t quiet = pb_sample & pb_debounced_state & ~pin_edge_recent;
+    pin_edge_stamped &= ~(quiet & pin_edge_quiet);
+    pin_edge_quiet = quiet;
+    pin_edge_recent = 0;
 
+    // Newly pressed buttons (active low) go straight to the game fast path,
+    // timed from the first edge of the lowest one (the one the game takes),
+    // or from now if no edge was seen
+    uint8_t pb_pressed = pb_toggled & ~pb_debounced_state & BUTTON_PINS_gm;
+    if (pb_pressed) {
+        uint8_t i = 0;
+        while (!(pb_pressed & (PIN4_bm << i))) i++;
+        uint32_t edge_us = (pin_edge_stamped & (PIN4_bm << i)) ? pin_edge_us[i] : timer_micros();
+        pin_edge_stamped &= ~pb_pressed;
+        simon_input_edge(pb_pressed, edge_us);
+    }
+}
 
-// Button debouncing is now handled in timer.c ISR
\ No newline at end of file
+#endif
@@ -1,4 +1,9 @@
 #include "buzzer.h"
+#include "trace.h"
+#include "bus.h"
+#include "record.h"
+#include "flags.h"
+#include "gamestate.h"
 
 #include <stdint.h>
 
@@ -9,21 +14,20 @@
 #define MAX_OCTAVE 3
 #define MIN_OCTAVE -3
 
-volatile uint8_t is_playing = 0;
 static uint8_t selected_tone = 0;
-// The current frequency is defined globally to be used across modules
-volatile uint16_t current_freq = 0; 
 static int8_t octave = 0;
 
-// Define the current_button_playing variable
-uint8_t current_button_playing = 0;
+// Base frequencies for student number 32: E(high), C#, A, E(low)
+static const uint16_t base_freq[4] = { 324, 272, 432, 162 };
+// Current frequencies after UART transposition
+static uint16_t tone_freq[4] = { 324, 272, 432, 162 };
 
 void increase_octave(void)
 {
     if (octave < MAX_OCTAVE)
     {
         octave++;
-        if (is_playing)
+        if (FLAG_TEST(FLAG_TONE_PLAYING))
             play_tone(selected_tone);
     }
 }
@@ -33,7 +37,7 @@ void decrease_octave(void)
     if (octave > MIN_OCTAVE)
     {
         octave--;
-        if (is_playing)
+        if (FLAG_TEST(FLAG_TONE_PLAYING))
             play_tone(selected_tone);
     }
 }
@@ -43,7 +47,7 @@ void update_tone(uint8_t new_tone)
     if (new_tone > 3) return; // Validate tone number
     
     // Update the tone if already active
-    if (is_playing)
+    if (FLAG_TEST(FLAG_TONE_PLAYING))
         play_tone(new_tone);
     else
         // otherwise, select a new tone for the next time a tone is played
@@ -59,18 +63,9 @@ void play_tone(uint8_t tone)
 {
     if (tone > 3) return; // Validate tone number
 
-    extern volatile uint16_t current_freq_ehigh;
-    extern volatile uint16_t current_freq_csharp;
-    extern volatile uint16_t current_freq_a;
-    extern volatile uint16_t current_freq_elow;
-    uint16_t freq = 0;
-    switch (tone) {
-        case 0: freq = current_freq_ehigh; break;
-        case 1: freq = current_freq_csharp; break;
-        case 2: freq = current_freq_a; break;
-        case 3: freq = current_freq_elow; break;
-        default: return;
-    }    if (freq < 40) freq = 40;    if (freq > 20000) freq = 20000;
+    uint16_t freq = tone_freq[tone];
+    if (freq < 40) freq = 40;
+    if (freq > 20000) freq = 20000;
     // In order to account for the prescaler, we need to divide the frequency by the prescaler amount
     // TCA0 is running with a DIV2 prescaler, so we divide by 2
     uint32_t period = (F_CPU >> 1) / freq;
@@ -80,15 +75,15 @@ void play_tone(uint8_t tone)
     TCA0.SINGLE.CMP0BUF = period >> 1;  // 50% duty cycle
     
     selected_tone = tone;
-    current_freq = freq;
-    is_playing = 1;
-    current_button_playing = tone + 1; // Track which button is playing (1-4)
+    FLAG_SET(FLAG_TONE_PLAYING);
+    TRACE(TRACE_TONE_START, tone);
+    RECORD(RECORD_TONE, period);
 }
 
 // Function to update the currently playing tone when frequencies change
 void update_current_tone_frequency(void)
 {
-    if (is_playing) {
+    if (FLAG_TEST(FLAG_TONE_PLAYING)) {
         // Re-play the current tone with updated frequency
         play_tone(selected_tone);
     }
@@ -98,7 +93,78 @@ void stop_tone(void)
 {
     // Set compare value to 0 to turn off PWM output
     TCA0.SINGLE.CMP0BUF = 0;
-    is_playing = 0;
-    current_button_playing = 0; // No button playing
-    current_freq = 0; // Clear current frequency
-}
\ No newline at end of file
+    FLAG_CLEAR(FLAG_TONE_PLAYING);
+    TRACE(TRACE_TONE_STOP, 0);
+    RECORD(RECORD_TONE, 0);
+}
+
+// ----------------------  TRANSPOSITION  ----------------------
+
+static void increase_frequencies(void)
+{
+    // Check if any frequency would exceed 20kHz
+    for (uint8_t i = 0; i < 4; i++)
+        if (tone_freq[i] > 10000) return;
+
+    // Double all frequencies
+    for (uint8_t i = 0; i < 4; i++)
+        tone_freq[i] <<= 1;
+}
+
+static void decrease_frequencies(void)
+{
+    // Check if any frequency would go below 20Hz
+    for (uint8_t i = 0; i < 4; i++)
+        if (tone_freq[i] < 40) return;
+
+    // Halve all frequencies
+    for (uint8_t i = 0; i < 4; i++)
+        tone_freq[i] >>= 1;
+}
+
+void buzzer_task(void)
+{
+    msg_t msg;
+    while (bus_get(BUS_AUDIO, &msg)) {
+        if (msg.type != MSG_TRANSPOSE) continue;
+        switch (msg.arg) {
+            case TRANSPOSE_UP: increase_frequencies(); break;
+            case TRANSPOSE_DOWN: decrease_frequencies(); break;
+            case TRANSPOSE_RESET:
+                for (uint8_t i = 0; i < 4; i++)
+                    tone_freq[i] = base_freq[i];
+                break;
+        }
+        // Retune a tone that is already playing
+        update_current_tone_frequency();
+    }
+}
+
+// ----------------------  GAME STATE  ----------------------
+// Transposition is saved as the frequencies themselves: halving rounds, so
+// they are not always the base frequencies shifted
+
+#if GAMESTATE_ENABLE
+void buzzer_save(blob_t *b)
+{
+    for (uint8_t i = 0; i < 4; i++)
+        blob_put16(b, tone_freq[i]);
+}
+
+bool buzzer_restore(blob_t *b, bool apply)
+{
+    uint16_t freq[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        freq[i] = blob_get16(b);
+        // The range increase_frequencies() and decrease_frequencies() keep to
+        if (freq[i] < 20 || freq[i] > 20000) return false;
+    }
+    if (b->bad) return false;
+    if (apply) {
+        for (uint8_t i = 0; i < 4; i++)
+            tone_freq[i] = freq[i];
+        update_current_tone_frequency();
+    }
+    return true;
+}
+#endif
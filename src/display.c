@@ -2,25 +2,21 @@
 #include <avr/interrupt.h>
 #include "display.h"
 #include "display_macros.h"
-
-volatile uint8_t left_byte = DISP_OFF | DISP_LHS;
-volatile uint8_t right_byte = DISP_OFF;
-
+#include "record.h"
+#include "health.h"
+
+static volatile uint8_t left_byte = DISP_OFF | DISP_LHS;
+static volatile uint8_t right_byte = DISP_OFF;
+#if HEALTH_ENERGY
+// Counted on first use after a change, as update_display() can run in the
+// PORTA ISR. A change while counting leaves it unknown for the next call.
+#define LIT_UNKNOWN 0xFF
+#define LIT_COUNTING 0xFE
+static volatile uint8_t lit_segments = LIT_UNKNOWN;
+#endif
+
+// The SPI and latch pins are set up by spi_init()
 void display_init(void) {
-    PORTMUX.SPIROUTEA = PORTMUX_SPI0_ALT1_gc;  // SPI pins on PC0-3
-
-    // SPI SCK and MOSI
-    PORTC.DIRSET = PIN0_bm | PIN2_bm;   // SCK (PC0) and MOSI (PC2) output
-
-    // DISP_LATCH
-    PORTA.OUTSET = PIN1_bm;        // DISP_LATCH initial high
-    PORTA.DIRSET = PIN1_bm;        // set DISP_LATCH pin as output
-
-    SPI0.CTRLA = SPI_MASTER_bm;    // Master, /4 prescaler, MSB first
-    SPI0.CTRLB = SPI_SSD_bm;       // Mode 0, client select disable, unbuffered
-    SPI0.INTCTRL = SPI_IE_bm;      // Interrupt enable
-    SPI0.CTRLA |= SPI_ENABLE_bm;   // Enable
-    
     // Initialize with all segments off
     update_display(DISP_OFF, DISP_OFF);
 }
@@ -28,12 +24,34 @@ void display_init(void) {
 void update_display(const uint8_t left, const uint8_t right) {
     left_byte = left | DISP_LHS;   // Left side with LHS bit set
     right_byte = right;            // Right side (LHS bit not set)
+#if HEALTH_ENERGY
+    lit_segments = LIT_UNKNOWN;
+#endif
+    RECORD(RECORD_DISPLAY, (uint16_t)left << 8 | right);
 }
 
 void display_write(uint8_t data) {
     SPI0.DATA = data;
 }
 
+#if HEALTH_ENERGY
+uint8_t display_lit_segments(void) {
+    uint8_t lit = lit_segments;
+    if (lit != LIT_UNKNOWN) return lit;
+    lit_segments = LIT_COUNTING;
+    // Segments are active-low
+    uint16_t off = (uint16_t)(left_byte & DISP_OFF) << 7 | (right_byte & DISP_OFF);
+    for (lit = 14; off; off &= off - 1)
+        lit--;
+    uint8_t sreg = SREG;
+    cli();
+    if (lit_segments == LIT_COUNTING)
+        lit_segments = lit;
+    SREG = sreg;
+    return lit;
+}
+#endif
+
 void swap_display_digit(void) {
     static int digit = 0;
     if (digit) {
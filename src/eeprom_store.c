@@ -0,0 +1,163 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <string.h>
+#include "eeprom_store.h"
+
+#define STORE_PAGE_SIZE 32
+#define STORE_MAGIC 0x5A
+
+// On-EEPROM layout of one page (29 of 32 bytes used)
+typedef struct {
+    uint8_t magic;
+    uint16_t seq;     // Write sequence number, highest is newest
+    uint8_t score;
+    uint16_t reaction_ms;
+    char name[STORE_NAME_LEN + 1];
+    uint16_t crc;     // CRC-16/CCITT over all preceding bytes
+} page_image_t;
+
+_Static_assert(sizeof(page_image_t) <= STORE_PAGE_SIZE, "record must fit in one EEPROM page");
+
+// Pending page writes, started one at a time from the EEREADY interrupt
+#define STORE_QUEUE_SIZE 2
+
+typedef struct {
+    uint8_t page;
+    page_image_t image;
+} pending_write_t;
+
+static pending_write_t queue[STORE_QUEUE_SIZE];
+static volatile uint8_t queue_count = 0;
+static uint8_t queue_head = 0; // Next write to start
+
+static uint16_t next_seq = 0;
+static uint8_t next_page = 0;
+
+static volatile uint8_t *page_address(uint8_t page)
+{
+    return (volatile uint8_t *)(MAPPED_EEPROM_START + (uint16_t)page * STORE_PAGE_SIZE);
+}
+
+static uint16_t image_crc(const page_image_t *image)
+{
+    const uint8_t *bytes = (const uint8_t *)image;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < offsetof(page_image_t, crc); i++)
+        crc = _crc_ccitt_update(crc, bytes[i]);
+    return crc;
+}
+
+static bool read_image(uint8_t page, page_image_t *image)
+{
+    volatile uint8_t *src = page_address(page);
+    uint8_t *dst = (uint8_t *)image;
+    for (uint8_t i = 0; i < sizeof(page_image_t); i++)
+        dst[i] = src[i];
+    return image->magic == STORE_MAGIC && image->crc == image_crc(image);
+}
+
+// ----------------------  LOADING  ----------------------
+
+void store_init(void)
+{
+    // Continue after the newest valid record
+    page_image_t image;
+    bool found = false;
+    for (uint8_t page = 0; page < STORE_PAGES; page++) {
+        if (!read_image(page, &image)) continue;
+        if (!found || (int16_t)(image.seq - next_seq) >= 0) {
+            next_seq = image.seq;
+            next_page = page;
+            found = true;
+        }
+    }
+    if (found) {
+        next_seq++;
+        next_page = (next_page + 1) % STORE_PAGES;
+    }
+}
+
+bool store_read(uint8_t page, store_record_t *record)
+{
+    page_image_t image;
+    if (page >= STORE_PAGES || !read_image(page, &image)) return false;
+
+    record->seq = image.seq;
+    record->score = image.score;
+    record->reaction_ms = image.reaction_ms;
+    memcpy(record->name, image.name, STORE_NAME_LEN);
+    record->name[STORE_NAME_LEN] = '\0';
+    return true;
+}
+
+// ----------------------  ASYNCHRONOUS WRITES  ----------------------
+
+// Copy the next queued image into the page buffer and start an
+// erase/write; EEREADY fires when it completes. Interrupts must be off.
+static void start_next_write(void)
+{
+    if (queue_count == 0 || (NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm)) return;
+
+    pending_write_t *w = &queue[queue_head];
+    volatile uint8_t *dst = page_address(w->page);
+    const uint8_t *src = (const uint8_t *)&w->image;
+    for (uint8_t i = 0; i < sizeof(page_image_t); i++)
+        dst[i] = src[i];
+    _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
+
+    queue_head = (queue_head + 1) % STORE_QUEUE_SIZE;
+    queue_count--;
+    NVMCTRL.INTCTRL = NVMCTRL_EEREADY_bm;
+}
+
+ISR(NVMCTRL_EE_vect)
+{
+    if (queue_count)
+        start_next_write();
+    else
+        NVMCTRL.INTCTRL = 0; // EEREADY stays set while idle
+}
+
+bool store_ready(void)
+{
+    return queue_count < STORE_QUEUE_SIZE;
+}
+
+uint8_t store_write(const store_record_t *record, uint8_t pages_in_use)
+{
+    // Only one write per game is expected; with two queued, the caller
+    // tries again later. Only the ISR changes queue_count, and it only
+    // lowers it, so the slot found below stays free.
+    if (queue_count == STORE_QUEUE_SIZE) return STORE_QUEUE_FULL;
+
+    // Round robin over the pages not holding a live entry
+    uint8_t page = next_page;
+    for (uint8_t i = 0; i < STORE_PAGES && (pages_in_use & (1 << page)); i++)
+        page = (page + 1) % STORE_PAGES;
+    next_page = (page + 1) % STORE_PAGES;
+
+    // The free slot stays put while the ISR drains the queue
+    uint8_t sreg = SREG;
+    cli();
+    pending_write_t *w = &queue[(queue_head + queue_count) % STORE_QUEUE_SIZE];
+    SREG = sreg;
+
+    w->page = page;
+    memset(&w->image, 0, sizeof(page_image_t));
+    w->image.magic = STORE_MAGIC;
+    w->image.seq = next_seq++;
+    w->image.score = record->score;
+    w->image.reaction_ms = record->reaction_ms;
+    // The rest of the name field stays zeroed from the memset
+    memcpy(w->image.name, record->name, strnlen(record->name, STORE_NAME_LEN));
+    w->image.crc = image_crc(&w->image);
+
+    cli();
+    queue_count++;
+    start_next_write();
+    SREG = sreg;
+
+    return page;
+}
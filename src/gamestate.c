@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/crc16.h>
+#include "gamestate.h"
+#include "uart.h"
+#include "bus.h"
+#include "flags.h"
+
+#if GAMESTATE_ENABLE
+
+#define HEADER_SIZE 3
+#define CRC_SIZE 2
+
+// Blob received over UART. Filled by the RX ISR, then left alone until the
+// main loop has applied it (FLAG_STATE_PENDING).
+static uint8_t rx_blob[GAMESTATE_MAX_SIZE];
+static uint16_t rx_len = 0;
+static bool rx_overrun = false;
+
+static uint16_t blob_crc(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++)
+        crc = _crc_ccitt_update(crc, data[i]);
+    return crc;
+}
+
+// ----------------------  SAVE  ----------------------
+
+uint16_t gamestate_save(uint8_t *data, uint16_t size)
+{
+    if (size < HEADER_SIZE + CRC_SIZE) return 0;
+    blob_t b = { .data = data, .pos = HEADER_SIZE, .len = size - CRC_SIZE };
+    simon_save(&b);
+    buzzer_save(&b);
+    leaderboard_save(&b);
+    if (b.bad) return 0;
+
+    uint16_t payload = b.pos - HEADER_SIZE;
+    b.pos = 0;
+    blob_put8(&b, GAMESTATE_VERSION);
+    blob_put16(&b, payload);
+    b.pos = HEADER_SIZE + payload;
+    b.len = size;
+    blob_put16(&b, blob_crc(data, b.pos));
+    return b.pos;
+}
+
+// ----------------------  RESTORE  ----------------------
+
+// The parts follow each other and must fill the payload exactly
+static bool restore_parts(uint8_t *data, uint16_t len, bool apply)
+{
+    blob_t b = { .data = data, .pos = HEADER_SIZE, .len = len - CRC_SIZE };
+    // The game leaves its current state first (an ENTER_NAME exit still
+    // adds its player), then the leaderboard is replaced
+    if (!simon_restore(&b, apply)) return false;
+    if (!buzzer_restore(&b, apply)) return false;
+    if (!leaderboard_restore(&b, apply)) return false;
+    return !b.bad && b.pos == b.len;
+}
+
+bool gamestate_restore(uint8_t *data, uint16_t len)
+{
+    if (len < HEADER_SIZE + CRC_SIZE) return false;
+    blob_t b = { .data = data, .len = len };
+    if (blob_get8(&b) != GAMESTATE_VERSION) return false;
+    if (blob_get16(&b) != len - HEADER_SIZE - CRC_SIZE) return false;
+    b.pos = len - CRC_SIZE;
+    if (blob_get16(&b) != blob_crc(data, len - CRC_SIZE)) return false;
+
+    if (!restore_parts(data, len, false)) return false;
+    restore_parts(data, len, true);
+    return true;
+}
+
+// ----------------------  UART  ----------------------
+
+static void send_hex(uint8_t b)
+{
+    static const char digits[] = "0123456789abcdef";
+    uart_send(digits[b >> 4]);
+    uart_send(digits[b & 0x0F]);
+}
+
+void gamestate_print(void)
+{
+    uint8_t blob[GAMESTATE_MAX_SIZE];
+    uint16_t len = gamestate_save(blob, sizeof(blob));
+    uart_send_str("STATE ");
+    for (uint16_t i = 0; i < len; i++)
+        send_hex(blob[i]);
+    uart_send('\n');
+}
+
+void gamestate_apply_received(void)
+{
+    bool ok = !rx_overrun && gamestate_restore(rx_blob, rx_len);
+    FLAG_CLEAR(FLAG_STATE_PENDING);
+    uart_send_str(ok ? "STATE OK\n" : "STATE BAD\n");
+}
+
+bool gamestate_rx_begin(void)
+{
+    if (FLAG_TEST(FLAG_STATE_PENDING)) return false;
+    rx_len = 0;
+    rx_overrun = false;
+    return true;
+}
+
+void gamestate_rx_byte(uint8_t byte)
+{
+    if (rx_len < sizeof(rx_blob)) rx_blob[rx_len++] = byte;
+    else rx_overrun = true;
+}
+
+// A blob with a bad hex character is still reported, as rejected
+void gamestate_rx_end(bool valid)
+{
+    if (!valid) rx_overrun = true;
+    FLAG_SET(FLAG_STATE_PENDING);
+    if (!bus_post(BUS_REPORT, MSG_REPORT, 'Y'))
+        FLAG_CLEAR(FLAG_STATE_PENDING);
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+#include "health.h"
+#include "uart.h"
+#include "flags.h"
+#include "display.h"
+#include "timer.h"
+
+#if HEALTH_ENABLE
+
+#define SECOND 32768U // RTC counts
+#define FRAME_COUNTS ((uint16_t)(HEALTH_FRAME_MS * 32768UL / 1000))
+
+// RTC counts are 16-bit and wrap every 2s
+#if HEALTH_FRAME_MS < 1 || HEALTH_FRAME_MS > 1999
+#error "HEALTH_FRAME_MS must be 1 to 1999"
+#endif
+// A frame is only started with the transmit queue empty, so it never waits
+#if HEALTH_FRAME_SIZE > UART_TX_SIZE + 1
+#error "A health frame must fit in the UART transmit queue"
+#endif
+
+static uint16_t last_pass;     // RTC count at the end of the last pass
+static uint16_t last_charge;   // Time up to here is in state_time
+static uint16_t window_start;  // The second being counted
+static uint16_t window_passes = 0;
+static uint16_t second_passes = 0; // The last whole second
+static uint16_t second_len = SECOND;
+static uint16_t max_pass = 0;
+static uint16_t frame_due;
+
+static uint8_t current = SIMON_GENERATE;
+static uint32_t state_time[SIMON_STATE_COUNT];   // RTC counts
+static uint16_t state_entries[SIMON_STATE_COUNT];
+static uint16_t state_max[SIMON_STATE_COUNT];    // Longest pass ending in the state
+#if HEALTH_ENERGY
+static uint32_t state_active[SIMON_STATE_COUNT]; // Busy passes ending in the state
+static uint32_t tone_time = 0;
+static uint32_t display_time = 0;                // Any segment lit
+static uint32_t segment_time = 0;                // Lit segments x time
+#endif
+
+// ----------------------  COUNTERS  ----------------------
+
+void health_init(void)
+{
+    last_pass = last_charge = window_start = rtc_count();
+}
+
+// The time since the last charge was spent in the current state, with the
+// tone and display as they are now
+static uint16_t charge(void)
+{
+    uint16_t now = rtc_count();
+    uint16_t span = now - last_charge;
+    state_time[current] += span;
+#if HEALTH_ENERGY
+    if (FLAG_TEST(FLAG_TONE_PLAYING))
+        tone_time += span;
+    uint8_t lit = display_lit_segments();
+    if (lit) {
+        display_time += span;
+        segment_time += (uint32_t)span * lit;
+    }
+#endif
+    last_charge = now;
+    return now;
+}
+
+void health_state(uint8_t next)
+{
+    charge();
+    current = next;
+    if (state_entries[next] < 0xFFFF) state_entries[next]++;
+}
+
+void health_loop_pass(void)
+{
+    uint16_t now = charge();
+    uint16_t pass = now - last_pass;
+    last_pass = now;
+    if (pass > max_pass) max_pass = pass;
+    if (pass > state_max[current]) state_max[current] = pass;
+#if HEALTH_ENERGY
+    if (FLAG_TEST(FLAG_PASS_BUSY)) {
+        FLAG_CLEAR(FLAG_PASS_BUSY);
+        state_active[current] += pass;
+    }
+#endif
+
+    window_passes++;
+    uint16_t len = now - window_start;
+    if (len >= SECOND) {
+        second_passes = window_passes;
+        second_len = len;
+        window_passes = 0;
+        window_start = now;
+    }
+}
+
+static void reset(void)
+{
+    max_pass = 0;
+    for (uint8_t i = 0; i < SIMON_STATE_COUNT; i++) {
+        state_time[i] = 0;
+        state_entries[i] = 0;
+        state_max[i] = 0;
+#if HEALTH_ENERGY
+        state_active[i] = 0;
+#endif
+    }
+#if HEALTH_ENERGY
+    tone_time = 0;
+    display_time = 0;
+    segment_time = 0;
+#endif
+}
+
+// ----------------------  REPORT  ----------------------
+
+static uint32_t counts_to_us(uint16_t counts)
+{
+    return (uint32_t)counts * 15625 / 512; // 1000000 / 32768
+}
+
+static uint32_t counts_to_ms(uint32_t counts)
+{
+    return (counts >> 15) * 1000 + (((counts & 0x7FFF) * 1000) >> 15);
+}
+
+// A line per call, each zeroing what it printed, so nothing counted while
+// the report is being sent is lost
+bool health_print_report(uint8_t line)
+{
+    if (line == 0) {
+        uart_send_str("HEALTH LOOP ");
+        uart_putnum32((uint32_t)second_passes * SECOND / second_len);
+        uart_send(' ');
+        uart_putnum32(second_passes ? counts_to_us(second_len) / second_passes : 0);
+        uart_send(' ');
+        uart_putnum32(counts_to_us(max_pass));
+        uart_send('\n');
+        max_pass = 0;
+        return true;
+    }
+    uint8_t i = line - 1;
+    if (i < SIMON_STATE_COUNT) {
+        uart_send_str("HEALTH ");
+        uart_putnum(i);
+        uart_send(' ');
+        uart_putnum(state_entries[i]);
+        uart_send(' ');
+        uart_putnum32(counts_to_ms(state_time[i]));
+        uart_send(' ');
+        uart_putnum32(counts_to_us(state_max[i]));
+        state_time[i] = 0;
+        state_entries[i] = 0;
+        state_max[i] = 0;
+#if HEALTH_ENERGY
+        uart_send(' ');
+        uart_putnum32(counts_to_ms(state_active[i]));
+        state_active[i] = 0;
+#endif
+        uart_send('\n');
+        return HEALTH_ENERGY || i + 1 < SIMON_STATE_COUNT;
+    }
+#if HEALTH_ENERGY
+    if (i == SIMON_STATE_COUNT) {
+        uart_send_str("HEALTH TONE ");
+        uart_putnum32(counts_to_ms(tone_time));
+        uart_send('\n');
+        tone_time = 0;
+        return true;
+    }
+    uart_send_str("HEALTH DISPLAY ");
+    uart_putnum32(counts_to_ms(display_time));
+    uart_send(' ');
+    uart_putnum32(counts_to_ms(segment_time));
+    uart_send('\n');
+    display_time = 0;
+    segment_time = 0;
+#endif
+    return false;
+}
+
+// ----------------------  FRAMES  ----------------------
+
+static void frame_put8(uint8_t b, uint16_t *crc)
+{
+    *crc = _crc_ccitt_update(*crc, b);
+    uart_send(b);
+}
+
+static void frame_put16(uint16_t v, uint16_t *crc)
+{
+    frame_put8(v, crc);
+    frame_put8(v >> 8, crc);
+}
+
+static void send_frame(void)
+{
+    uint16_t crc = 0xFFFF;
+    uart_send(HEALTH_FRAME_MARK);
+    frame_put8(HEALTH_PAYLOAD_SIZE, &crc);
+    frame_put16(second_passes, &crc);
+    frame_put16(second_len, &crc);
+    frame_put16(max_pass, &crc);
+    for (uint8_t i = 0; i < SIMON_STATE_COUNT; i++) {
+        frame_put16(state_entries[i], &crc);
+        frame_put16(state_time[i] >> 5, &crc);
+    }
+    uart_send(crc);
+    uart_send(crc >> 8);
+}
+
+void health_task(void)
+{
+    // Frame bytes can include the link's frame mark, so none while linked
+    if (!FLAG_TEST(FLAG_HEALTH_STREAM) || FLAG_TEST(FLAG_RECORDING) || FLAG_TEST(FLAG_LINKED))
+        return;
+    uint16_t now = rtc_count();
+    if ((int16_t)(now - frame_due) < 0 || !uart_tx_idle())
+        return;
+    frame_due = now + FRAME_COUNTS;
+    send_frame();
+    reset();
+}
+
+void health_stream_toggle(void)
+{
+    if (FLAG_TEST(FLAG_HEALTH_STREAM)) {
+        FLAG_CLEAR(FLAG_HEALTH_STREAM);
+        return;
+    }
+    // The first frame covers a whole period
+    reset();
+    frame_due = rtc_count() + FRAME_COUNTS;
+    FLAG_SET(FLAG_HEALTH_STREAM);
+}
+
+#endif
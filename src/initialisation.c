@@ -7,28 +7,37 @@
 #include "pwm.h"
 #include "adc.h"
 #include "spi.h"
+#include "boot.h"
 
 void system_init(void) {
 }
 
+// Each peripheral is configured once, in dependency order: UART first so
+// anything after it can report, the SPI before the display state it
+// shifts out, and the timers last since their ISRs use all of the above.
 void peripherals_init(void) {
-    uart_init(); // Move this to the top!
+    uart_init();
 
     // BUZZER (PIN0), USART0 TXD (PIN2)
     PORTB.DIRSET = PIN0_bm | PIN2_bm;
+    BOOT_MARK(BOOT_UART);
 
-    // Initialise display
+    // SPI pins and latch, then the blank display
+    spi_init();
     display_init();
+    BOOT_MARK(BOOT_DISPLAY);
 
-    // Initialise SPI for display
-    spi_init();
+    // Initialise timer counters
+    timer_init();
+    BOOT_MARK(BOOT_TIMER);
+}
 
-    // Initialise ADC
+// Not needed until the first round: the ADC is first read for its playback
+// delay and the buzzer first sounds at its playback.
+void peripherals_init_deferred(void) {
     adc_init();
+    BOOT_MARK(BOOT_ADC);
 
-    // Initialise PWM
     pwm_init();
-
-    // Initialise timer counters
-    timer_init();
+    BOOT_MARK(BOOT_PWM);
 }
@@ -0,0 +1,232 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "leaderboard.h"
+#include "eeprom_store.h"
+#include "uart.h"
+#include "gamestate.h"
+
+#if MAX_NAME_LEN > STORE_NAME_LEN
+#error "EEPROM records are too short for MAX_NAME_LEN"
+#endif
+#if LEADERBOARD_SIZE > 127 || LEADERBOARD_NAME_ARENA > 0xFFFF
+#error "LEADERBOARD_SIZE or LEADERBOARD_NAME_ARENA too large"
+#endif
+
+// The top STORE_LIVE entries each own an EEPROM page; one page is always
+// kept free for the next write. Entries ranked below that are RAM only.
+#define STORE_LIVE (STORE_PAGES - 1)
+#define NO_PAGE 0xFF
+#define PAGE_PENDING 0xFE // Not written yet, see leaderboard_task()
+
+typedef struct {
+    uint8_t score;
+    uint8_t name_len;     // Bytes of this entry's name in the arena
+    uint16_t reaction_ms; // Mean reaction time for the game, REACTION_UNKNOWN if none
+    uint8_t page;         // EEPROM page holding this entry, NO_PAGE if none
+} leaderboard_entry_t;
+
+static leaderboard_entry_t leaderboard[LEADERBOARD_SIZE];
+static uint8_t leaderboard_count = 0;
+
+// Names of all entries, back to back in rank order
+static char names[LEADERBOARD_NAME_ARENA];
+static uint16_t names_used = 0;
+
+// Returns true if entry a ranks below entry b
+static bool ranks_below(const leaderboard_entry_t *a, const leaderboard_entry_t *b) {
+    if (a->score != b->score) return a->score < b->score;
+#if LEADERBOARD_TIEBREAK_SPEED
+    return a->reaction_ms > b->reaction_ms;
+#else
+    return false;
+#endif
+}
+
+bool leaderboard_qualifies(uint8_t score, uint16_t reaction_ms) {
+    if (leaderboard_count < LEADERBOARD_SIZE) return true;
+    leaderboard_entry_t candidate = { .score = score, .reaction_ms = reaction_ms };
+    return ranks_below(&leaderboard[leaderboard_count - 1], &candidate);
+}
+
+// Offset of an entry's name in the arena
+static uint16_t name_offset(uint8_t rank) {
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < rank; i++)
+        offset += leaderboard[i].name_len;
+    return offset;
+}
+
+static void drop_last(void) {
+    leaderboard_count--;
+    names_used -= leaderboard[leaderboard_count].name_len;
+}
+
+// Puts a player into place in the table if eligible, returns the rank used
+// or -1. Walks up from the bottom and shifts the entries (and names) below
+// the new one down by one, so this is O(n) rather than a resort.
+static int8_t insert_entry(const char *name, uint8_t score, uint16_t reaction_ms) {
+    leaderboard_entry_t entry = { .score = score, .reaction_ms = reaction_ms, .page = NO_PAGE };
+
+    uint8_t rank = leaderboard_count;
+    while (rank > 0 && ranks_below(&leaderboard[rank - 1], &entry)) rank--;
+    if (rank >= LEADERBOARD_SIZE) return -1;
+
+    if (leaderboard_count == LEADERBOARD_SIZE) drop_last();
+
+    uint16_t len = strnlen(name, MAX_NAME_LEN);
+    while (names_used + len > LEADERBOARD_NAME_ARENA && leaderboard_count > rank) drop_last();
+    if (names_used + len > LEADERBOARD_NAME_ARENA) len = LEADERBOARD_NAME_ARENA - names_used;
+
+    uint16_t offset = name_offset(rank);
+    memmove(&names[offset + len], &names[offset], names_used - offset);
+    memcpy(&names[offset], name, len);
+    names_used += len;
+
+    memmove(&leaderboard[rank + 1], &leaderboard[rank],
+            (leaderboard_count - rank) * sizeof(leaderboard_entry_t));
+    entry.name_len = len;
+    leaderboard[rank] = entry;
+    leaderboard_count++;
+    return rank;
+}
+
+// The EEPROM write is left to leaderboard_task(), so the game never waits
+// for the write queue
+void add_player_to_leaderboard(const char *name, uint8_t score, uint16_t reaction_ms) {
+    int8_t rank = insert_entry(name, score, reaction_ms);
+    if (rank < 0 || rank >= STORE_LIVE) return;
+
+#if LEADERBOARD_SIZE > STORE_LIVE
+    // An entry pushed out of the persisted range gives its page up (or
+    // is no longer written)
+    if (leaderboard_count > STORE_LIVE)
+        leaderboard[STORE_LIVE].page = NO_PAGE;
+#endif
+    leaderboard[rank].page = PAGE_PENDING;
+}
+
+// Persistence task: writes one pending entry per call, when the EEPROM
+// write queue has room
+void leaderboard_task(void) {
+    if (!store_ready()) return;
+    uint8_t rank = 0;
+    while (rank < leaderboard_count && rank < STORE_LIVE && leaderboard[rank].page != PAGE_PENDING)
+        rank++;
+    if (rank == leaderboard_count || rank == STORE_LIVE) return;
+
+    // Pages of the other persisted entries must not be overwritten
+    uint8_t pages_in_use = 0;
+    for (uint8_t i = 0; i < leaderboard_count && i < STORE_LIVE; i++) {
+        if (leaderboard[i].page < STORE_PAGES)
+            pages_in_use |= 1 << leaderboard[i].page;
+    }
+
+    store_record_t record;
+    record.score = leaderboard[rank].score;
+    record.reaction_ms = leaderboard[rank].reaction_ms;
+    uint8_t len = leaderboard[rank].name_len;
+    memcpy(record.name, &names[name_offset(rank)], len);
+    record.name[len] = '\0';
+    uint8_t page = store_write(&record, pages_in_use);
+    // Still pending if the queue filled up; tried again on the next call
+    if (page != STORE_QUEUE_FULL) leaderboard[rank].page = page;
+}
+
+// Rebuild the leaderboard from EEPROM at boot. Records that fail their CRC
+// are skipped; stale records of evicted entries never outrank live ones,
+// so taking the best valid records restores the table. Records go in
+// oldest first, so of two that tie the older ranks higher and a newer
+// one that tied a full table stays out, as when they were added.
+void leaderboard_load(void) {
+    store_init();
+    store_record_t record;
+    uint8_t order[STORE_PAGES];
+    uint16_t seqs[STORE_PAGES];
+    uint8_t found = 0;
+    for (uint8_t page = 0; page < STORE_PAGES; page++) {
+        if (!store_read(page, &record)) continue;
+        uint8_t i = found++;
+        for (; i > 0 && (int16_t)(record.seq - seqs[i - 1]) < 0; i--) {
+            order[i] = order[i - 1];
+            seqs[i] = seqs[i - 1];
+        }
+        order[i] = page;
+        seqs[i] = record.seq;
+    }
+    for (uint8_t i = 0; i < found; i++) {
+        store_read(order[i], &record);
+        int8_t rank = insert_entry(record.name, record.score, record.reaction_ms);
+        if (rank >= 0) leaderboard[rank].page = order[i];
+    }
+#if LEADERBOARD_SIZE > STORE_LIVE
+    for (uint8_t i = STORE_LIVE; i < leaderboard_count; i++)
+        leaderboard[i].page = NO_PAGE;
+#endif
+}
+
+// ----------------------  GAME STATE  ----------------------
+// Restored entries are RAM only (no EEPROM page), like those ranked below
+// STORE_LIVE; a later high score is still saved as usual
+
+#if GAMESTATE_ENABLE
+void leaderboard_save(blob_t *b) {
+    blob_put8(b, leaderboard_count);
+    const char *name = names;
+    for (uint8_t i = 0; i < leaderboard_count; i++) {
+        blob_put8(b, leaderboard[i].score);
+        blob_put16(b, leaderboard[i].reaction_ms);
+        blob_put8(b, leaderboard[i].name_len);
+        for (uint8_t c = 0; c < leaderboard[i].name_len; c++)
+            blob_put8(b, *name++);
+    }
+}
+
+bool leaderboard_restore(blob_t *b, bool apply) {
+    uint8_t count = blob_get8(b);
+    if (count > LEADERBOARD_SIZE) return false;
+    if (apply) {
+        leaderboard_count = 0;
+        names_used = 0;
+    }
+    uint16_t total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t score = blob_get8(b);
+        uint16_t reaction_ms = blob_get16(b);
+        uint8_t len = blob_get8(b);
+        if (len > MAX_NAME_LEN) return false;
+        char name[MAX_NAME_LEN + 1];
+        for (uint8_t c = 0; c < len; c++)
+            name[c] = blob_get8(b);
+        name[len] = '\0';
+        total += len;
+        if (apply) insert_entry(name, score, reaction_ms);
+    }
+    return !b->bad && total <= LEADERBOARD_NAME_ARENA;
+}
+#endif
+
+bool uart_print_high_scores(uint8_t line) {
+    if (line == 0) {
+        uart_send('\n'); // Ensure leaderboard starts on a new line
+        return leaderboard_count > 0;
+    }
+    // The table may have changed since the last line
+    uint8_t i = line - 1;
+    if (i >= leaderboard_count)
+        return false;
+    // Print name followed by space
+    const char *name = names + name_offset(i);
+    for (uint8_t c = 0; c < leaderboard[i].name_len; c++)
+        uart_send(*name++);
+    uart_send(' ');
+    // Print score, then mean reaction time in ms if known
+    uart_putnum(leaderboard[i].score);
+    if (leaderboard[i].reaction_ms != REACTION_UNKNOWN) {
+        uart_send(' ');
+        uart_putnum(leaderboard[i].reaction_ms);
+        uart_send_str("ms");
+    }
+    uart_send('\n');
+    return line < leaderboard_count;
+}
@@ -0,0 +1,628 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+#include "link.h"
+#include "uart.h"
+#include "timer.h"
+#include "simon.h"
+#include "bus.h"
+#include "flags.h"
+#include "gamestate.h"
+
+#if LINK_ENABLE
+
+#define FRAME_JOIN   'J'
+#define FRAME_ACCEPT 'A'
+#define FRAME_PING   'P'
+#define FRAME_PONG   'Q'
+#define FRAME_TIMES  'T'
+#define FRAME_READY  'G'
+#define FRAME_START  'S'
+#define FRAME_INPUT  'I'
+#define FRAME_RESULT 'W'
+#define FRAME_END    'E'
+
+#define JOIN_RETRY_MS 500
+#define START_WINDOWS 4   // Before the first round, for a baseline for the rate
+#define FILTER_WINDOWS 16 // The estimate follows about this many windows
+#define RX_FRAMES 4 // Power of two; a frame takes at least 3ms to arrive
+
+// Winner byte of a result frame
+#define WINNER_NONE   0
+#define WINNER_MASTER 1
+#define WINNER_SLAVE  2
+
+uint8_t link_payload_size(uint8_t type)
+{
+    switch (type) {
+        case FRAME_ACCEPT: case FRAME_END: return 0;
+        case FRAME_PING: case FRAME_PONG: case FRAME_READY: return 1;
+        case FRAME_JOIN: return 4;
+        case FRAME_START: case FRAME_INPUT: return 7;
+        case FRAME_TIMES: return 9;
+        case FRAME_RESULT: return 10;
+    }
+    return 0xFF;
+}
+
+// ----------------------  RECEIVE  ----------------------
+// Frames are assembled in the RX ISR and queued for link_task()
+
+// Link mode: joining a match, in one, or up to LINK_TIMEOUT_MS after one,
+// while its last frames may still arrive. Outside it only a JOIN is taken.
+static volatile bool link_mode = false;
+
+typedef struct {
+    uint32_t stamp;  // timer_micros() as the mark arrived
+    uint8_t type;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+} frame_t;
+
+static frame_t rx_frame;                // Being received (ISR)
+static uint8_t rx_got = 0;              // Bytes of it after the mark
+static uint8_t rx_need = 0;             // Its length after the mark, 0 between frames
+static uint8_t rx_crc;
+static frame_t rx_frames[RX_FRAMES];
+static volatile uint8_t rx_head = 0;    // Written by the ISR
+static volatile uint8_t rx_tail = 0;    // Written by link_task()
+
+
+uint8_t link_rx_byte(uint8_t byte)
+{
+    if (!rx_need) {
+        if (byte != LINK_MARK)
+            return 0;
+        rx_frame.stamp = timer_micros();
+        rx_got = 0;
+        rx_need = 1;
+        return LINK_RX_TAKEN;
+    }
+    if (!rx_got) {
+        uint8_t size = link_payload_size(byte);
+        if (size == 0xFF || !(link_mode || byte == FRAME_JOIN)) {
+            // A stray mark, typed or in console output: the console's,
+            // and so is this byte unless it is a mark itself
+            if (byte == LINK_MARK) {
+                rx_frame.stamp = timer_micros();
+                return LINK_RX_MARK | LINK_RX_TAKEN;
+            }
+            rx_need = 0;
+            return LINK_RX_MARK;
+        }
+        rx_frame.type = byte;
+        rx_crc = _crc8_ccitt_update(0, byte);
+        rx_need = size + 2;
+        rx_got = 1;
+        return LINK_RX_TAKEN;
+    }
+    if (++rx_got < rx_need) {
+        rx_frame.payload[rx_got - 2] = byte;
+        rx_crc = _crc8_ccitt_update(rx_crc, byte);
+        return LINK_RX_TAKEN;
+    }
+    rx_need = 0;
+    uint8_t head = rx_head;
+    // Dropped if corrupted or the queue is full
+    if (byte == rx_crc && (uint8_t)(head - rx_tail) < RX_FRAMES) {
+        rx_frames[head & (RX_FRAMES - 1)] = rx_frame;
+        rx_head = head + 1;
+    }
+    return LINK_RX_TAKEN;
+}
+
+static bool frame_get(frame_t *f)
+{
+    uint8_t tail = rx_tail;
+    if (tail == rx_head)
+        return false;
+    *f = rx_frames[tail & (RX_FRAMES - 1)];
+    rx_tail = tail + 1;
+    return true;
+}
+
+// ----------------------  SEND  ----------------------
+
+static void send_frame(uint8_t type, const uint8_t *payload)
+{
+    uint8_t size = link_payload_size(type);
+    uint8_t crc = _crc8_ccitt_update(0, type);
+    uart_send(LINK_MARK);
+    uart_send(type);
+    for (uint8_t i = 0; i < size; i++) {
+        crc = _crc8_ccitt_update(crc, payload[i]);
+        uart_send(payload[i]);
+    }
+    uart_send(crc);
+}
+
+static void send_byte_frame(uint8_t type, uint8_t value)
+{
+    send_frame(type, &value);
+}
+
+// ----------------------  MATCH STATE  ----------------------
+
+static bool master;
+static bool joining = false;  // Master, waiting for the accept
+static uint32_t left_ms;      // When the last match ended
+static uint32_t join_seed;
+static uint32_t join_start_ms;
+static uint32_t join_sent_ms;
+static uint32_t last_rx_ms;   // Last frame from the other board
+
+// Clock sync (master). The other board's clock reads ours plus offset,
+// which changes by rate / 2^20 us per us.
+static uint8_t ping_seq = 0;
+static uint32_t ping_sent_ms;
+static uint32_t ping_sent_us;      // t1
+static uint32_t pong_received_us;  // t4
+static bool pong_seen = false;     // pong_received_us is for ping_seq
+static uint8_t window_count;       // Samples in the current window
+static uint32_t window_delay;      // Its shortest round trip so far
+static uint32_t window_offset;     // and that sample's offset and t1
+static uint32_t window_at;
+static uint8_t windows;            // Completed, up to 255
+static uint32_t est_offset;        // Filtered, at est_at
+static uint32_t est_at;
+static uint32_t est_delay;
+static int32_t rate;
+static uint16_t samples;
+
+// Pong to send once the transmitter is idle (slave)
+static bool pong_due = false;
+static uint8_t pong_seq;
+static uint32_t ping_received_us;  // t2
+
+// Rounds. ready_round is the one this board is ready for, play_round the one
+// started last, which stays undecided until the slower player finishes.
+static uint8_t ready_round = 0;
+static uint8_t play_round = 0;
+static uint8_t other_ready = 0;    // Master: the slave's ready round
+static uint32_t ready_sent_ms;     // Slave: the last READY
+static uint16_t delay_ms;          // The master's playback delay
+static bool start_known = false;   // start_us is set for ready_round
+static uint32_t start_us;          // Own clock
+static int32_t max_late_us;
+static bool own_done, other_done;  // Master: last input or wrong input
+static uint32_t own_us, other_us;  // us from the start, or LINK_FAILED
+static uint8_t won, lost, drawn;
+
+// ----------------------  CLOCK SYNC  ----------------------
+
+// A ping's pong was received at t4 (pong_received_us), and the other board
+// received the ping at t2 and sent the pong at t3 by its clock. Its clock
+// was ahead of ours by (t2 - t1) less the one-way delay, taken as half
+// the round trip; the offset is kept from the shortest round trip of each
+// window, as queueing and ISR latency only ever lengthen a trip.
+static void sync_sample(uint32_t t2, uint32_t t3)
+{
+    int32_t delay = (int32_t)((pong_received_us - ping_sent_us) - (t3 - t2));
+    if (delay < 0) delay = 0;
+    samples++;
+    if ((uint32_t)delay < window_delay) {
+        window_delay = delay;
+        window_offset = t2 - ping_sent_us - (uint32_t)delay / 2;
+        window_at = ping_sent_us + (uint32_t)delay / 2;  // The ping's arrival
+    }
+    if (++window_count < LINK_WINDOW)
+        return;
+
+    // Alpha-beta filter of the windows' offsets: the new one corrects the
+    // offset the rate predicts, and the rate. With n windows before it the
+    // gains make it a least squares line through them all, so the error
+    // of each offset counts for less as the match goes on, up to
+    // FILTER_WINDOWS after which old windows fade out.
+    if (!windows) {
+        est_offset = window_offset;
+    } else {
+        uint8_t n = windows < FILTER_WINDOWS ? windows : FILTER_WINDOWS;
+        int32_t since = (int32_t)(window_at - est_at);
+        uint32_t predicted = est_offset + (int32_t)((int64_t)since * rate >> 20);
+        int32_t error = (int32_t)(window_offset - predicted);
+        int32_t scale = (int32_t)(n + 1) * (n + 2);
+        est_offset = predicted + error * (2 * (2 * n + 1)) / scale;
+        if (since > 0)
+            rate += (int64_t)error * 6 * 1048576 / ((int64_t)scale * since);
+    }
+    if (windows < 255) windows++;
+    est_at = window_at;
+    est_delay = window_delay;
+    window_count = 0;
+    window_delay = UINT32_MAX;
+}
+
+// Our time t in the other board's clock
+static uint32_t to_other(uint32_t t)
+{
+    int32_t since = (int32_t)(t - est_at);
+    return t + est_offset + (int32_t)((int64_t)since * rate >> 20);
+}
+
+// A time span measured by the other board, in our clock
+static uint32_t span_from_other(uint32_t span)
+{
+    return span - (int32_t)((int64_t)span * rate >> 20);
+}
+
+static void ping(void)
+{
+    ping_seq++;
+    pong_seen = false;
+    ping_sent_ms = timer_millis();
+    // The transmitter is idle: the mark goes out now
+    ping_sent_us = timer_micros();
+    send_byte_frame(FRAME_PING, ping_seq);
+}
+
+static void pong(void)
+{
+    uint8_t buf[9];
+    blob_t b = { buf, 0, sizeof buf, false };
+    uint32_t sent_us = timer_micros();
+    send_byte_frame(FRAME_PONG, pong_seq);
+    blob_put8(&b, pong_seq);
+    blob_put32(&b, ping_received_us);
+    blob_put32(&b, sent_us);
+    send_frame(FRAME_TIMES, buf);
+    pong_due = false;
+}
+
+// ----------------------  MATCH  ----------------------
+
+static void print_time(uint32_t us)
+{
+    if (us == LINK_FAILED)
+        uart_send_str("FAIL");
+    else
+        uart_putnum32(us);
+}
+
+static void print_signed(int32_t v)
+{
+    if (v < 0) {
+        uart_send('-');
+        v = -v;
+    }
+    uart_putnum32(v);
+}
+
+static void leave(void)
+{
+    if (FLAG_TEST(FLAG_LINKED)) {
+        uart_send_str("LINK MATCH ");
+        uart_putnum(won);
+        uart_send(' ');
+        uart_putnum(lost);
+        uart_send(' ');
+        uart_putnum(drawn);
+        uart_send('\n');
+    }
+    FLAG_CLEAR(FLAG_LINKED);
+    joining = false;
+    left_ms = timer_millis();
+}
+
+static void lost_link(void)
+{
+    uart_send_str("LINK LOST\n");
+    leave();
+}
+
+static void begin(uint32_t seed)
+{
+    joining = false;
+    last_rx_ms = ping_sent_ms = timer_millis();
+    pong_due = pong_seen = false;
+    window_count = 0;
+    window_delay = UINT32_MAX;
+    windows = 0;
+    rate = 0;
+    samples = 0;
+    ready_round = play_round = other_ready = 0;
+    start_known = false;
+    max_late_us = 0;
+    own_done = other_done = false;
+    won = lost = drawn = 0;
+    link_mode = true;
+    FLAG_SET(FLAG_LINKED);
+    uart_send_str(master ? "LINK MASTER\n" : "LINK SLAVE\n");
+
+    // Same restart as a recording's, so the first round is ready at once
+    simon_init();
+    bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_RESET);
+    bus_post(BUS_GAME, MSG_SEED, seed);
+}
+
+// Print a round's result from this board's side, own and other times in
+// the master's clock
+static void announce(uint8_t winner, uint32_t own, uint32_t other)
+{
+    uint8_t me = master ? WINNER_MASTER : WINNER_SLAVE;
+    uart_send_str("LINK ROUND ");
+    uart_putnum(play_round);
+    if (winner == WINNER_NONE) {
+        uart_send_str(" DRAW ");
+        drawn++;
+    } else if (winner == me) {
+        uart_send_str(" WIN ");
+        won++;
+    } else {
+        uart_send_str(" LOSE ");
+        lost++;
+    }
+    print_time(own);
+    uart_send(' ');
+    print_time(other);
+    uart_send('\n');
+    own_done = other_done = false;
+    if (own == LINK_FAILED || other == LINK_FAILED)
+        leave();
+}
+
+// Master: once both players are done, the faster correct one wins. A
+// wrong input counts as LINK_FAILED, which is slower than any time.
+static void decide(void)
+{
+    if (!own_done || !other_done)
+        return;
+    uint8_t winner = WINNER_NONE;
+    if (own_us < other_us) winner = WINNER_MASTER;
+    else if (other_us < own_us) winner = WINNER_SLAVE;
+
+    uint8_t buf[10];
+    blob_t b = { buf, 0, sizeof buf, false };
+    blob_put8(&b, play_round);
+    blob_put8(&b, winner);
+    blob_put32(&b, own_us);
+    blob_put32(&b, other_us);
+    send_frame(FRAME_RESULT, buf);
+    announce(winner, own_us, other_us);
+}
+
+static void send_start(void)
+{
+    uint8_t buf[7];
+    blob_t b = { buf, 0, sizeof buf, false };
+    blob_put8(&b, ready_round);
+    blob_put32(&b, to_other(start_us));
+    blob_put16(&b, delay_ms);
+    send_frame(FRAME_START, buf);
+}
+
+static void start_round(void)
+{
+    start_us = timer_micros() + LINK_LEAD_MS * 1000UL;
+    send_start();
+    start_known = true;
+}
+
+static void send_ready(void)
+{
+    send_byte_frame(FRAME_READY, ready_round);
+    ready_sent_ms = timer_millis();
+}
+
+static void handle_frame(frame_t *f)
+{
+    blob_t b = { f->payload, 0, link_payload_size(f->type), false };
+    bool linked = FLAG_TEST(FLAG_LINKED);
+
+    if (f->type == FRAME_JOIN) {
+        // Both pressed 'V': neither joins the other, both time out
+        if (joining || (linked && master))
+            return;
+        if (!linked) {
+            master = false;
+            begin(blob_get32(&b));
+        }
+        // Again if the last accept was lost
+        send_frame(FRAME_ACCEPT, 0);
+        return;
+    }
+    if (f->type == FRAME_ACCEPT) {
+        if (joining)
+            begin(join_seed);
+        return;
+    }
+    if (!linked)
+        return;
+    last_rx_ms = timer_millis();
+
+    switch (f->type) {
+    case FRAME_PING:
+        if (master) break;
+        pong_seq = blob_get8(&b);
+        ping_received_us = f->stamp;
+        pong_due = true;
+        break;
+    case FRAME_PONG:
+        if (!master || blob_get8(&b) != ping_seq) break;
+        pong_received_us = f->stamp;
+        pong_seen = true;
+        break;
+    case FRAME_TIMES:
+        if (!master || !pong_seen || blob_get8(&b) != ping_seq) break;
+        {
+            uint32_t t2 = blob_get32(&b);
+            sync_sample(t2, blob_get32(&b));
+        }
+        pong_seen = false;
+        break;
+    case FRAME_READY:
+        if (!master) break;
+        other_ready = blob_get8(&b);
+        // The slave sends READY until it has the START, so that was lost
+        if (start_known && other_ready == ready_round)
+            send_start();
+        break;
+    case FRAME_START:
+        if (master || blob_get8(&b) != ready_round) break;
+        start_us = blob_get32(&b);
+        delay_ms = blob_get16(&b);
+        start_known = true;
+        break;
+    case FRAME_INPUT:
+        if (!master || blob_get8(&b) != play_round) break;
+        {
+            uint8_t index = blob_get8(&b);
+            bool correct = blob_get8(&b);
+            uint32_t us = blob_get32(&b);
+            if (correct && index + 1 < play_round) break;
+            other_us = correct ? span_from_other(us) : LINK_FAILED;
+            other_done = true;
+        }
+        decide();
+        break;
+    case FRAME_RESULT:
+        if (master || blob_get8(&b) != play_round) break;
+        {
+            uint8_t winner = blob_get8(&b);
+            uint32_t master_us = blob_get32(&b);
+            announce(winner, blob_get32(&b), master_us);
+        }
+        break;
+    case FRAME_END:
+        leave();
+        break;
+    }
+}
+
+// ----------------------  TASK AND COMMANDS  ----------------------
+
+static void send_join(void)
+{
+    uint8_t buf[4];
+    blob_t b = { buf, 0, sizeof buf, false };
+    blob_put32(&b, join_seed);
+    send_frame(FRAME_JOIN, buf);
+    join_sent_ms = timer_millis();
+}
+
+void link_task(void)
+{
+    frame_t f;
+    while (frame_get(&f))
+        handle_frame(&f);
+
+    uint32_t now_ms = timer_millis();
+    if (joining) {
+        if (now_ms - join_start_ms >= LINK_TIMEOUT_MS)
+            lost_link();
+        else if (now_ms - join_sent_ms >= JOIN_RETRY_MS)
+            send_join();
+        return;
+    }
+    if (!FLAG_TEST(FLAG_LINKED)) {
+        if (link_mode && now_ms - left_ms >= LINK_TIMEOUT_MS)
+            link_mode = false;
+        return;
+    }
+    if (now_ms - last_rx_ms >= LINK_TIMEOUT_MS) {
+        lost_link();
+        return;
+    }
+
+    if (!master) {
+        if (pong_due && uart_tx_done())
+            pong();
+        // Again until the START arrives, in case either frame was lost
+        else if (ready_round && !start_known && now_ms - ready_sent_ms >= LINK_PING_MS)
+            send_ready();
+        return;
+    }
+    if (now_ms - ping_sent_ms >= LINK_PING_MS && uart_tx_done())
+        ping();
+    // Both ready and the other clock known: start the round
+    if (ready_round && other_ready == ready_round && !start_known && windows >= START_WINDOWS)
+        start_round();
+}
+
+void link_toggle(void)
+{
+    if (FLAG_TEST(FLAG_LINKED) || joining) {
+        send_frame(FRAME_END, 0);
+        leave();
+        return;
+    }
+    master = true;
+    joining = true;
+    link_mode = true;
+    join_seed = simon_game_seed();
+    join_start_ms = timer_millis();
+    send_join();
+}
+
+void link_print_report(void)
+{
+    uart_send_str("LINK SYNC ");
+    print_signed(windows ? (int32_t)est_offset : 0);
+    uart_send(' ');
+    uart_putnum32(windows ? est_delay : 0);
+    uart_send(' ');
+    // 2^20 / 10^6 = 16384 / 15625
+    print_signed((int32_t)((int64_t)rate * 15625 >> 14));
+    uart_send(' ');
+    uart_putnum(samples);
+    uart_send(' ');
+    print_signed(max_late_us);
+    uart_send('\n');
+}
+
+// ----------------------  GAME HOOKS  ----------------------
+
+void link_round_ready(uint8_t next_round, uint16_t delay)
+{
+    if (!FLAG_TEST(FLAG_LINKED))
+        return;
+    ready_round = next_round;
+    start_known = false;
+    if (master)
+        delay_ms = delay;
+    else
+        send_ready();
+}
+
+bool link_round_go(void)
+{
+    if (!FLAG_TEST(FLAG_LINKED))
+        return true;
+    if (!start_known)
+        return false;
+    int32_t late = (int32_t)(timer_micros() - start_us);
+    if (late < 0)
+        return false;
+    if (late > max_late_us)
+        max_late_us = late;
+    play_round = ready_round;
+    return true;
+}
+
+uint16_t link_playback_delay(void)
+{
+    return FLAG_TEST(FLAG_LINKED) ? delay_ms : 0;
+}
+
+void link_input(uint8_t index, bool correct, uint32_t press_us)
+{
+    if (!FLAG_TEST(FLAG_LINKED) || !play_round)
+        return;
+    uint32_t us = press_us - start_us;
+    if (!master) {
+        uint8_t buf[7];
+        blob_t b = { buf, 0, sizeof buf, false };
+        blob_put8(&b, play_round);
+        blob_put8(&b, index);
+        blob_put8(&b, correct);
+        blob_put32(&b, us);
+        send_frame(FRAME_INPUT, buf);
+        return;
+    }
+    if (correct && index + 1 < play_round)
+        return;
+    own_us = correct ? us : LINK_FAILED;
+    own_done = true;
+    decide();
+}
+
+#endif
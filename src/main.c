@@ -10,27 +10,152 @@
 #include "display.h"
 #include "display_macros.h"
 #include "simon.h"
+#include "leaderboard.h"
+#include "trace.h"
+#include "bus.h"
+#include "stackmon.h"
+#include "record.h"
+#include "boot.h"
+#include "gamestate.h"
+#include "scheduler.h"
+#include "health.h"
+#include "link.h"
 
-int main(void) {
+// ----------------------  TASKS  ----------------------
+
+// Longest line a report prints. Each line waits for this much room in the
+// transmit queue (or for it to empty), so uart_send() never blocks on it.
+#define REPORT_LINE_MAX 56
+
+// A line of a report or a command requested over UART; true while the
+// report has more lines. Single-line reports ignore line.
+static bool run_report(uint8_t command, uint8_t line) {
+    switch (command) {
+        case 'h': return uart_print_high_scores(line);
+        case 'L': simon_print_latency(); break;
+#if SIMON_PROFILE_DISPATCH
+        case 'C': simon_print_dispatch_profile(); break;
+#endif
+#if TRACE_ENABLE
+        case 'T': return trace_dump(line);
+#endif
+#if STACK_MONITOR
+        case 'S': stack_print_usage(); break;
+#endif
+#if RECORD_ENABLE
+        case 'R': record_toggle(); break;
+#endif
+#if SIMON_TURBO
+        case 'Z': simon_turbo_toggle(); break;
+        case 'z': simon_print_turbo(); break;
+#endif
+#if BOOT_PROFILE
+        case 'B': return boot_print_report(line);
+#endif
+#if GAMESTATE_ENABLE
+        case 'X': gamestate_print(); break;
+        case 'Y': gamestate_apply_received(); break;
+#endif
+#if SCHED_STATS
+        case 'K': return sched_print_report(line);
+#endif
+#if HEALTH_ENABLE
+        case 'H': return health_print_report(line);
+        case 'M': health_stream_toggle(); break;
+#endif
+#if LINK_ENABLE
+        case 'V': link_toggle(); break;
+        case 'v': link_print_report(); break;
+#endif
+    }
+    return false;
+}
+
+// Print reports requested over UART (BUS_REPORT), a line per pass so the
+// other tasks run between lines. One at a time: the next waits until the
+// last has left the transmit queue.
+static void report_task(pt_t *pt) {
+    static msg_t msg;
+    static uint8_t line;
+    PT_BEGIN(pt);
+    while (bus_get(BUS_REPORT, &msg)) {
+        line = 0;
+        while (1) {
+            PT_WAIT_UNTIL(pt, uart_tx_room() >= REPORT_LINE_MAX || uart_tx_idle());
+            if (!run_report(msg.arg, line++))
+                break;
+            PT_YIELD(pt);
+        }
+        PT_WAIT_UNTIL(pt, uart_tx_idle());
+    }
+    PT_END(pt);
+}
+
+static void input_task(pt_t *pt) { update_button_states(); }
+static void audio_task(pt_t *pt) { buzzer_task(); }
+static void game_task(pt_t *pt) { simon_task(); }
+static void uart_tx(pt_t *pt) { uart_tx_task(); }
+static void persist_task(pt_t *pt) { leaderboard_task(); }
+
+static void link_run(pt_t *pt) {
+#if LINK_ENABLE
+    link_task();
+#endif
+}
+
+static void telemetry_task(pt_t *pt) {
+#if RECORD_ENABLE
+    record_task();
+#endif
+#if HEALTH_ENABLE
+    health_task();
+#endif
+}
+
+// Deadlines: state timeouts have 1ms resolution, a character takes ~1ms
+// to send at 9600 baud, and the link holds four received frames
+const task_t sched_tasks[TASK_COUNT] = {
+    [TASK_INPUT]     = { "input",     input_task,     0,            SCHED_MS(5) },
+    [TASK_AUDIO]     = { "audio",     audio_task,     0,            SCHED_MS(10) },
+    [TASK_REPORT]    = { "report",    report_task,    0,            SCHED_MS(100) },
+    [TASK_LINK]      = { "link",      link_run,       0,            SCHED_MS(5) },
+    [TASK_GAME]      = { "game",      game_task,      0,            SCHED_MS(1) },
+    [TASK_UART_TX]   = { "uart_tx",   uart_tx,        0,            SCHED_MS(1) },
+    [TASK_PERSIST]   = { "persist",   persist_task,   SCHED_MS(10), SCHED_MS(100) },
+    [TASK_TELEMETRY] = { "telemetry", telemetry_task, 0,            SCHED_MS(20) },
+};
+
+// Everything up to the first main loop pass. Input is taken from sei()
+// on; the leaderboard (an EEPROM scan) is only needed at the first game
+// over, so it loads after that with the peripherals the first round needs.
+static void board_init(void) {
     cli();
+    BOOT_MARK(BOOT_MAIN);
     system_init();
+    // First, so the pull-ups settle while the rest is set up
     buttons_init();
+    BOOT_MARK(BOOT_BUTTONS);
     peripherals_init();
-    display_init();
     simon_init();
-    sei(); 
+    sei();
+    BOOT_MARK(BOOT_READY);
+
+    peripherals_init_deferred();
+    leaderboard_load();
+    BOOT_MARK(BOOT_LEADERBOARD);
+    sched_init();
+#if HEALTH_ENABLE
+    health_init();
+#endif
+}
+
+int main(void) {
+    board_init();
 
     while (1) {
-        update_button_states();
-        
-        // Handle UART reset command
-        extern volatile uint8_t uart_reset;
-        if (uart_reset) {
-            simon_init();  // Reset the game
-            uart_reset = 0;  // Clear the flag
-        }
-        
-        simon_task();
+        sched_pass();
+        HEALTH_LOOP_PASS();
+        BOOT_LOOP_PASS();
     }
 
     return 0;
@@ -0,0 +1,142 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "record.h"
+#include "simon.h"
+#include "uart.h"
+#include "timer.h"
+#include "bus.h"
+#include "flags.h"
+
+#if RECORD_ENABLE
+
+#if RECORD_SIZE & (RECORD_SIZE - 1)
+#error "RECORD_SIZE must be a power of two"
+#endif
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t type;
+    uint16_t value;
+} record_event_t;
+
+static record_event_t record_ring[RECORD_SIZE];
+static uint8_t record_tail = 0;  // Oldest buffered event
+static uint8_t record_count = 0;
+static uint8_t record_lost = 0;
+static uint8_t last_pins = 0;    // Pin levels last logged
+static uint32_t last_sent_ms = 0;
+
+// ----------------------  LOGGING  ----------------------
+
+// Safe from ISRs and the main loop
+void record_log(uint8_t type, uint16_t value)
+{
+    if (!FLAG_TEST(FLAG_RECORDING)) return;
+
+    uint8_t sreg = SREG;
+    cli();
+    if (type != RECORD_PINS || value != last_pins) {
+        if (type == RECORD_PINS)
+            last_pins = value;
+        if (record_count < RECORD_SIZE) {
+            record_event_t *e = &record_ring[(record_tail + record_count) & (RECORD_SIZE - 1)];
+            e->time_ms = timer_millis();
+            e->type = type;
+            e->value = value;
+            record_count++;
+        } else if (record_lost < 0xFF) {
+            record_lost++;
+        }
+    }
+    SREG = sreg;
+}
+
+// ----------------------  STREAM  ----------------------
+
+static void send_event(uint8_t type, uint32_t time_ms, uint16_t value)
+{
+    uart_send(RECORD_MARK);
+    uart_send(type);
+    uart_putnum32(time_ms - last_sent_ms);
+    uart_send(':');
+    uart_putnum(value);
+    uart_send('\n');
+    last_sent_ms = time_ms;
+}
+
+static void send_hex(uint8_t b)
+{
+    static const char digits[] = "0123456789abcdef";
+    uart_send(digits[b >> 4]);
+    uart_send(digits[b & 0x0F]);
+}
+
+// The replay starts from the same EEPROM (leaderboard) and seed
+static void record_start(void)
+{
+    uint32_t seed = simon_game_seed();
+    last_sent_ms = timer_millis();
+    send_event(RECORD_START, last_sent_ms, 0);
+
+    uart_send(RECORD_MARK);
+    uart_send('E');
+    const volatile uint8_t *eeprom = (const volatile uint8_t *)MAPPED_EEPROM_START;
+    for (uint16_t i = 0; i < EEPROM_SIZE; i++)
+        send_hex(eeprom[i]);
+    uart_send('\n');
+
+    // The seed does not fit the 16-bit event value, so it has its own line
+    uart_send(RECORD_MARK);
+    uart_send('S');
+    uart_putnum32(seed);
+    uart_send('\n');
+
+    // Same restart as the replay performs. The old state's exit actions
+    // run here, before recording starts.
+    simon_init();
+    bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_RESET);
+    bus_post(BUS_GAME, MSG_SEED, seed);
+
+    uint8_t sreg = SREG;
+    cli();
+    record_count = 0;
+    record_lost = 0;
+    last_pins = 0; // Not a valid level, so the first sample is logged
+    FLAG_SET(FLAG_RECORDING);
+    SREG = sreg;
+}
+
+void record_toggle(void)
+{
+    if (!FLAG_TEST(FLAG_RECORDING)) {
+        record_start();
+        return;
+    }
+    record_task();
+    FLAG_CLEAR(FLAG_RECORDING);
+    send_event(RECORD_STOP, timer_millis(), 0);
+}
+
+void record_task(void)
+{
+    while (1) {
+        uint8_t sreg = SREG;
+        cli();
+        if (!record_count) {
+            SREG = sreg;
+            break;
+        }
+        record_event_t e = record_ring[record_tail];
+        record_tail = (record_tail + 1) & (RECORD_SIZE - 1);
+        record_count--;
+        SREG = sreg;
+        send_event(e.type, e.time_ms, e.value);
+    }
+
+    if (record_lost) {
+        send_event(RECORD_LOST, last_sent_ms, record_lost);
+        record_lost = 0;
+    }
+}
+
+#endif
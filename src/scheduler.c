@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include "scheduler.h"
+#include "uart.h"
+#include "timer.h"
+
+// Deadlines are RTC counts (SCHED_MS), one 16-bit register read with
+// rtc_count(). They wrap every 2s, so a task can only be up to 1s late.
+// The statistics are in microseconds from timer_micros(), finer than the
+// RTC's ~31us.
+
+static pt_t task_pt[TASK_COUNT];
+// When each task is next due (every-pass tasks: their last start)
+static uint16_t task_due[TASK_COUNT];
+
+#if SCHED_STATS
+typedef struct {
+    uint16_t runs;
+    uint16_t worst;    // Longest run, us
+    uint16_t missed;   // Runs started past the deadline
+    uint16_t max_late; // Latest start after being due, us
+} task_stats_t;
+
+static task_stats_t task_stats[TASK_COUNT];
+
+static uint32_t counts_to_us(uint16_t counts)
+{
+    return (uint32_t)counts * 15625 / 512; // 1000000 / 32768
+}
+
+static uint16_t saturate16(uint32_t v)
+{
+    return v > 0xFFFF ? 0xFFFF : v;
+}
+
+// late_us is how far past due the task was when the pass began (RTC, in
+// whole counts) plus how long it then waited for the tasks before it
+static void account(task_stats_t *s, const task_t *t, uint32_t late_us, uint32_t run_us)
+{
+    if (s->runs < 0xFFFF) s->runs++;
+    if (run_us > s->worst) s->worst = saturate16(run_us);
+    if (late_us > s->max_late) s->max_late = saturate16(late_us);
+    if (late_us > counts_to_us(t->deadline) && s->missed < 0xFFFF) s->missed++;
+}
+#endif
+
+// ----------------------  SCHEDULING  ----------------------
+
+void sched_init(void)
+{
+    // Already running if BOOT_PROFILE started it from .init1
+    if (!(RTC.CTRLA & RTC_RTCEN_bm))
+        RTC.CTRLA = RTC_RTCEN_bm;
+    uint16_t now = rtc_count();
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+        task_pt[i].lc = 0;
+        task_due[i] = now;
+    }
+}
+
+void sched_pass(void)
+{
+    uint16_t now = rtc_count();
+#if SCHED_STATS
+    uint32_t pass_us = timer_micros();
+    uint32_t start_us = pass_us;
+#endif
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+        const task_t *t = &sched_tasks[i];
+        uint16_t late = now - task_due[i];
+        if ((int16_t)late < 0) continue;
+
+        t->run(&task_pt[i]);
+
+        if (t->period) {
+            task_due[i] += t->period;
+            // Too far behind to catch up: due a period from now instead
+            if ((int16_t)(now - task_due[i]) > 0)
+                task_due[i] = now + t->period;
+        } else {
+            task_due[i] = now;
+        }
+#if SCHED_STATS
+        // The next task starts when this one ends
+        uint32_t end_us = timer_micros();
+        account(&task_stats[i], t, counts_to_us(late) + (start_us - pass_us), end_us - start_us);
+        start_us = end_us;
+#endif
+    }
+}
+
+// ----------------------  REPORT  ----------------------
+
+#if SCHED_STATS
+bool sched_print_report(uint8_t line)
+{
+    task_stats_t *s = &task_stats[line];
+    uart_send_str("TASK ");
+    uart_send_str(sched_tasks[line].name);
+    uart_send(' ');
+    uart_putnum(s->runs);
+    uart_send(' ');
+    uart_putnum32(s->worst);
+    uart_send(' ');
+    uart_putnum(s->missed);
+    uart_send(' ');
+    uart_putnum32(s->max_late);
+    uart_send('\n');
+    s->runs = 0;
+    s->worst = 0;
+    s->missed = 0;
+    s->max_late = 0;
+    return line + 1 < TASK_COUNT;
+}
+#endif
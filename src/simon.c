@@ -10,6 +10,14 @@
 #include "timer.h"
 #include "adc.h"
 #include "uart.h"
+#include "trace.h"
+#include "bus.h"
+#include "leaderboard.h"
+#include "snapshot.h"
+#include "flags.h"
+#include "gamestate.h"
+#include "health.h"
+#include "link.h"
 #include <string.h>
 
 // Define display patterns for the bars
@@ -19,18 +27,9 @@
 // Game states and variables
 static simon_state_t state = SIMON_GENERATE;
 
-// Leaderboard
-#define MAX_NAME_LEN 20
+// Name entry
 #define NAME_ENTRY_TIMEOUT 5000 // 5 seconds in ms
 
-typedef struct {
-    char name[MAX_NAME_LEN + 1]; // +1 for null terminator
-    uint8_t score;
-} leaderboard_entry_t;
-
-static leaderboard_entry_t leaderboard[5];
-static uint8_t leaderboard_count = 0;
-
 // LFSR configuration
 #define LFSR_MASK 0xE2025CAB
 #define INITIAL_SEED 0x12236632  // Student number
@@ -38,7 +37,7 @@ static uint8_t leaderboard_count = 0;
 // LFSR state
 static uint32_t lfsr_state = INITIAL_SEED;
 // Replace round_seed with game_seed for persistent sequence
-uint32_t game_seed = INITIAL_SEED;
+static uint32_t game_seed = INITIAL_SEED;
 // Track whether we have a UART-provided seed for reset logic
 static uint32_t uart_provided_seed = INITIAL_SEED;
 static bool has_uart_seed = false;
@@ -50,9 +49,6 @@ static uint8_t score_to_display = 0;
 // Name entry buffer and state
 static char name_entry_buffer[MAX_NAME_LEN + 1];
 static uint8_t name_entry_len = 0;
-static uint32_t name_entry_start_time = 0;
-static uint32_t name_entry_last_input_time = 0;
-static bool name_entry_active = false;
 
 // Function to display a two-digit number
 void display_two_digit_number(uint8_t num) {
@@ -104,6 +100,10 @@ static uint8_t get_next_step(void) {
     }    return lfsr_state & 0b11;
 }
 
+uint32_t simon_game_seed(void) {
+    return game_seed;
+}
+
 void update_lfsr_state(uint32_t new_seed) {
     lfsr_state = new_seed;
 }
@@ -111,52 +111,119 @@ void update_lfsr_state(uint32_t new_seed) {
 // Remove unused variables and functions
 // Removed: sequence_length, sequence_index, lfsr_pos, sequence[], add_new_sequence_step(), reset_lfsr()
 
-void sort_leaderboard() {
-    for (uint8_t i = 0; i < leaderboard_count; i++) {
-        for (uint8_t j = i + 1; j < leaderboard_count; j++) {
-            if (leaderboard[i].score < leaderboard[j].score) {
-                leaderboard_entry_t temp = leaderboard[i];
-                leaderboard[i] = leaderboard[j];
-                leaderboard[j] = temp;
+// ----------------------  REACTION TIME STATISTICS  ----------------------
+// Time from the game starting to wait for an input to the press, kept as
+// running statistics for the current game (Welford, no sample storage).
+// All 32-bit: deviations are squared in units of 2^m2_shift Q4 us, 1us to
+// start with, and the unit doubles whenever a product or the sum would
+// not fit, so the sum keeps about 16 significant bits at any spread.
+
+#define REACTION_MAX_US 0xFFFFFFUL // Clamp so the Q4 mean fits in 32 bits
+
+typedef struct {
+    uint16_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_q4; // Mean in 1/16 us
+    uint32_t m2;      // Sum of squared deviations in units of 2^m2_shift
+    uint8_t m2_shift; // Q4 us per deviation unit, log2
+} reaction_stats_t;
+
+static reaction_stats_t reaction;
+// When the game started waiting for the current input
+static uint32_t input_armed_us = 0;
+
+static void reaction_reset(void) {
+    reaction.count = 0;
+    reaction.min_us = REACTION_MAX_US;
+    reaction.max_us = 0;
+    reaction.mean_q4 = 0;
+    reaction.m2 = 0;
+    reaction.m2_shift = 4;
+}
+
+// |value| in the current deviation unit, rounded
+static uint32_t reaction_deviation(int32_t value) {
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    return (magnitude + (1UL << (reaction.m2_shift - 1))) >> reaction.m2_shift;
+}
+
+// Add delta * delta2 to the sum; they share a sign, so it only grows
+static void reaction_add_square(int32_t delta, int32_t delta2) {
+    for (;;) {
+        uint32_t a = reaction_deviation(delta), b = reaction_deviation(delta2);
+        if (a <= 0xFFFF && b <= 0xFFFF) {
+            uint32_t m2 = reaction.m2 + (uint32_t)(uint16_t)a * (uint16_t)b;
+            if (m2 >= reaction.m2) {
+                reaction.m2 = m2;
+                return;
             }
         }
+        reaction.m2 = (reaction.m2 + 2) >> 2;
+        reaction.m2_shift++;
     }
 }
 
-// Returns true if the score is in the top 5
-bool is_player_in_top_5(uint8_t score) {
-    if (leaderboard_count < 5) return true;
-    return score > leaderboard[leaderboard_count - 1].score;
+static void reaction_add(uint32_t press_us) {
+    int32_t elapsed = (int32_t)(press_us - input_armed_us);
+    uint32_t x = elapsed < 0 ? 0 : (uint32_t)elapsed;
+    if (x > REACTION_MAX_US) x = REACTION_MAX_US;
+
+    reaction.count++;
+    if (x < reaction.min_us) reaction.min_us = x;
+    if (x > reaction.max_us) reaction.max_us = x;
+
+    int32_t x_q4 = (int32_t)(x << 4);
+    int32_t delta = x_q4 - (int32_t)reaction.mean_q4;
+    reaction.mean_q4 += delta / (int32_t)reaction.count;
+    int32_t delta2 = x_q4 - (int32_t)reaction.mean_q4;
+    reaction_add_square(delta, delta2);
 }
 
-// Adds a player to the leaderboard if eligible
-void add_player_to_leaderboard(const char* name, uint8_t score) {
-    if (!is_player_in_top_5(score)) return;
-    
-    if (leaderboard_count < 5) {
-        leaderboard[leaderboard_count].score = score;
-        strncpy(leaderboard[leaderboard_count].name, name, MAX_NAME_LEN);
-        leaderboard[leaderboard_count].name[MAX_NAME_LEN] = '\0';
-        leaderboard_count++;
-    } else {
-        leaderboard[leaderboard_count - 1].score = score;
-        strncpy(leaderboard[leaderboard_count - 1].name, name, MAX_NAME_LEN);
-        leaderboard[leaderboard_count - 1].name[MAX_NAME_LEN] = '\0';
+static uint32_t reaction_mean_us(void) {
+    return reaction.mean_q4 >> 4;
+}
+
+// Standard deviation in us (sample variance, 32-bit integer square root).
+// The variance is scaled up by 4 per step while it fits, for a finer root.
+static uint32_t reaction_stddev_us(void) {
+    if (reaction.count < 2) return 0;
+    uint32_t var = reaction.m2 / (reaction.count - 1);
+    int8_t shift = reaction.m2_shift - 4; // Root unit, 2^shift us
+    while (var && var < (1UL << 30)) {
+        var <<= 2;
+        shift--;
     }
-    sort_leaderboard();
-}
-
-// Print high scores table via UART
-void uart_print_high_scores(void) {
-    uart_send('\n'); // Ensure leaderboard starts on a new line
-    for (uint8_t i = 0; i < leaderboard_count; i++) {
-        // Print name followed by space
-        uart_send_str(leaderboard[i].name);
-        uart_send(' ');
-        // Print score followed by newline
-        uart_putnum(leaderboard[i].score);
-        uart_send('\n');
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+        if (var >= root + bit) {
+            var -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
     }
+    return shift >= 0 ? root << shift : (root + (1UL << (-shift - 1))) >> -shift;
+}
+
+// Mean reaction in ms for the leaderboard
+static uint16_t reaction_mean_ms(void) {
+    if (reaction.count == 0) return REACTION_UNKNOWN;
+    return (reaction_mean_us() + 500) / 1000;
+}
+
+static void uart_print_reaction(void) {
+    uart_send_str("REACTION ");
+    uart_putnum(reaction.count);
+    uart_send(' ');
+    uart_putnum32(reaction_mean_us());
+    uart_send(' ');
+    uart_putnum32(reaction_stddev_us());
+    uart_send(' ');
+    uart_putnum32(reaction.count ? reaction.min_us : 0);
+    uart_send(' ');
+    uart_putnum32(reaction.max_us);
+    uart_send('\n');
 }
 
 // Display pattern and play tone for a step
@@ -183,336 +250,743 @@ static void display_step_pattern(uint8_t step) {
 
 
 
-// Add a waiting_extra_delay flag
-static bool waiting_extra_delay = 0;
+// ----------------------  PRESS-TO-SOUND FAST PATH  ----------------------
 
-void simon_init(void) {
-    state = SIMON_GENERATE;
-    round_length = 1;
-    // Use UART seed if available, otherwise use INITIAL_SEED
-    if (has_uart_seed) {
-        lfsr_state = uart_provided_seed;
-        game_seed = uart_provided_seed;
-    } else {
-        lfsr_state = INITIAL_SEED;
-        game_seed = INITIAL_SEED;
-    }
-    prepare_delay();
+// FLAG_INPUT_ARMED is set while AWAITING_INPUT can take a button press from
+// the input ISR
+
+// Button (1-4) already sounded by the ISR, waiting to be confirmed
+static volatile uint8_t fast_press_button = 0;
+
+// Time of the last press's first pin edge, written by the input ISR
+static volatile uint32_t press_edge_us = 0;
+static snapshot_seq_t press_edge_seq = 0;
+
+// Edge-to-tone latency, from the press's first pin edge to play_tone(): the
+// debounce (10-15ms for the vertical counter) plus the time to sound it.
+// Updated by the input ISR on the fast path, otherwise by the main loop
+// once it has disarmed the ISR, so the two never update it at once.
+typedef struct {
+    uint16_t last_us;
+    uint16_t max_us;
+    uint16_t count;
+} latency_stats_t;
+
+static volatile latency_stats_t latency;
+static snapshot_seq_t latency_seq = 0;
+
+static uint32_t press_edge(void) {
+    uint32_t edge_us;
+    SNAPSHOT_READ(press_edge_seq, edge_us, press_edge_us);
+    return edge_us;
 }
 
-void simon_task(void) {
-    if (state == AWAITING_INPUT && (uart_button_flag || pb_falling_edge)) {
-        state_awaiting_input();
-        return;
+static void record_press_latency(void) {
+    uint32_t latency_us = timer_micros() - press_edge();
+    if (latency_us > 0xFFFF) latency_us = 0xFFFF;
+    latency.last_us = latency_us;
+    if (latency_us > latency.max_us) latency.max_us = latency_us;
+    latency.count++;
+    SNAPSHOT_PUBLISH(latency_seq);
+}
+
+static void arm_input(void) {
+    input_armed_us = timer_micros();
+    fast_press_button = 0;
+    FLAG_SET(FLAG_INPUT_ARMED);
+}
+
+// Sound a button press unless the ISR already did, and consume the fast press
+static void sound_press(uint8_t button) {
+    FLAG_CLEAR(FLAG_INPUT_ARMED);
+    if (fast_press_button != button) {
+        display_step_pattern(button - 1);
+        record_press_latency();
     }
-    switch (state) {
-        case SIMON_GENERATE: state_generate(); break;
-        case SIMON_PLAY_ON: state_play_on(); break;
-        case SIMON_PLAY_OFF: state_play_off(); break;
-        case AWAITING_INPUT: state_awaiting_input(); break;
-        case HANDLE_INPUT: state_handle_input(); break;
-        case EVALUATE_INPUT: state_evaluate_input(); break;
-        case SUCCESS: state_success(); break;
-        case FAIL: state_fail(); break;
-        case DISP_SCORE: state_disp_score(); break;
-        case DISP_BLANK: state_disp_blank(); break;
-        case ENTER_NAME: state_enter_name(); break;
+    fast_press_button = 0;
+}
+
+void simon_input_edge(uint8_t pressed, uint32_t edge_us) {
+    uint8_t button;
+    if (pressed & PIN4_bm) button = 1;
+    else if (pressed & PIN5_bm) button = 2;
+    else if (pressed & PIN6_bm) button = 3;
+    else if (pressed & PIN7_bm) button = 4;
+    else return;
+
+    press_edge_us = edge_us;
+    SNAPSHOT_PUBLISH(press_edge_seq);
+    TRACE(TRACE_INPUT, button);
+#if SIMON_FAST_PATH
+    if (FLAG_TEST(FLAG_INPUT_ARMED) && !fast_press_button) {
+        fast_press_button = button;
+        display_step_pattern(button - 1);
+        record_press_latency();
     }
+#endif
+}
+
+void simon_print_latency(void) {
+    latency_stats_t stats;
+    SNAPSHOT_READ(latency_seq, stats, latency);
+    uart_send_str("LATENCY ");
+    uart_putnum(stats.last_us);
+    uart_send(' ');
+    uart_putnum(stats.max_us);
+    uart_send(' ');
+    uart_putnum(stats.count);
+    uart_send('\n');
 }
 
 // =========================
-// State handler functions
+// State machine
 // =========================
+// Each state has entry, exit and event handlers. simon_task() turns the
+// timer deadline, button edges and UART flags into one event per call and
+// only dispatches it if the current state listens for it.
+
+typedef enum {
+    EV_UART_BUTTON = 1 << 0, // Button pressed over UART
+    EV_PRESS       = 1 << 1, // Button pressed (or sounded by the fast path)
+    EV_RELEASE     = 1 << 2, // Button released
+    EV_CHAR        = 1 << 3, // Name entry character received
+    EV_TIMEOUT     = 1 << 4, // State deadline reached
+    EV_LINK        = 1 << 5  // Linked match: the round's agreed start
+} simon_event_t;
+
+typedef struct {
+    void (*entry)(void);
+    void (*exit)(void);
+    void (*on_event)(simon_event_t event);
+    uint8_t events; // Events this state listens for
+} simon_state_handlers_t;
 
 static uint8_t simon_step = 0; // Current step being played
 static uint8_t simon_play_index = 0; // Index for Simon's playback
 static uint8_t user_input_index = 0; // Index for user input
+static bool min_time_reached = false; // HANDLE_INPUT tone has played for long enough
+static uint8_t pb_current = 0; // Button being handled (1-4)
+static bool pb_released = true; // pb_current has been released
+// Between 250ms and 2000ms, set by potentiometer at the start of each round
+static uint16_t playback_delay = 250;
+#if LINK_ENABLE
+static uint32_t input_press_us = 0; // Press being handled, for link_input()
+#endif
+
+// Inputs received from BUS_GAME, consumed by next_event()
+static uint8_t uart_button = 0; // Latest UART button (1-4), kept until awaiting input
+static uint8_t pressed_pins = 0; // Pins pressed since the last dispatch
+static uint8_t released_pins = 0; // Pins released since the last dispatch
+// Seed received over UART, applied at the start of the next round
+static uint32_t pending_seed = 0;
+static bool has_pending_seed = false;
+
+// Pending state deadline, measured against timer_elapsed_ms()
+static uint16_t state_timeout = 0;
+static bool state_timeout_armed = false;
+// Entry action still to run (after simon_init)
+static bool entry_pending = false;
+
+static void set_timeout(uint16_t ms) {
+    prepare_delay();
+    state_timeout = ms;
+    state_timeout_armed = true;
+}
+
+static void transition(simon_state_t next);
+
+// ----------------------  TURBO TEMPO  ----------------------
+// Counters cover the time since turbo was last switched on. A deadline is
+// missed when its timeout is dispatched more than 1ms late (the timer's
+// resolution), e.g. because a UART report blocked the main loop.
+
+#if SIMON_TURBO
+static bool turbo = false;
+static uint32_t turbo_start_ms = 0;
+static uint32_t turbo_stop_ms = 0;
+static uint32_t turbo_rounds = 0;     // SUCCESS and FAIL phases entered
+static uint16_t turbo_deadlines = 0;
+static uint16_t turbo_missed = 0;
+static uint16_t turbo_max_late_ms = 0;
+
+void simon_turbo_toggle(void) {
+    turbo = !turbo;
+    if (turbo) {
+        turbo_start_ms = timer_millis();
+        turbo_rounds = 0;
+        turbo_deadlines = 0;
+        turbo_missed = 0;
+        turbo_max_late_ms = 0;
+        // Takes effect now; the potentiometer is read again next round
+        playback_delay = SIMON_TURBO_DELAY_MS;
+    } else {
+        turbo_stop_ms = timer_millis();
+    }
+}
+
+static void turbo_round(void) {
+    if (turbo) turbo_rounds++;
+}
 
-void state_generate(void) {
+static void turbo_deadline(uint16_t late_ms) {
+    if (!turbo) return;
+    turbo_deadlines++;
+    if (late_ms > 1) turbo_missed++;
+    if (late_ms > turbo_max_late_ms) turbo_max_late_ms = late_ms;
+}
+
+// TURBO <on> <rounds> <rounds/s> <deadlines> <missed> <max late ms>
+void simon_print_turbo(void) {
+    uint32_t seconds = ((turbo ? timer_millis() : turbo_stop_ms) - turbo_start_ms) / 1000;
+    uint32_t rate = seconds ? turbo_rounds * 100 / seconds : 0;
+    uart_send_str("TURBO ");
+    uart_send(turbo ? '1' : '0');
+    uart_send(' ');
+    uart_putnum32(turbo_rounds);
+    uart_send(' ');
+    uart_putnum32(rate / 100);
+    uart_send('.');
+    uart_send('0' + rate / 10 % 10);
+    uart_send('0' + rate % 10);
+    uart_send(' ');
+    uart_putnum(turbo_deadlines);
+    uart_send(' ');
+    uart_putnum(turbo_missed);
+    uart_send(' ');
+    uart_putnum(turbo_max_late_ms);
+    uart_send('\n');
+}
+
+static uint16_t round_delay(void) {
+    return turbo ? SIMON_TURBO_DELAY_MS : get_potentiometer_delay();
+}
+#else
+#define turbo_round() ((void)0)
+#define turbo_deadline(late_ms) ((void)0)
+#define round_delay() get_potentiometer_delay()
+#endif
+
+// ----------------------  SIMON_GENERATE  ----------------------
+
+static void generate_entry(void) {
     // Always start from game_seed for cumulative sequence
     simon_play_index = 0;
     lfsr_state = game_seed;    
-    if(has_pending_uart_seed){
-        uart_provided_seed = new_uart_seed;
-        game_seed = new_uart_seed;
-        update_lfsr_state(new_uart_seed);
+    // First round of a new game: start fresh reaction statistics
+    if (round_length == 1) {
+        reaction_reset();
+    }
+    if(has_pending_seed){
+        uart_provided_seed = pending_seed;
+        game_seed = pending_seed;
+        update_lfsr_state(pending_seed);
         has_uart_seed = true;
-        has_pending_uart_seed = 0;
+        has_pending_seed = false;
     }
 
     // Always update delay at the start of every round
-    playback_delay = get_potentiometer_delay();
-    prepare_delay();
+    playback_delay = round_delay();
     simon_step = get_next_step();
+#if LINK_ENABLE
+    // In a linked match both boards start the round together (EV_LINK)
+    link_round_ready(round_length, playback_delay);
+    if (!link_round_go()) return;
+#endif
+    transition(SIMON_PLAY_ON);
+}
+
+static void generate_event(simon_event_t event) {
+#if LINK_ENABLE
+    uint16_t delay = link_playback_delay();
+    if (delay) playback_delay = delay;
+#endif
+    transition(SIMON_PLAY_ON);
+}
+
+// ----------------------  SIMON_PLAY_ON / SIMON_PLAY_OFF  ----------------------
+
+static void play_on_entry(void) {
     display_step_pattern(simon_step);
-    state = SIMON_PLAY_ON;
+    set_timeout(playback_delay >> 1);
 }
 
-void state_play_on(void) {
-    uint16_t half_delay = playback_delay >> 1;  // Cache the half delay value
-    if (elapsed_time_in_milliseconds >= half_delay) {
-        stop_tone();
-        update_display(DISP_OFF, DISP_OFF);
-        prepare_delay();
-        state = SIMON_PLAY_OFF;
-    }
+static void play_on_exit(void) {
+    stop_tone();
+    update_display(DISP_OFF, DISP_OFF);
 }
 
-void state_play_off(void) {
-    uint16_t half_delay = playback_delay >> 1;  // Cache the half delay value
-    if (elapsed_time_in_milliseconds >= half_delay) {
-        simon_play_index++;
-        if (simon_play_index < round_length) {
-            lfsr_state = game_seed;
-            for (uint8_t i = 0; i <= simon_play_index; i++) {
-                simon_step = get_next_step();
-            }
-            prepare_delay();
-            display_step_pattern(simon_step);
-            state = SIMON_PLAY_ON;        
-        } else {
-            user_input_index = 0;
-            lfsr_state = game_seed;
-            prepare_delay();
-            state = AWAITING_INPUT;
-            pb_current = 0;
-            pb_released = 1;
-            waiting_extra_delay = 0;
-        }
-    }
+static void play_on_event(simon_event_t event) {
+    transition(SIMON_PLAY_OFF);
 }
 
-void state_awaiting_input(void) {
-    // UART input: simulate instant press and release
-    if (uart_button_flag) {
-        uint8_t button = uart_button_flag;
-        uart_button_flag = 0;  // Clear flag immediately
-        pb_current = button;
-        display_step_pattern(pb_current - 1);
-        prepare_delay();
-        pb_released = 1;
-        waiting_extra_delay = 1;
-        state = HANDLE_INPUT;
-    } else if (pb_falling_edge & PIN4_bm) {
-        pb_current = 1;
-        display_step_pattern(0);
-        pb_released = 0;
-        prepare_delay();
-        state = HANDLE_INPUT;
-    } else if (pb_falling_edge & PIN5_bm) {
-        pb_current = 2;
-        display_step_pattern(1);
-        pb_released = 0;
-        prepare_delay();
-        state = HANDLE_INPUT;
-    } else if (pb_falling_edge & PIN6_bm) {
-        pb_current = 3;
-        display_step_pattern(2);
-        pb_released = 0;
-        prepare_delay();
-        state = HANDLE_INPUT;
-    } else if (pb_falling_edge & PIN7_bm) {
-        pb_current = 4;
-        display_step_pattern(3);
-        pb_released = 0;
-        prepare_delay();
-        state = HANDLE_INPUT;
-    }
+static void play_off_entry(void) {
+    set_timeout(playback_delay >> 1);
 }
 
-void state_handle_input(void) {
-    uint8_t button_mask = 0;
-    switch (pb_current) {
-        case 1: button_mask = PIN4_bm; break;
-        case 2: button_mask = PIN5_bm; break;
-        case 3: button_mask = PIN6_bm; break;
-        case 4: button_mask = PIN7_bm; break;
-        default: break;
-    }
-    bool button_released = (pb_rising_edge & button_mask) || pb_released;
-    uint16_t half_delay = playback_delay >> 1;  // Cache the half delay value
-    bool min_time_reached = elapsed_time_in_milliseconds >= half_delay;
-    bool should_stop = min_time_reached && (button_released || pb_current == 0);
-    if (pb_released && waiting_extra_delay) {
-        should_stop = min_time_reached;
-    }
-    if (should_stop) {
-        stop_tone();
-        update_display(DISP_OFF, DISP_OFF);
-        prepare_delay();
-        waiting_extra_delay = 0;
-        pb_released = 1;
-        // Check user input against generated step
+static void play_off_event(simon_event_t event) {
+    simon_play_index++;
+    if (simon_play_index < round_length) {
         lfsr_state = game_seed;
-        for (uint8_t i = 0; i <= user_input_index; i++) {
+        for (uint8_t i = 0; i <= simon_play_index; i++) {
             simon_step = get_next_step();
         }
-        if ((pb_current - 1) == simon_step) {
-            user_input_index++;
-            if (user_input_index < round_length) {
-                state = AWAITING_INPUT;
-            } else {
-                update_display(DISP_SUCCESS, DISP_SUCCESS);
-                prepare_delay();
-                state = SUCCESS;
-            }
-        } else {
-            update_display(DISP_FAIL, DISP_FAIL);
-            prepare_delay();
-            state = FAIL;
-        }
+        transition(SIMON_PLAY_ON);
+    } else {
+        user_input_index = 0;
+        lfsr_state = game_seed;
+        transition(AWAITING_INPUT);
     }
-    if (!pb_released && (pb_rising_edge & button_mask)) {
-        pb_released = 1;
+}
+
+// ----------------------  AWAITING_INPUT  ----------------------
+
+static void awaiting_input_entry(void) {
+    prepare_delay();
+    pb_current = 0;
+    pb_released = true;
+    arm_input();
+}
+
+static void awaiting_input_exit(void) {
+    FLAG_CLEAR(FLAG_INPUT_ARMED);
+    // Cancel a press the input ISR sounded but the game never confirmed
+    if (fast_press_button) {
+        stop_tone();
+        update_display(DISP_OFF, DISP_OFF);
+        fast_press_button = 0;
     }
 }
 
-void state_success(void) {
-    static uint8_t first_entry = 1;
-    if (first_entry) {
-        // Send SUCCESS message via UART during SUCCESS pattern display
-        uart_send_str("SUCCESS\n");
-        uart_putnum(round_length);
-        uart_send('\n');
-        prepare_delay();
-        first_entry = 0;
+static void awaiting_input_event(simon_event_t event) {
+    if (event == EV_UART_BUTTON) {
+        // UART input: simulate instant press and release
+        uint8_t button = uart_button;
+        uart_button = 0;  // Clear flag immediately
+        FLAG_CLEAR(FLAG_INPUT_ARMED);
+        fast_press_button = 0;  // UART wins over a fast-path press
+        uint32_t press_us = timer_micros();
+        reaction_add(press_us);
+#if LINK_ENABLE
+        input_press_us = press_us;
+#endif
+        pb_current = button;
+        display_step_pattern(pb_current - 1);
+        pb_released = true;
+        transition(HANDLE_INPUT);
+        return;
     }
-    if (elapsed_time_in_milliseconds >= playback_delay) {
-        update_display(DISP_OFF, DISP_OFF);
-        prepare_delay();
-        // On success, increase round length (do not change game_seed)
-        round_length++;
-        first_entry = 1;
-        state = SIMON_GENERATE;
+
+    // Confirm the button the input ISR already sounded, if any
+    uint8_t button = fast_press_button;
+    if (!button) {
+        if (pressed_pins & PIN4_bm) button = 1;
+        else if (pressed_pins & PIN5_bm) button = 2;
+        else if (pressed_pins & PIN6_bm) button = 3;
+        else if (pressed_pins & PIN7_bm) button = 4;
+    }
+    if (button) {
+        uint32_t press_us = press_edge();
+        reaction_add(press_us);
+#if LINK_ENABLE
+        input_press_us = press_us;
+#endif
+        pb_current = button;
+        sound_press(button);
+        pb_released = false;
+        transition(HANDLE_INPUT);
     }
 }
 
-void state_fail(void) {
-    static uint8_t first_entry = 1;
-    if (first_entry) {
-        // Send GAME OVER message via UART during FAIL pattern display
-        uart_send_str("GAME OVER\n");
-        uart_putnum(round_length);
-        uart_send('\n');
-        prepare_delay();
-        first_entry = 0;
+// ----------------------  HANDLE_INPUT  ----------------------
+// The tone plays for at least half the playback delay and until the button
+// is released, then the input is checked against the sequence
+
+static void handle_input_entry(void) {
+    min_time_reached = false;
+    set_timeout(playback_delay >> 1);
+}
+
+static void handle_input_exit(void) {
+    stop_tone();
+    update_display(DISP_OFF, DISP_OFF);
+    pb_released = true;
+}
+
+static void evaluate_input(void) {
+    // Check user input against generated step
+    lfsr_state = game_seed;
+    for (uint8_t i = 0; i <= user_input_index; i++) {
+        simon_step = get_next_step();
     }
-    if (elapsed_time_in_milliseconds >= playback_delay) {
-        update_display(DISP_OFF, DISP_OFF);
-        lfsr_state = game_seed;
-        // Advance LFSR multiple times to ensure a different sequence
-        // If sequnce 1,2,3,4,1,4 and playe fails at round 3, the next sequence should be 4 and then 1,4...n
-        for(uint8_t i = 0; i < round_length; i++) {
-            get_next_step();
+    bool correct = (pb_current - 1) == simon_step;
+#if LINK_ENABLE
+    link_input(user_input_index, correct, input_press_us);
+#endif
+    if (correct) {
+        user_input_index++;
+        if (user_input_index < round_length) {
+            transition(AWAITING_INPUT);
+        } else {
+            transition(SUCCESS);
         }
-        game_seed = lfsr_state;
-        score_to_display = round_length;
-        round_length = 1;
-        first_entry = 1;
-        prepare_delay();      
-        state = DISP_SCORE;
+    } else {
+        transition(FAIL);
     }
 }
 
-void state_disp_score(void) {
-    static uint8_t first_entry = 1;
-    if (first_entry) {
-        display_two_digit_number(score_to_display);
-        prepare_delay();
-        first_entry = 0;
+static void handle_input_event(simon_event_t event) {
+    if (event == EV_TIMEOUT) {
+        min_time_reached = true;
+    } else {
+        uint8_t button_mask = PIN4_bm << (pb_current - 1);
+        if (!(released_pins & button_mask)) return;
+        pb_released = true;
     }
-    if (elapsed_time_in_milliseconds >= playback_delay) {
-        update_display(DISP_OFF, DISP_OFF);
-        prepare_delay();
-        first_entry = 1;
-        // Always go to DISP_BLANK first (spec requirement)
-        state = DISP_BLANK;
+    if (min_time_reached && pb_released) {
+        evaluate_input();
     }
 }
 
-void state_evaluate_input(void) {
-    prepare_delay();  // Reset timer when transitioning to AWAITING_INPUT
-    state = AWAITING_INPUT;
+// ----------------------  SUCCESS / FAIL  ----------------------
+
+static void success_entry(void) {
+    update_display(DISP_SUCCESS, DISP_SUCCESS);
+    // Send SUCCESS message via UART during SUCCESS pattern display
+    uart_send_str("SUCCESS\n");
+    uart_putnum(round_length);
+    uart_send('\n');
+    turbo_round();
+    set_timeout(playback_delay);
 }
 
-void state_disp_blank(void) {
-    static uint8_t first_entry = 1;
-    if (first_entry) {
-        update_display(DISP_OFF, DISP_OFF);
-        prepare_delay();
-        first_entry = 0;
-    }
-    if (elapsed_time_in_milliseconds >= playback_delay) {
-        prepare_delay();
-        first_entry = 1;
-        
-        // Check if we should prompt for name entry (after score display and blank period)
-        if (is_player_in_top_5(score_to_display)) {
-            state = ENTER_NAME;
-        } else {
-            // For new game, just reset round length but keep LFSR advancing
-            round_length = 1;
-            score_to_display = 0; // Reset score display flag
-            state = SIMON_GENERATE;
-        }
+static void success_event(simon_event_t event) {
+    // On success, increase round length (do not change game_seed)
+    round_length++;
+    transition(SIMON_GENERATE);
+}
+
+static void fail_entry(void) {
+    update_display(DISP_FAIL, DISP_FAIL);
+    // Send GAME OVER message via UART during FAIL pattern display
+    uart_send_str("GAME OVER\n");
+    uart_putnum(round_length);
+    uart_send('\n');
+    uart_print_reaction();
+    turbo_round();
+    set_timeout(playback_delay);
+}
+
+static void fail_event(simon_event_t event) {
+    lfsr_state = game_seed;
+    // Advance LFSR multiple times to ensure a different sequence
+    // If sequnce 1,2,3,4,1,4 and playe fails at round 3, the next sequence should be 4 and then 1,4...n
+    for(uint8_t i = 0; i < round_length; i++) {
+        get_next_step();
     }
+    game_seed = lfsr_state;
+    score_to_display = round_length;
+    round_length = 1;
+    transition(DISP_SCORE);
 }
 
-// Name entry state handler
-void state_enter_name(void) {
-    extern volatile uint32_t uart_input_timer;
-    if (!name_entry_active) {
-        name_entry_len = 0;
-        name_entry_buffer[0] = '\0';
-        name_entry_start_time = uart_input_timer;
-        name_entry_last_input_time = name_entry_start_time;
-        name_entry_active = true;        uart_enable_name_entry(); // Enable name entry mode
-        uart_send_str("Enter name: ");
+// Shared exit for the timed display states
+static void display_off_exit(void) {
+    update_display(DISP_OFF, DISP_OFF);
+}
+
+// ----------------------  DISP_SCORE / DISP_BLANK  ----------------------
+
+static void disp_score_entry(void) {
+    display_two_digit_number(score_to_display);
+    set_timeout(playback_delay);
+}
+
+static void disp_score_event(simon_event_t event) {
+    // Always go to DISP_BLANK first (spec requirement)
+    transition(DISP_BLANK);
+}
+
+static void disp_blank_entry(void) {
+    update_display(DISP_OFF, DISP_OFF);
+    set_timeout(playback_delay);
+}
+
+static void disp_blank_event(simon_event_t event) {
+    // Check if we should prompt for name entry (after score display and blank period)
+    if (leaderboard_qualifies(score_to_display, reaction_mean_ms())) {
+        transition(ENTER_NAME);
+    } else {
+        // For new game, just reset round length but keep LFSR advancing
+        round_length = 1;
+        score_to_display = 0; // Reset score display flag
+        transition(SIMON_GENERATE);
     }
-    
-    // Process one character at a time to avoid blocking the state machine
-    if (uart_rx_available()) {
+}
+
+// ----------------------  ENTER_NAME  ----------------------
+// Name entry ends on newline, or 5s after the prompt or the last character
+
+static void enter_name_entry(void) {
+    name_entry_len = 0;
+    name_entry_buffer[0] = '\0';
+    uart_enable_name_entry(); // Enable name entry mode
+    uart_send_str("Enter name: ");
+    set_timeout(NAME_ENTRY_TIMEOUT);
+}
+
+// Also left by a reset, which saves nothing
+static void enter_name_exit(void) {
+    uart_disable_name_entry(); // Disable name entry mode
+}
+
+// Newline or timeout: the name so far is the player's
+static void enter_name_done(void) {
+    name_entry_buffer[name_entry_len] = '\0';
+    add_player_to_leaderboard(name_entry_buffer, score_to_display, reaction_mean_ms());
+    // Print updated high scores table, a line per pass with the reports
+    bus_post(BUS_REPORT, MSG_REPORT, 'h');
+    transition(SIMON_GENERATE);
+}
+
+static void enter_name_event(simon_event_t event) {
+    if (event == EV_CHAR) {
+        // One character per event to avoid blocking the state machine
         char c = uart_receive();          
-        if (c == '\n' || c == '\r') {
-            name_entry_buffer[name_entry_len] = '\0';
-            add_player_to_leaderboard(name_entry_buffer, score_to_display);
-            uart_print_high_scores(); // Print updated high scores table
-            uart_disable_name_entry(); // Disable name entry mode
-            name_entry_active = false;
-            // prepare_delay(); // Reset timer for next state
-            state = SIMON_GENERATE;
+        if (c != '\n' && c != '\r') {
+            if (name_entry_len < MAX_NAME_LEN) {
+                name_entry_buffer[name_entry_len++] = c;
+                name_entry_buffer[name_entry_len] = '\0';
+                set_timeout(NAME_ENTRY_TIMEOUT);
+            }
             return;
         }
-        else if (name_entry_len < MAX_NAME_LEN) {
-            name_entry_buffer[name_entry_len++] = c;
-            name_entry_buffer[name_entry_len] = '\0';
-            name_entry_last_input_time = uart_input_timer;
+    }
+    enter_name_done();
+}
+
+// Indexed by simon_state_t. const data stays in flash on the AVRxt core,
+// which maps program memory into the data address space.
+static const simon_state_handlers_t state_table[] = {
+    [SIMON_GENERATE] = { generate_entry,       0,                   generate_event,       EV_LINK },
+    [SIMON_PLAY_ON]  = { play_on_entry,        play_on_exit,        play_on_event,        EV_TIMEOUT },
+    [SIMON_PLAY_OFF] = { play_off_entry,       0,                   play_off_event,       EV_TIMEOUT },
+    [AWAITING_INPUT] = { awaiting_input_entry, awaiting_input_exit, awaiting_input_event, EV_UART_BUTTON | EV_PRESS },
+    [HANDLE_INPUT]   = { handle_input_entry,   handle_input_exit,   handle_input_event,   EV_RELEASE | EV_TIMEOUT },
+    [SUCCESS]        = { success_entry,        display_off_exit,    success_event,        EV_TIMEOUT },
+    [FAIL]           = { fail_entry,           display_off_exit,    fail_event,           EV_TIMEOUT },
+    [DISP_SCORE]     = { disp_score_entry,     display_off_exit,    disp_score_event,     EV_TIMEOUT },
+    [DISP_BLANK]     = { disp_blank_entry,     0,                   disp_blank_event,     EV_TIMEOUT },
+    [ENTER_NAME]     = { enter_name_entry,     enter_name_exit,     enter_name_event,     EV_CHAR | EV_TIMEOUT },
+};
+
+// Run the exit action of the current state and the entry action of the next
+static void transition(simon_state_t next) {
+    if (state_table[state].exit)
+        state_table[state].exit();
+    state = next;
+    state_timeout_armed = false;
+    TRACE(TRACE_STATE, next);
+    HEALTH_STATE(next);
+    if (state_table[state].entry)
+        state_table[state].entry();
+}
+
+// Highest-priority pending event the current state listens for, or 0
+static uint8_t next_event(uint8_t listening) {
+    if ((listening & EV_UART_BUTTON) && uart_button)
+        return EV_UART_BUTTON;
+    if ((listening & EV_PRESS) && (fast_press_button || pressed_pins))
+        return EV_PRESS;
+    if ((listening & EV_RELEASE) && released_pins)
+        return EV_RELEASE;
+    if ((listening & EV_CHAR) && uart_rx_available())
+        return EV_CHAR;
+#if LINK_ENABLE
+    if ((listening & EV_LINK) && link_round_go())
+        return EV_LINK;
+#endif
+    if ((listening & EV_TIMEOUT) && state_timeout_armed) {
+        uint16_t elapsed = timer_elapsed_ms();
+        if (elapsed >= state_timeout) {
+            state_timeout_armed = false;
+            turbo_deadline(elapsed - state_timeout);
+            return EV_TIMEOUT;
         }
     }
-    
-    uint32_t now = uart_input_timer;
-    
-    // Timeout: no input at all
-    if (name_entry_len == 0 && (now - name_entry_start_time >= NAME_ENTRY_TIMEOUT)) {
-        name_entry_buffer[0] = '\0';
-        add_player_to_leaderboard(name_entry_buffer, score_to_display);
-        uart_print_high_scores(); // Print updated high scores table
-        uart_disable_name_entry(); // Disable name entry mode
-        name_entry_active = false;
-        // prepare_delay(); // Reset timer for next state        
-        state = SIMON_GENERATE;
-        return;
+    return 0;
+}
+
+// ----------------------  DISPATCH PROFILING  ----------------------
+// Enable with -DSIMON_PROFILE_DISPATCH=1. TCB0 counts CPU cycles and wraps
+// every 1ms, so each simon_task() call is timed in cycles from its count.
+
+#if SIMON_PROFILE_DISPATCH
+static uint16_t dispatch_max_cycles = 0;
+static uint32_t dispatch_total_cycles = 0;
+static uint16_t dispatch_calls = 0;
+
+static void profile_dispatch(uint16_t start) {
+    uint16_t end = TCB0.CNT;
+    uint16_t cycles = end >= start ? end - start : end + 3333 - start;
+    if (cycles > dispatch_max_cycles) dispatch_max_cycles = cycles;
+    dispatch_total_cycles += cycles;
+    dispatch_calls++;
+}
+
+void simon_print_dispatch_profile(void) {
+    uart_send_str("DISPATCH ");
+    uart_putnum(dispatch_max_cycles);
+    uart_send(' ');
+    uart_putnum(dispatch_calls ? dispatch_total_cycles / dispatch_calls : 0);
+    uart_send('\n');
+    dispatch_max_cycles = 0;
+    dispatch_total_cycles = 0;
+    dispatch_calls = 0;
+}
+#endif
+
+void simon_init(void) {
+    // Leave the current state cleanly, the new game starts on the next task call
+    if (!entry_pending && state_table[state].exit)
+        state_table[state].exit();
+    state = SIMON_GENERATE;
+    state_timeout_armed = false;
+    entry_pending = true;
+    round_length = 1;
+    // Use UART seed if available, otherwise use INITIAL_SEED
+    if (has_uart_seed) {
+        lfsr_state = uart_provided_seed;
+        game_seed = uart_provided_seed;
+    } else {
+        lfsr_state = INITIAL_SEED;
+        game_seed = INITIAL_SEED;
     }
-    
-    // Timeout: no input for 5s after last char
-    if (name_entry_len > 0 && (now - name_entry_last_input_time >= NAME_ENTRY_TIMEOUT)) {
-        name_entry_buffer[name_entry_len] = '\0';
-        add_player_to_leaderboard(name_entry_buffer, score_to_display);
-        uart_print_high_scores(); // Print updated high scores table
-        uart_disable_name_entry(); // Disable name entry mode
-        name_entry_active = false;
-        // prepare_delay(); // Reset timer for next state
-        state = SIMON_GENERATE;
-        return;
+    prepare_delay();
+}
+
+// ----------------------  GAME STATE  ----------------------
+// The game's part of a gamestate.h blob. A restore resumes at the start of
+// the saved state; HANDLE_INPUT is saved as AWAITING_INPUT, as the press
+// being handled is not part of the state. The LFSR is rewound from
+// game_seed as each step is needed, so it is not saved, and reaction
+// statistics start afresh.
+
+#if GAMESTATE_ENABLE
+#define SAVED_UART_SEED (1 << 0)
+#define SAVED_TURBO     (1 << 1)
+
+void simon_save(blob_t *b) {
+    uint8_t flags = has_uart_seed ? SAVED_UART_SEED : 0;
+#if SIMON_TURBO
+    if (turbo) flags |= SAVED_TURBO;
+#endif
+    blob_put8(b, state == HANDLE_INPUT ? AWAITING_INPUT : state);
+    blob_put8(b, flags);
+    blob_put32(b, game_seed);
+    blob_put32(b, uart_provided_seed);
+    blob_put8(b, round_length);
+    blob_put8(b, simon_play_index);
+    blob_put8(b, user_input_index);
+    blob_put8(b, simon_step);
+    blob_put8(b, score_to_display);
+    blob_put16(b, playback_delay);
+}
+
+bool simon_restore(blob_t *b, bool apply) {
+    uint8_t saved_state = blob_get8(b);
+    uint8_t flags = blob_get8(b);
+    uint32_t seed = blob_get32(b);
+    uint32_t reset_seed = blob_get32(b);
+    uint8_t length = blob_get8(b);
+    uint8_t play_index = blob_get8(b);
+    uint8_t input_index = blob_get8(b);
+    uint8_t step = blob_get8(b);
+    uint8_t score = blob_get8(b);
+    uint16_t delay = blob_get16(b);
+    // Playback and input replay the sequence up to their index, so neither
+    // may run past the round; the delay is within the potentiometer's range
+    if (b->bad || saved_state > ENTER_NAME || saved_state == HANDLE_INPUT ||
+        length == 0 || play_index > length || input_index > length ||
+        step > 3 || delay == 0 || delay > 2000)
+        return false;
+    if (!apply) return true;
+
+    // Leave the current state as simon_init() does
+    if (!entry_pending && state_table[state].exit)
+        state_table[state].exit();
+    state = saved_state;
+    state_timeout_armed = false;
+    entry_pending = true;
+
+#if SIMON_TURBO
+    if (!(flags & SAVED_TURBO) != !turbo)
+        simon_turbo_toggle();
+#endif
+    has_uart_seed = flags & SAVED_UART_SEED;
+    game_seed = seed;
+    lfsr_state = seed;
+    uart_provided_seed = reset_seed;
+    round_length = length;
+    simon_play_index = play_index;
+    user_input_index = input_index;
+    simon_step = step;
+    score_to_display = score;
+    playback_delay = delay;
+
+    // Inputs and a seed meant for the old game are dropped
+    uart_button = 0;
+    has_pending_seed = false;
+    reaction_reset();
+    prepare_delay();
+    return true;
+}
+#endif
+
+// Drain BUS_GAME into the input latches used by next_event()
+static void receive_messages(void) {
+    msg_t msg;
+    while (bus_get(BUS_GAME, &msg)) {
+        switch (msg.type) {
+            case MSG_BUTTON_DOWN:
+                // A release queued before the press is from an earlier one
+                pressed_pins |= msg.arg;
+                released_pins &= ~msg.arg;
+                break;
+            case MSG_BUTTON_UP: released_pins |= msg.arg; break;
+            case MSG_UART_BUTTON: uart_button = msg.arg; break;
+            case MSG_SEED:
+                pending_seed = msg.value;
+                has_pending_seed = true;
+                break;
+            case MSG_RESET: simon_init(); break;
+        }
     }
-}
\ No newline at end of file
+}
+
+void simon_task(void) {
+#if SIMON_PROFILE_DISPATCH
+    uint16_t start = TCB0.CNT;
+#endif
+    receive_messages();
+    if (entry_pending) {
+        entry_pending = false;
+        TRACE(TRACE_STATE, state);
+        HEALTH_STATE(state);
+        HEALTH_BUSY();
+        state_table[state].entry();
+    } else {
+        uint8_t event = next_event(state_table[state].events);
+        if (event) {
+            HEALTH_BUSY();
+            state_table[state].on_event(event);
+        }
+    }
+    // Button edges only count for the pass they arrive in, except the
+    // release of a press AWAITING_INPUT just took in the same pass, which
+    // HANDLE_INPUT still has to see
+    pressed_pins = 0;
+    released_pins &= (state == HANDLE_INPUT && !pb_released) ? PIN4_bm << (pb_current - 1) : 0;
+#if SIMON_PROFILE_DISPATCH
+    profile_dispatch(start);
+#endif
+}
@@ -10,10 +10,10 @@ void spi_init(void){
     
     // Set up SPI pins as outputs
     PORTC.DIRSET = PIN0_bm | PIN2_bm; // PC0=SCK, PC2=MOSI
-    PORTA.DIRSET = PIN1_bm;           // PA1=DISP LATCH
-    
-    // Initialize DISP LATCH high
+
+    // DISP LATCH high before it becomes an output, so it never pulses low
     PORTA.OUTSET = PIN1_bm;
+    PORTA.DIRSET = PIN1_bm;           // PA1=DISP LATCH
 
     // Configure SPI:
     // - Master mode
@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include "stackmon.h"
+#include "uart.h"
+
+#if STACK_MONITOR
+
+// End of .data/.bss/.noinit, from the linker script
+extern uint8_t __heap_start;
+
+// ----------------------  PAINTING  ----------------------
+
+// Runs from .init3, after the stack pointer and zero register are set up
+// and before .data/.bss are initialised. Nothing is on the stack yet, so
+// everything from __heap_start to RAMEND can be painted.
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+void stack_paint(void)
+{
+    uint8_t *p = &__heap_start;
+    while (p <= (uint8_t *)RAMEND)
+        *p++ = STACK_PAINT;
+}
+
+// ----------------------  QUERY  ----------------------
+
+uint16_t stack_unused(void)
+{
+    const uint8_t *p = &__heap_start;
+    while (p <= (uint8_t *)RAMEND && *p == STACK_PAINT)
+        p++;
+    return p - &__heap_start;
+}
+
+void stack_print_usage(void)
+{
+    uint16_t data = (uint16_t)&__heap_start - RAMSTART;
+    uint16_t unused = stack_unused();
+    uint16_t peak = (RAMEND + 1 - (uint16_t)&__heap_start) - unused;
+
+    uart_send_str("STACK ");
+    uart_putnum(data);
+    uart_send(' ');
+    uart_putnum(peak);
+    uart_send(' ');
+    uart_putnum(unused);
+    uart_send('\n');
+}
+
+#endif
@@ -3,80 +3,173 @@
 #include "timer.h"
 #include "display.h"
 #include "button.h"
-#include "spi.h"
-#include "uart.h"
-#include "adc.h"
-#include "buzzer.h"
+#include "snapshot.h"
 
-volatile uint8_t pb_debounced_state = 0xFF;
-static uint8_t count0 = 0;
-static uint8_t count1 = 0;
+// ----------------------  TIMEBASE  ----------------------
+// TCB0 divides CLK_PER into milliseconds (3333 counts of 0.3us) and raises
+// no interrupt; EVSYS channel 0 carries each wrap to TCB1, which counts
+// milliseconds and raises CAPT every TICK_MS for the debounce and display
+// tick. That tick also counts the periods, so the time since timer_init()
+// is read from the period count, TCB1.CNT and TCB0.CNT together.
 
-// Timing variables for general use
-volatile uint16_t elapsed_time_in_milliseconds = 0;
-volatile uint16_t playback_delay = 250; // Default playback delay in milliseconds
-// Add a timer for UART input timeouts
-volatile uint32_t uart_input_timer = 0;
+#define TIMEBASE_TOP (3333 - 1)
+#define TICK_MS 5
+
+// TICK_MS periods; written by the tick ISR only
+static volatile uint32_t tick_count = 0;
+static snapshot_seq_t tick_seq = 0;
+// Start of the current delay (main loop only)
+static uint32_t delay_start_ms = 0;
 
 // ----------------------  INITIALISATION  -------------------------------
 void timer_init(void)
 {
-    // Initialize TCB0 for 1ms general timing if available
-    // Used for the Simon game timing requirements
-    // TCB0: 1ms interrupt for millisecond timing
-    // At 3.333MHz: 1ms = 3,333 cycles
-
-    TCB0.CTRLB = TCB_CNTMODE_INT_gc;  // Configure TCB0 in periodic interrupt mode
-    TCB0.CCMP = 3333 - 1;
-    TCB0.INTCTRL = TCB_CAPT_bm;
+    // TCB0: 1ms periods at 3.333MHz, no interrupt
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc;  // Periodic mode: restarts after CCMP
+    TCB0.CCMP = TIMEBASE_TOP;
+
+    // TCB0's CAPT event (each wrap) clocks TCB1
+    EVSYS.CHANNEL0 = EVSYS_CHANNEL0_TCB0_CAPT_gc;
+    EVSYS.USERTCB1COUNT = EVSYS_USER_CHANNEL0_gc;
+
+    // TCB1: counts milliseconds, CAPT interrupt every 5 for button
+    // debouncing and display multiplexing
+    TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB1.CCMP = TICK_MS - 1;
+    TCB1.INTCTRL = TCB_CAPT_bm;
+    TCB1.CTRLA = TCB_CLKSEL_EVENT_gc | TCB_ENABLE_bm;
+
+    // Last, so TCB1 sees every wrap
     TCB0.CTRLA = TCB_ENABLE_bm;
 
-    // TCB1: 5ms interrupt for button debouncing and display multiplexing
-    // At 3.333MHz: 5ms = 16,665 cycles (using 16667 for slight over-sampling)
-    
-    TCB1.CTRLB = TCB_CNTMODE_INT_gc;  // Configure TCB1 in periodic interrupt mode
-    // Set interval for 5ms (-1 because counter starts at 0)
-    TCB1.CCMP = 16667 - 1;            
-    TCB1.INTCTRL = TCB_CAPT_bm;       // Enable CAPT interrupt
-    TCB1.CTRLA = TCB_ENABLE_bm;       // Enable timer
+    // RTC wraps, for rtc_count32(); the RTC itself is started by
+    // boot_start() or sched_init()
+    RTC.INTCTRL = RTC_OVF_bm;
+}
+
+// ----------------------  READING  ----------------------
+
+// TCB0 may wrap between the two reads, and at TOP its wrap event may or may
+// not have reached TCB1 yet; read again in either case (a few cycles).
+// TCB0.CNT is read through the TEMP latch shared by all 16-bit registers.
+// The input and USART ISRs take timestamps too, so one that runs between
+// the two byte reads would leave a high byte from its own read: interrupts
+// are held off for those two bytes.
+static void read_counters(uint8_t *ms_cnt, uint16_t *cnt)
+{
+    do {
+        *ms_cnt = TCB1.CNT;
+        uint8_t sreg = SREG;
+        cli();
+        *cnt = TCB0.CNT;
+        SREG = sreg;
+    } while (*ms_cnt != TCB1.CNT || *cnt == TIMEBASE_TOP);
+}
+
+// Milliseconds since timer_init(), and the TCB0 count within the current one
+static uint32_t timebase_read(uint16_t *cnt)
+{
+    uint32_t ticks;
+    uint8_t ms_cnt;
+    uint8_t begin;
+    do {
+        begin = snapshot_begin(&tick_seq);
+        SNAPSHOT_COPY(ticks, tick_count);
+        read_counters(&ms_cnt, cnt);
+        // Raised but not taken: read from an ISR or with interrupts off.
+        // Read the counters again, they may have moved on before the flag.
+        if (TCB1.INTFLAGS & TCB_CAPT_bm) {
+            ticks++;
+            read_counters(&ms_cnt, cnt);
+        }
+    } while (snapshot_retry(&tick_seq, begin));
+    // CAPT is raised as TCB1 reaches CCMP, one millisecond before it
+    // restarts: the tick has been counted by the time CNT is TICK_MS - 1
+    return ticks * TICK_MS + (uint8_t)((ms_cnt + 1) % TICK_MS) - 1;
 }
+
 // ----------------------  DELAY RESET  --------------------------------
 void prepare_delay(void)
 {
-    elapsed_time_in_milliseconds = 0; // Reset the elapsed time counter
+    delay_start_ms = timer_millis();
 }
 
-// ----------------------  1ms TIMER INTERRUPT  ------------------------
+// Milliseconds since the last prepare_delay()
+uint16_t timer_elapsed_ms(void)
+{
+    return (uint16_t)(timer_millis() - delay_start_ms);
+}
 
-ISR(TCB0_INT_vect)
+// Milliseconds since power-on
+uint32_t timer_millis(void)
 {
-    // Increment the elapsed time counter
-    elapsed_time_in_milliseconds++;
-    // Increment the UART input timer for name entry and other UART timeouts
-    uart_input_timer++;
-    // Update the frequency of the buzzer to the current_freq only if a tone is playing
-    // Removed automatic frequency update from timer ISR to prevent race conditions
-    // Frequency updates are now handled directly in the UART ISR and buzzer functions
-    
-    // Clear interrupt flags
-    TCB0.INTFLAGS = TCB_CAPT_bm; 
+    uint16_t cnt;
+    return timebase_read(&cnt);
+}
+
+// ----------------------  MICROSECOND TIMESTAMP  ----------------------
+// Microseconds since power-on (wraps after ~71 minutes)
+uint32_t timer_micros(void)
+{
+    uint16_t cnt;
+    uint32_t ms = timebase_read(&cnt);
+    // 3333 counts per ms, so 0.3us per count
+    return ms * 1000 + (uint16_t)(cnt * 3) / 10;
+}
+
+// ----------------------  RTC  ----------------------
+// The RTC (32.768kHz, ~31us) is the scheduler's clock. Its count wraps
+// every 2s; the overflow interrupt counts the wraps for timestamps that
+// must not (trace records).
+
+// RTC wraps; written by the overflow ISR only
+static volatile uint16_t rtc_wraps = 0;
+
+// RTC.CNT goes through the 16-bit TEMP latch, like TCB0.CNT above
+uint16_t rtc_count(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t cnt = RTC.CNT;
+    SREG = sreg;
+    return cnt;
+}
+
+uint32_t rtc_count32(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t wraps = rtc_wraps;
+    uint16_t cnt = RTC.CNT;
+    // Wrapped but not counted yet: read from an ISR, or the wrap came
+    // after cli(). Read the count again, it may be from before the wrap.
+    if (RTC.INTFLAGS & RTC_OVF_bm) {
+        wraps++;
+        cnt = RTC.CNT;
+    }
+    SREG = sreg;
+    return (uint32_t)wraps << 16 | cnt;
+}
+
+ISR(RTC_CNT_vect)
+{
+    rtc_wraps++;
+    RTC.INTFLAGS = RTC_OVF_bm;
 }
 
 // ----------------------  PUSH BUTTON HANDLING  ----------------------
 
-// TCB1 ISR - Handles button debouncing and display multiplexing every 5ms
+// TCB1 ISR - Handles button debouncing and display multiplexing every 5ms,
+// and counts the timebase's periods
 ISR(TCB1_INT_vect)
-{    // Button debouncing logic
-    uint8_t pb_sample = PORTA.IN;
-    uint8_t pb_changed = pb_sample ^ pb_debounced_state;
-    
-    // Two-step debouncing algorithm
-    count1 = (count1 ^ count0) & pb_changed;
-    count0 = ~count0 & pb_changed;
-    pb_debounced_state ^= (count1 & count0);    
+{
+    // Button debouncing
+    button_debounce_tick();
     // Update display
     swap_display_digit();
-    
-    // Clear interrupt flag
+
+    // Timestamps taken above see the flag and count this tick as pending
+    tick_count++;
+    SNAPSHOT_PUBLISH(tick_seq);
     TCB1.INTFLAGS = TCB_CAPT_bm;
-}
\ No newline at end of file
+}
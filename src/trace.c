@@ -0,0 +1,76 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "trace.h"
+#include "uart.h"
+#include "flags.h"
+#include "timer.h"
+
+#if TRACE_ENABLE
+
+#if TRACE_SIZE & (TRACE_SIZE - 1)
+#error "TRACE_SIZE must be a power of two"
+#endif
+
+static trace_record_t trace_ring[TRACE_SIZE];
+static uint8_t trace_head = 0;   // Next slot to write
+static uint8_t trace_count = 0;  // Valid records, up to TRACE_SIZE
+static uint8_t dump_count;       // Records in the dump in progress
+static uint8_t dump_index;       // Its next record
+
+// ----------------------  LOGGING  ----------------------
+
+// Safe from ISRs and the main loop; interrupts are held off only for the
+// slot write and the RTC read
+void trace_log(uint8_t type, uint8_t arg)
+{
+    uint8_t sreg = SREG;
+    cli();
+    if (!FLAG_TEST(FLAG_TRACE_PAUSED)) {
+        trace_record_t *r = &trace_ring[trace_head];
+        r->time = rtc_count32();
+        r->type = type;
+        r->arg = arg;
+        trace_head = (trace_head + 1) & (TRACE_SIZE - 1);
+        if (trace_count < TRACE_SIZE)
+            trace_count++;
+    }
+    SREG = sreg;
+}
+
+// ----------------------  DUMP  ----------------------
+
+// Print the ring oldest first, one "<rtc> <type> <arg>" line per record,
+// between "TRACE <count>" and "END" lines (see tools/trace2json.py).
+// Logging stays paused from the first line to the last.
+bool trace_dump(uint8_t line)
+{
+    if (line == 0) {
+        uint8_t sreg = SREG;
+        cli();
+        FLAG_SET(FLAG_TRACE_PAUSED);
+        dump_count = trace_count;
+        dump_index = (trace_head - dump_count) & (TRACE_SIZE - 1);
+        SREG = sreg;
+
+        uart_send_str("TRACE ");
+        uart_putnum(dump_count);
+        uart_send('\n');
+        return true;
+    }
+    if (line <= dump_count) {
+        trace_record_t *r = &trace_ring[dump_index];
+        uart_putnum32(r->time);
+        uart_send(' ');
+        uart_putnum(r->type);
+        uart_send(' ');
+        uart_putnum(r->arg);
+        uart_send('\n');
+        dump_index = (dump_index + 1) & (TRACE_SIZE - 1);
+        return true;
+    }
+    uart_send_str("END\n");
+    FLAG_CLEAR(FLAG_TRACE_PAUSED);
+    return false;
+}
+
+#endif
@@ -1,11 +1,17 @@
 #include <avr/interrupt.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <avr/io.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "timer.h"
-#include "buzzer.h"
-#include "simon.h"
+#include "trace.h"
+#include "bus.h"
+#include "record.h"
+#include "flags.h"
+#include "health.h"
+#include "gamestate.h"
+#include "link.h"
+#include "uart.h"
 
 // ----------------------  INITIALISATION  ----------------------
 
@@ -19,10 +25,56 @@ void uart_init(void) {
 
 // ----------------------  UART SEND FUNCTIONS  ----------------------
 
-void uart_send(char c) {
-    // Send character over UART (polling)
-    while (!(USART0.STATUS & USART_DREIF_bm)); // Wait for TXDATA empty
+#if UART_TX_SIZE & (UART_TX_SIZE - 1) || UART_TX_SIZE > 128
+#error "UART_TX_SIZE must be a power of two, up to 128"
+#endif
+
+// Characters waiting for TXDATA, drained by uart_tx_task() (TASK_UART_TX)
+static char tx_queue[UART_TX_SIZE];
+static uint8_t tx_tail = 0;  // Oldest queued character
+static uint8_t tx_count = 0;
+static bool tx_started = false;  // TXCIF is only meaningful after the first write
+
+// TXCIF is cleared as each character is written, so it is set only once
+// the last one has left the shift register
+static void tx_write(char c) {
+    USART0.STATUS = USART_TXCIF_bm;
     USART0.TXDATAL = c;
+    tx_started = true;
+}
+
+void uart_tx_task(void) {
+    while (tx_count && (USART0.STATUS & USART_DREIF_bm)) {
+        tx_write(tx_queue[tx_tail]);
+        tx_tail = (tx_tail + 1) & (UART_TX_SIZE - 1);
+        tx_count--;
+    }
+}
+
+bool uart_tx_idle(void) {
+    return tx_count == 0;
+}
+
+uint8_t uart_tx_room(void) {
+    return UART_TX_SIZE - tx_count;
+}
+
+bool uart_tx_done(void) {
+    return tx_count == 0 && (!tx_started || (USART0.STATUS & USART_TXCIF_bm));
+}
+
+void uart_send(char c) {
+    HEALTH_BUSY();
+    // Straight to TXDATA if it is free and nothing is queued ahead
+    if (!tx_count && (USART0.STATUS & USART_DREIF_bm)) {
+        tx_write(c);
+        return;
+    }
+    // Queue full: wait for a character to go out, as before the queue
+    while (tx_count == UART_TX_SIZE)
+        uart_tx_task();
+    tx_queue[(tx_tail + tx_count) & (UART_TX_SIZE - 1)] = c;
+    tx_count++;
 }
 // Helper functions to help debugging
 void uart_puts(const char *str) {
@@ -37,6 +89,12 @@ void uart_putnum(uint16_t num) {
     uart_puts(buf);
 }
 
+void uart_putnum32(uint32_t num) {
+    char buf[11];
+    ultoa(num, buf, 10);
+    uart_puts(buf);
+}
+
 // Helper for compatibility with simon.c
 void uart_send_str(const char* str) {
     uart_puts(str);
@@ -44,39 +102,19 @@ void uart_send_str(const char* str) {
 
 // ----------------------  MAIN UART LOGIC  ----------------------
 
-// Base frequencies for student number 32
-#define BASE_FREQ_EHIGH 324 // S1
-#define BASE_FREQ_CSHARP 272 // S2
-#define BASE_FREQ_A 432 // S3
-#define BASE_FREQ_ELOW 162 // S4
-
-// Current frequencies
-volatile uint16_t current_freq_ehigh = BASE_FREQ_EHIGH;
-volatile uint16_t current_freq_csharp = BASE_FREQ_CSHARP;
-volatile uint16_t current_freq_a = BASE_FREQ_A;
-volatile uint16_t current_freq_elow = BASE_FREQ_ELOW;
-
 // State tracking
 typedef enum
 {
     AWAITING_COMMAND,
-    AWAITING_SEED
+    AWAITING_SEED,
+    AWAITING_STATE   // 'Y': game state blob in hex, up to a newline
 } Serial_State;
 
-volatile uint8_t uart_play = 0;
-volatile uint8_t uart_stop = 0;
-volatile uint8_t uart_reset = 0;
-volatile uint32_t new_uart_seed = 0;
-// Pending seed update from UART
-volatile uint32_t has_pending_uart_seed = 0;
-volatile uint8_t update_seed = 0;
-
 // Name entry buffer for characters not processed by game commands
 #define NAME_ENTRY_BUFFER_SIZE 32
-volatile char name_entry_char_buffer[NAME_ENTRY_BUFFER_SIZE];
-volatile uint8_t name_entry_buffer_head = 0;
-volatile uint8_t name_entry_buffer_tail = 0;
-volatile uint8_t name_entry_mode = 0; // 1 when in name entry mode
+static volatile char name_entry_char_buffer[NAME_ENTRY_BUFFER_SIZE];
+static volatile uint8_t name_entry_buffer_head = 0;
+static volatile uint8_t name_entry_buffer_tail = 0;
 
 // Forward declarations for state preservation functions
 void save_uart_state(void);
@@ -103,95 +141,19 @@ void uart_enable_name_entry(void) {
     // Save current UART state if we're in the middle of seed entry
     save_uart_state();
     
-    name_entry_mode = 1;
+    FLAG_SET(FLAG_NAME_ENTRY);
     name_entry_buffer_head = 0;
     name_entry_buffer_tail = 0;
 }
 
 // Disable name entry mode - UART input processes game commands normally
 void uart_disable_name_entry(void) {
-    name_entry_mode = 0;
+    FLAG_CLEAR(FLAG_NAME_ENTRY);
     
     // Restore UART state if we were in the middle of seed entry
     restore_uart_state();
 }
 
-// Frequency management functions
-static void increase_frequencies(void){
-    // Check if any frequency would exceed 20kHz
-    if (current_freq_ehigh > 10000 || current_freq_csharp > 10000 ||
-        current_freq_a > 10000 || current_freq_elow > 10000)
-    {
-        return;
-    }
-
-    // Double all frequencies
-    current_freq_ehigh = current_freq_ehigh << 1;
-    current_freq_csharp = current_freq_csharp << 1;
-    current_freq_a = current_freq_a << 1;
-    current_freq_elow = current_freq_elow << 1;
-}
-
-static void decrease_frequencies(void){
-    // Check if any frequency would go below 20Hz
-    if (current_freq_ehigh < 40 || current_freq_csharp < 40 ||
-        current_freq_a < 40 || current_freq_elow < 40)
-    {
-        return;
-    }
-
-    // Halve all frequencies
-    current_freq_ehigh = current_freq_ehigh >> 1;
-    current_freq_csharp = current_freq_csharp >> 1;
-    current_freq_a = current_freq_a >> 1;
-    current_freq_elow = current_freq_elow >> 1;
-}
-
-static void update_buzzer_frequencies(void){
-    // Update the buzzer frequency based on the current button being played
-    extern uint8_t current_button_playing;
-    extern volatile uint16_t current_freq;
-    
-    // Only update if a tone is currently playing
-    if (current_button_playing == 0) return;
-    
-    uint16_t new_freq = 0;
-    switch(current_button_playing) {
-        case 1:
-            new_freq = current_freq_ehigh;
-            break;
-        case 2:
-            new_freq = current_freq_csharp;
-            break;
-        case 3:
-            new_freq = current_freq_a;
-            break;
-        case 4:
-            new_freq = current_freq_elow;
-            break;
-        default:
-            return; // No valid button
-    }    // Update the frequency if it's different
-    if (new_freq != current_freq && new_freq > 0) {
-        current_freq = new_freq;
-        // Account for DIV2 prescaler: effective clock = F_CPU/2
-        uint32_t period = (F_CPU/2) / new_freq;
-        
-        // Clamp period to 16-bit range since TCA0 registers are 16-bit
-        if (period > 0xFFFF) period = 0xFFFF;
-        
-        TCA0.SINGLE.PERBUF = period;
-        TCA0.SINGLE.CMP0BUF = period >> 1;  // 50% duty cycle
-    }
-}
-
-static void reset_frequencies(void){
-    current_freq_ehigh = BASE_FREQ_EHIGH;
-    current_freq_csharp = BASE_FREQ_CSHARP;
-    current_freq_a = BASE_FREQ_A;
-    current_freq_elow = BASE_FREQ_ELOW;
-}
-
 static uint8_t hexchar_to_int(char c){
     if ('0' <= c && c <= '9')
         return c - '0';
@@ -201,9 +163,6 @@ static uint8_t hexchar_to_int(char c){
         return 16; // Invalid - only lowercase hex allowed per PDF requirements
 }
 
-// UART button flag for simon_task
-volatile uint8_t uart_button_flag = 0;
-
 // UART state variables (moved outside ISR for state preservation)
 static Serial_State SERIAL_STATE = AWAITING_COMMAND;
 static uint8_t chars_received = 0;
@@ -216,12 +175,30 @@ static uint8_t saved_chars_received = 0;
 static uint32_t saved_seed_value = 0;
 static uint8_t saved_seed_invalid = 0;
 
+static void console_rx(char rx_data);
+
 ISR(USART0_RXC_vect)
 {
     char rx_data = USART0.RXDATAL;
+#if LINK_ENABLE
+    // Frames from the other board, timestamped here and left out of a
+    // recording, which replays console input only
+    uint8_t link = link_rx_byte(rx_data);
+    if (link & LINK_RX_MARK)
+        console_rx(LINK_MARK);
+    if (link & LINK_RX_TAKEN)
+        return;
+#endif
+    console_rx(rx_data);
+}
+
+// A byte typed on the console
+static void console_rx(char rx_data)
+{
+    RECORD(RECORD_UART, (uint8_t)rx_data);
 
     // If in name entry mode, buffer the character instead of processing commands
-    if (name_entry_mode) {
+    if (FLAG_TEST(FLAG_NAME_ENTRY)) {
         uint8_t next_head = (name_entry_buffer_head + 1) % NAME_ENTRY_BUFFER_SIZE;
         if (next_head != name_entry_buffer_tail) { // Buffer not full
             name_entry_char_buffer[name_entry_buffer_head] = rx_data;
@@ -233,38 +210,31 @@ ISR(USART0_RXC_vect)
     switch (SERIAL_STATE)
     {
     case AWAITING_COMMAND:
+        TRACE(TRACE_UART_CMD, rx_data);
         // Gameplay inputs - each key maps to the corresponding tone (0-3)
         if (rx_data == '1' || rx_data == 'q') {
-            uart_button_flag = 1;
+            bus_post(BUS_GAME, MSG_UART_BUTTON, 1);
         }
         else if (rx_data == '2' || rx_data == 'w') {
-            uart_button_flag = 2;
+            bus_post(BUS_GAME, MSG_UART_BUTTON, 2);
         }
         else if (rx_data == '3' || rx_data == 'e') {
-            uart_button_flag = 3;
+            bus_post(BUS_GAME, MSG_UART_BUTTON, 3);
         }
         else if (rx_data == '4' || rx_data == 'r') {
-            uart_button_flag = 4;
+            bus_post(BUS_GAME, MSG_UART_BUTTON, 4);
         }        // Frequency control
         else if (rx_data == ',' || rx_data == 'k') {
-            increase_frequencies();
-            update_buzzer_frequencies();
-            // If a tone is currently playing from buzzer.c, update it too
-            extern void update_current_tone_frequency(void);
-            update_current_tone_frequency();
+            bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_UP);
         }
         else if (rx_data == '.' || rx_data == 'l') {
-            decrease_frequencies();
-            update_buzzer_frequencies();
-            // If a tone is currently playing from buzzer.c, update it too
-            extern void update_current_tone_frequency(void);
-            update_current_tone_frequency();
+            bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_DOWN);
         }
         // Reset and seed
         else if (rx_data == '0' || rx_data == 'p')
         {
-            reset_frequencies();
-            uart_reset = 1;
+            bus_post(BUS_AUDIO, MSG_TRANSPOSE, TRANSPOSE_RESET);
+            bus_post(BUS_GAME, MSG_RESET, 0);
         }        else if (rx_data == '9' || rx_data == 'o')
         {
             chars_received = 0;
@@ -272,9 +242,27 @@ ISR(USART0_RXC_vect)
             seed_invalid = 0;
             SERIAL_STATE = AWAITING_SEED;
         }
-        // Add UART command to print high scores (e.g. 'h')
-        else if (rx_data == 'h') {
-            uart_print_high_scores();
+#if GAMESTATE_ENABLE
+        // Ignored while the last blob has not been applied yet
+        else if (rx_data == 'Y' && gamestate_rx_begin()) {
+            chars_received = 0;
+            seed_value = 0;
+            seed_invalid = 0;
+            SERIAL_STATE = AWAITING_STATE;
+        }
+#endif
+        // Reports, printed from the main loop: 'h' high scores, and the
+        // diagnostics 'L' press-to-tone latency, 'C' dispatch cycles,
+        // 'T' event trace dump, 'S' stack usage; 'R' starts/stops recording,
+        // 'Z' toggles turbo tempo and 'z' reports its counters, 'B' boot times,
+        // 'X' the game state, 'K' task timing, 'H' main loop health,
+        // 'M' toggles health frames, 'V' starts/ends a linked match and 'v'
+        // reports its clock sync
+        else if (rx_data == 'h' || rx_data == 'L' || rx_data == 'C' || rx_data == 'T' ||
+                 rx_data == 'S' || rx_data == 'R' || rx_data == 'Z' || rx_data == 'z' ||
+                 rx_data == 'B' || rx_data == 'X' || rx_data == 'K' || rx_data == 'H' ||
+                 rx_data == 'M' || rx_data == 'V' || rx_data == 'v') {
+            bus_post(BUS_REPORT, MSG_REPORT, rx_data);
         }
         break;   
         
@@ -305,9 +293,7 @@ ISR(USART0_RXC_vect)
                 // Received all 8 characters
                 if (!seed_invalid) {
                     // All characters were valid - apply the seed
-                    new_uart_seed = seed_value;
-                    update_seed = 1;
-                    has_pending_uart_seed = 1;
+                    bus_post(BUS_GAME, MSG_SEED, seed_value);
                 }
                 // Reset state regardless of validity
                 SERIAL_STATE = AWAITING_COMMAND;
@@ -318,6 +304,31 @@ ISR(USART0_RXC_vect)
         }
         break;
 
+#if GAMESTATE_ENABLE
+    case AWAITING_STATE:
+        // Two hex characters per byte; seed_value holds the first of a pair
+        if (rx_data == '\n' || rx_data == '\r') {
+            gamestate_rx_end(!seed_invalid && !(chars_received & 1));
+            SERIAL_STATE = AWAITING_COMMAND;
+            chars_received = 0;
+            seed_value = 0;
+            seed_invalid = 0;
+            return;
+        }
+        {
+            uint8_t nibble = hexchar_to_int(rx_data);
+            if (nibble == 16) {
+                seed_invalid = 1;
+                nibble = 0;
+            }
+            seed_value = (seed_value << 4) | nibble;
+            if (++chars_received & 1) break;
+            gamestate_rx_byte((uint8_t)seed_value);
+            seed_value = 0;
+        }
+        break;
+#endif
+
     default:
         SERIAL_STATE = AWAITING_COMMAND;
         break;
@@ -0,0 +1,1169 @@
+#!/usr/bin/env python3
+"""Cycle-counting AVRxt instruction-set simulator for the ATtiny1626.
+
+Used by cycle_bench.py; also runnable on its own:
+
+    avrsim.py firmware.elf [--cycles N] [--uart "9deadbeef"] [--pot 0]
+    avrsim.py --listing firmware_disasm.txt ...
+
+Loads an ELF (or an objdump -d listing such as firmware_disasm.txt, which
+has no .data/.rodata contents), runs from reset and prints what the firmware
+sends over USART0.
+
+Timing follows the AVRxt column of the AVR Instruction Set Manual: LD/LDD 2,
+LDS 3, ST/STD 1, STS 2, PUSH 1, POP 2, RCALL/ICALL 2, CALL 3, RET/RETI 4,
+LPM 3, branches 1/2, skips 1/2/3. Loads through the NVM controller (mapped
+flash, EEPROM) take one extra cycle, the documented minimum. Interrupts take
+3 cycles to respond (PC pushed) before the vector's JMP executes, and the
+global I bit is not cleared: CPUINT's LVL0EX flag blocks nesting until RETI.
+Function hooks run on a CALL, RCALL or ICALL to the function and also on a
+jump to it, as the compiler makes tail calls (through a handler table too).
+
+Peripherals are modelled as far as the firmware depends on them:
+  TCB0/TCB1  periodic interrupt mode (DIV1/DIV2), CNT follows the cycle count;
+             a TCB clocked by events counts TCB0's wraps when an EVSYS
+             channel carries TCB0's CAPT to its COUNT input
+  RTC        CNT follows the cycle count at 32.768kHz / PRESCALER while RTCEN
+             is set; OVF is raised as it wraps past PER
+  USART0     RX injection (one character per frame time at the set BAUD);
+             TX capture, each character a frame in the shift register with
+             one waiting in TXDATA, so DREIF and TXCIF follow the line
+  SPI0       transfer complete IF a byte time after each DATA write
+  PORTA      IN from set_pins(), pin change flags per PINnCTRL.ISC
+  ADC0       conversions complete immediately with a settable result
+  NVMCTRL    never busy; EEPROM writes land immediately; EEREADY level IRQ
+The TCB and RTC counts are read through TEMP: reading the low byte latches
+the high byte. Other I/O registers, GPIOR0-3 among them, read back what was
+written.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+# ----------------------  ATTINY1626  ----------------------
+
+F_CPU = 3_333_333
+FLASH_SIZE = 16384
+MAPPED_FLASH = 0x8000
+EEPROM_START = 0x1400
+EEPROM_SIZE = 256
+RAMSTART = 0x3800
+RAMEND = 0x3FFF
+IO_END = 0x1400  # I/O and NVM registers below this
+
+SREG_ADDR = 0x3F
+SPL_ADDR = 0x3D
+SPH_ADDR = 0x3E
+
+# Vector numbers (iotn1626.h)
+VECTORS = {
+    1: "CRCSCAN_NMI", 2: "BOD_VLM", 3: "RTC_CNT", 4: "RTC_PIT", 5: "CCL_CCL",
+    6: "PORTA_PORT", 7: "PORTB_PORT", 8: "TCA0_OVF", 9: "TCA0_HUNF",
+    10: "TCA0_CMP0", 11: "TCA0_CMP1", 12: "TCA0_CMP2", 13: "TCB0_INT",
+    14: "TWI0_TWIS", 15: "TWI0_TWIM", 16: "SPI0_INT", 17: "USART0_RXC",
+    18: "USART0_DRE", 19: "USART0_TXC", 20: "AC0_AC", 21: "ADC0_ERROR",
+    22: "ADC0_RESRDY", 23: "ADC0_SAMPRDY", 24: "PORTC_PORT", 25: "TCB1_INT",
+    26: "USART1_RXC", 27: "USART1_DRE", 28: "USART1_TXC", 29: "NVMCTRL_EE",
+}
+
+VPORTA_IN = 0x0002
+PORTA = 0x0400
+PORTA_IN = PORTA + 0x08
+PORTA_INTFLAGS = PORTA + 0x09
+PORTA_PIN0CTRL = PORTA + 0x10
+RTC = 0x0140
+RTC_INTCTRL = RTC + 0x02
+RTC_INTFLAGS = RTC + 0x03
+RTC_CNT = RTC + 0x08
+RTC_PER = RTC + 0x0A
+EVSYS = 0x0180
+EVSYS_CHANNEL0 = EVSYS + 0x10
+EVSYS_USERTCB0COUNT = EVSYS + 0x31
+EVSYS_USERTCB1COUNT = EVSYS + 0x33
+EVSYS_GEN_TCB0_CAPT = 0xA0
+ADC0 = 0x0600
+ADC0_INTFLAGS = ADC0 + 0x05
+ADC0_COMMAND = ADC0 + 0x0A
+ADC0_RESULT = ADC0 + 0x10
+USART0 = 0x0800
+USART0_RXDATAL = USART0 + 0x00
+USART0_TXDATAL = USART0 + 0x02
+USART0_STATUS = USART0 + 0x04
+USART0_CTRLA = USART0 + 0x05
+USART0_BAUD = USART0 + 0x08
+SPI0 = 0x08C0
+SPI0_INTCTRL = SPI0 + 0x02
+SPI0_INTFLAGS = SPI0 + 0x03
+SPI0_DATA = SPI0 + 0x04
+TCB0 = 0x0A80
+TCB1 = 0x0A90
+NVMCTRL = 0x1000
+NVMCTRL_STATUS = NVMCTRL + 0x02
+NVMCTRL_INTCTRL = NVMCTRL + 0x03
+
+C, Z, N, V, S, H, T, I = (1 << b for b in range(8))
+
+
+class SimError(Exception):
+    pass
+
+
+# ----------------------  LOADERS  ----------------------
+
+def _add_symbol(symbols, owners, name, entry, owner):
+    """Add name -> (address, kind). Two statics of one name in different
+    files (or at different addresses of a listing) are kept as "owner:name"
+    each, and the bare name becomes (None, "ambiguous")."""
+    old = symbols.get(name)
+    if old is None:
+        symbols[name] = entry
+        owners[name] = owner
+    elif old[1] == "ambiguous":
+        symbols.setdefault("%s:%s" % (owner, name), entry)
+    elif old[0] != entry[0]:
+        symbols["%s:%s" % (owners[name], name)] = old
+        symbols["%s:%s" % (owner, name)] = entry
+        symbols[name] = (None, "ambiguous")
+
+
+def load_elf(path):
+    """Return (flash bytes, {name: (address, kind)}) from an AVR ELF.
+
+    Function addresses are in bytes; data symbols are data-space addresses.
+    A static defined in more than one file is named "file.c:name".
+    """
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise SimError("%s: not a 32-bit little-endian ELF" % path)
+    (e_phoff, e_shoff) = struct.unpack_from("<II", elf, 28)
+    (e_phentsize, e_phnum, e_shentsize, e_shnum) = struct.unpack_from("<HHHH", elf, 42)
+
+    flash = bytearray(b"\xff" * FLASH_SIZE)
+    for i in range(e_phnum):
+        p_type, p_offset, p_vaddr, p_paddr, p_filesz = struct.unpack_from(
+            "<IIIII", elf, e_phoff + i * e_phentsize)
+        # Load addresses below 0x800000 are flash (.text, .rodata, .data image)
+        if p_type != 1 or p_filesz == 0 or p_paddr >= 0x800000:
+            continue
+        if p_paddr + p_filesz > FLASH_SIZE:
+            raise SimError("segment at 0x%x does not fit in flash" % p_paddr)
+        flash[p_paddr:p_paddr + p_filesz] = elf[p_offset:p_offset + p_filesz]
+
+    symbols = {}
+    owners = {}
+    sections = [struct.unpack_from("<IIIIIIIIII", elf, e_shoff + i * e_shentsize)
+                for i in range(e_shnum)]
+    for sh in sections:
+        if sh[1] != 2:  # SHT_SYMTAB
+            continue
+        strtab = sections[sh[6]]
+        source = "global"
+        for j in range(sh[5] // 16):
+            st_name, st_value, st_size, st_info = struct.unpack_from(
+                "<IIIB", elf, sh[4] + j * 16)
+            if not st_name:
+                continue
+            end = elf.index(b"\0", strtab[4] + st_name)
+            name = elf[strtab[4] + st_name:end].decode()
+            kind = st_info & 0xF
+            owner = source if st_info >> 4 == 0 else "global"  # STB_LOCAL
+            if kind == 4:  # STT_FILE, owner of the local symbols that follow
+                source = os.path.basename(name)
+            elif kind == 2:  # STT_FUNC
+                _add_symbol(symbols, owners, name, (st_value, "func"), owner)
+            elif kind in (0, 1) and st_value >= 0x800000 and st_value < 0x810000:
+                _add_symbol(symbols, owners, name, (st_value - 0x800000, "data"), owner)
+    return bytes(flash), symbols
+
+
+def load_listing(path):
+    """Return (flash bytes, symbols) from an avr-objdump -d listing.
+
+    Only .text is in such a listing, so initialised data and constants are
+    missing; data symbol addresses are taken from the listing's comments.
+    Having no file names, statics of one name are told apart by address,
+    as "0x1a2:name".
+    """
+    with open(path, "rb") as f:
+        raw = f.read()
+    text = raw.decode("utf-16") if raw[:2] in (b"\xff\xfe", b"\xfe\xff") else raw.decode()
+    flash = bytearray(b"\xff" * FLASH_SIZE)
+    symbols = {}
+    owners = {}
+    for line in text.splitlines():
+        m = re.match(r"^([0-9a-f]{8}) <([^>]+)>:", line)
+        if m:
+            addr = int(m.group(1), 16)
+            _add_symbol(symbols, owners, m.group(2), (addr, "func"), "0x%x" % addr)
+            continue
+        m = re.match(r"^\s+([0-9a-f]+):\t((?:[0-9a-f]{2} )+)", line)
+        if m:
+            addr = int(m.group(1), 16)
+            for k, byte in enumerate(m.group(2).split()):
+                flash[addr + k] = int(byte, 16)
+        for value, name in re.findall(r"0x80([0-9a-f]{4}) <([A-Za-z_][\w.]*)>", line):
+            symbols.setdefault(name, (int(value, 16), "data"))
+    return bytes(flash), symbols
+
+
+# ----------------------  CPU  ----------------------
+
+class Avr:
+    def __init__(self, flash, symbols=None):
+        self.flash = bytes(flash)
+        self.prog = struct.unpack("<%dH" % (len(self.flash) // 2), self.flash)
+        self.symbols = symbols or {}
+        self.func_names = {}
+        for name, (addr, kind) in self.symbols.items():
+            if kind == "func":
+                self.func_names.setdefault(addr // 2, name)
+        self.decoded = [None] * len(self.prog)
+
+        self.r = [0] * 32
+        self.mem = bytearray(0x10000)
+        self.mem[EEPROM_START:EEPROM_START + EEPROM_SIZE] = b"\xff" * EEPROM_SIZE
+        self.mem[RTC_PER:RTC_PER + 2] = b"\xff\xff"
+        self.sreg = 0
+        self.sp = RAMEND
+        self.pc = 0
+        self.cycles = 0
+        self.lvl0ex = False        # Executing a level 0 interrupt
+        self.irq_hold = False      # One instruction runs after RETI
+        self.vector = 0            # Pending interrupt, 0 if none
+        self.stop_pc = None
+        self.limit = float("inf")
+
+        # Hooks: called on function entry (word address), by call or tail
+        # call, and on data writes
+        self.on_call = {}
+        self.on_write = {}
+        # Inclusive cycle profile: name -> [calls, total, min, max]
+        self.profile = None
+        self._frames = []
+
+        # Peripheral state
+        self.uart_out = bytearray()
+        self.uart_rx = []
+        self.uart_rx_next = 0
+        self.uart_rx_data = None
+        self.tx_data = None        # Waiting in TXDATA (DREIF clear)
+        self.tx_shifting = False   # A frame is in the shift register
+        self.tx_done = 0           # Cycle the frame in the shift register ends
+        self.txcif = False
+        self.pins = 0xFF
+        self.adc_result = 0
+        self.spi_done = None
+        self.tcb_start = {TCB0: 0, TCB1: 0}
+        self.rtc_start = 0
+        self.rtc_seen = 0                   # OVF raised up to this cycle
+        self.tcb_seen = {TCB0: 0, TCB1: 0}  # CAPT raised up to this cycle
+        self.temp = {}                      # TEMP latch of each 16-bit peripheral
+        self.next_event = 0
+        self._update_irq()
+
+    # ------------------  symbols  ------------------
+
+    def addr(self, name, source=None):
+        """Address of a symbol; source ("simon.c") picks a static that
+        more than one file defines."""
+        entry = self.symbols.get(name)
+        if entry and entry[1] == "ambiguous" and source:
+            entry = self.symbols.get("%s:%s" % (source, name))
+        if entry is None:
+            raise SimError("no symbol %s%s" % (name, " in %s" % source if source else ""))
+        if entry[1] == "ambiguous":
+            raise SimError("%s is defined more than once: %s" % (name, ", ".join(
+                sorted(k for k in self.symbols if k.endswith(":" + name)))))
+        return entry[0]
+
+    def name_of(self, word):
+        return self.func_names.get(word, "0x%04x" % (word * 2))
+
+    # ------------------  data space  ------------------
+
+    def read(self, a):
+        if RAMSTART <= a <= RAMEND:
+            return self.mem[a]
+        if a >= MAPPED_FLASH:
+            return self.flash[a - MAPPED_FLASH] if a - MAPPED_FLASH < len(self.flash) else 0
+        return self._io_read(a)
+
+    def write(self, a, v):
+        if RAMSTART <= a <= RAMEND:
+            self.mem[a] = v
+            if a in self.on_write:
+                self.on_write[a](a, v)
+            return
+        if a < IO_END:
+            self._io_write(a, v)
+        elif EEPROM_START <= a < EEPROM_START + EEPROM_SIZE:
+            self.mem[a] = v  # Committed at once, no erase/write command needed
+
+    def _io_read(self, a):
+        if a == SREG_ADDR:
+            return self.sreg
+        if a == SPL_ADDR:
+            return self.sp & 0xFF
+        if a == SPH_ADDR:
+            return self.sp >> 8
+        if a in (PORTA_IN, VPORTA_IN):
+            return self.pins
+        if a == USART0_STATUS:
+            return (0x20 if self.tx_data is None else 0) | (0x40 if self.txcif else 0) \
+                | (0x80 if self.uart_rx_data is not None else 0)
+        if a == USART0_RXDATAL:
+            v = self.uart_rx_data or 0
+            self.uart_rx_data = None
+            self._schedule()
+            self._update_irq()
+            return v
+        if a in (TCB0 + 0x0A, TCB1 + 0x0A, RTC_CNT):
+            base = a & ~0xF
+            cnt = self._rtc_cnt() if base == RTC else self._tcb_cnt(base)
+            self.temp[base] = cnt >> 8
+            return cnt & 0xFF
+        if a in (TCB0 + 0x0B, TCB1 + 0x0B, RTC_CNT + 1):
+            return self.temp.get(a & ~0xF, 0)
+        if a == ADC0_INTFLAGS:
+            return self.mem[a] | 0x01
+        if ADC0_RESULT <= a < ADC0_RESULT + 4:
+            return (self.adc_result >> (8 * (a - ADC0_RESULT))) & 0xFF
+        if a == NVMCTRL_STATUS:
+            return 0
+        return self.mem[a]
+
+    def _io_write(self, a, v):
+        if a == SREG_ADDR:
+            self.sreg = v
+            return
+        if a == SPL_ADDR:
+            self.sp = (self.sp & 0xFF00) | v
+            return
+        if a == SPH_ADDR:
+            self.sp = (self.sp & 0x00FF) | (v << 8)
+            return
+        if a == USART0_TXDATAL:
+            self.uart_out.append(v)
+            if self.tx_shifting:
+                self.tx_data = v
+            else:
+                self.tx_shifting = True
+                self.tx_done = self.cycles + self._uart_frame()
+                self._schedule()
+            return
+        if a == USART0_STATUS:
+            if v & 0x40:
+                self.txcif = False  # Write one to clear
+            return
+        if a == SPI0_DATA:
+            self.spi_done = self.cycles + self._spi_byte()
+            self.next_event = min(self.next_event, self.spi_done)
+            return
+        if a in (PORTA_INTFLAGS, SPI0_INTFLAGS, TCB0 + 6, TCB1 + 6, ADC0_INTFLAGS, RTC_INTFLAGS):
+            self.mem[a] &= ~v  # Write one to clear
+            self._update_irq()
+            return
+        if a in (TCB0, TCB1):
+            if (v ^ self.mem[a]) & 1:
+                self.tcb_start[a] = self.tcb_seen[a] = self.cycles
+            self.mem[a] = v
+            self._schedule()
+            return
+        if a == RTC and (v ^ self.mem[a]) & 1:
+            self.rtc_start = self.rtc_seen = self.cycles
+        if a in (TCB0 + 0x0A, TCB1 + 0x0A):
+            # Writing CNT (low byte completes a 16-bit write via TEMP)
+            self.tcb_start[a & ~0xF] = self.tcb_seen[a & ~0xF] = self.cycles
+        self.mem[a] = v
+        if a in (USART0_CTRLA, SPI0_INTCTRL, NVMCTRL_INTCTRL, TCB0 + 5, TCB1 + 5, RTC_INTCTRL) \
+                or PORTA_PIN0CTRL <= a < PORTA_PIN0CTRL + 8:
+            self._update_irq()
+        elif a in (TCB0 + 0x0C, TCB0 + 0x0D, TCB1 + 0x0C, TCB1 + 0x0D, RTC, RTC_PER, RTC_PER + 1):
+            self._schedule()
+
+    # ------------------  peripherals  ------------------
+
+    def _event_routed(self, generator, user):
+        """Whether an EVSYS channel carries generator to the user register."""
+        channel = self.mem[user]  # USER_CHANNELn_gc is n + 1, 0 is off
+        return 1 <= channel <= 6 and self.mem[EVSYS_CHANNEL0 + channel - 1] == generator
+
+    def _tcb_clock(self, base):
+        """(cycles per count, cycle CNT counts from, TOP, event-clocked) of
+        an enabled TCB, or None. An event-clocked TCB counts TCB0's wraps,
+        the only event source modelled, and stands still without them."""
+        ctrla = self.mem[base]
+        if not ctrla & 1:
+            return None
+        top = self.mem[base + 0x0C] | (self.mem[base + 0x0D] << 8)
+        clksel = (ctrla >> 1) & 7
+        if clksel != 7:
+            return (2 if clksel == 1 else 1), self.tcb_start[base], top, False
+        user = EVSYS_USERTCB0COUNT if base == TCB0 else EVSYS_USERTCB1COUNT
+        if base == TCB0 or not self._event_routed(EVSYS_GEN_TCB0_CAPT, user):
+            return None
+        src = self._tcb_clock(TCB0)
+        if not src or src[3]:
+            return None
+        per = (src[2] + 1) * src[0]
+        # Counting from the last TCB0 wrap before this TCB was enabled
+        waited = max(0, self.tcb_start[base] - src[1])
+        return per, src[1] + waited // per * per, top, True
+
+    def _tcb_cnt(self, base):
+        clock = self._tcb_clock(base)
+        if not clock:
+            return self.mem[base + 0x0A] | (self.mem[base + 0x0B] << 8)
+        per, origin, top, _ = clock
+        return max(0, self.cycles - origin) // per % (top + 1)
+
+    def _tcb_next_flag(self, base, after):
+        """First cycle later than after at which CAPT is raised, or None.
+        Counting CLK_PER, CAPT is taken to rise at the wrap; counting events
+        it rises as CNT reaches TOP, a whole event before the wrap."""
+        clock = self._tcb_clock(base)
+        if not clock:
+            return None
+        per, origin, top, event = clock
+        period = (top + 1) * per
+        first = origin + (top if event else top + 1) * per
+        if after < first:
+            return first
+        return first + ((after - first) // period + 1) * period
+
+    def _rtc_clock(self):
+        """(counts per second, PER) of the running RTC, or None."""
+        ctrla = self.mem[RTC]
+        if not ctrla & 1:
+            return None
+        return 32768 >> ((ctrla >> 3) & 0xF), self.mem[RTC_PER] | (self.mem[RTC_PER + 1] << 8)
+
+    def _rtc_cnt(self):
+        clock = self._rtc_clock()
+        if not clock:
+            return self.mem[RTC_CNT] | (self.mem[RTC_CNT + 1] << 8)
+        rate, per = clock
+        return (self.cycles - self.rtc_start) * rate // F_CPU % (per + 1)
+
+    def _rtc_next_ovf(self, after):
+        """First cycle later than after at which the RTC wraps, or None."""
+        clock = self._rtc_clock()
+        if not clock:
+            return None
+        rate, per = clock
+        wraps = (after - self.rtc_start) * rate // F_CPU // (per + 1) + 1
+        return self.rtc_start - (-wraps * (per + 1) * F_CPU // rate)
+
+    def _schedule(self):
+        """Work out when the next timed peripheral event is due."""
+        nxt = self.cycles + 1_000_000
+        for base in (TCB0, TCB1):
+            flag = self._tcb_next_flag(base, self.cycles)
+            if flag is not None:
+                nxt = min(nxt, flag)
+        ovf = self._rtc_next_ovf(self.cycles)
+        if ovf is not None:
+            nxt = min(nxt, ovf)
+        if self.tx_shifting:
+            nxt = min(nxt, self.tx_done)
+        if self.spi_done is not None:
+            nxt = min(nxt, self.spi_done)
+        if self.uart_rx and self.uart_rx_data is None:
+            nxt = min(nxt, max(self.uart_rx_next, self.cycles + 1))
+        self.next_event = min(nxt, self.limit)
+
+    def _events(self):
+        now = self.cycles
+        for base in (TCB0, TCB1):
+            flag = self._tcb_next_flag(base, self.tcb_seen[base])
+            if flag is not None and flag <= now:
+                self.mem[base + 6] |= 0x01  # CAPT
+            self.tcb_seen[base] = now
+        ovf = self._rtc_next_ovf(self.rtc_seen)
+        if ovf is not None and ovf <= now:
+            self.mem[RTC_INTFLAGS] |= 0x01  # OVF
+        self.rtc_seen = now
+        # The character waiting in TXDATA follows the one shifted out
+        while self.tx_shifting and now >= self.tx_done:
+            if self.tx_data is None:
+                self.tx_shifting = False
+                self.txcif = True
+            else:
+                self.tx_data = None
+                self.tx_done += self._uart_frame()
+        if self.spi_done is not None and now >= self.spi_done:
+            self.spi_done = None
+            self.mem[SPI0_INTFLAGS] |= 0x80
+        if self.uart_rx and now >= self.uart_rx_next and self.uart_rx_data is None:
+            self.uart_rx_data = self.uart_rx.pop(0)
+            self.uart_rx_next = now + self._uart_frame()
+        self._schedule()
+        self._update_irq()
+
+    def _spi_byte(self):
+        ctrla = self.mem[SPI0]
+        div = (4, 16, 64, 128)[(ctrla >> 1) & 3] >> (1 if ctrla & 0x10 else 0)
+        return 8 * div
+
+    def _uart_frame(self):
+        baud = self.mem[USART0_BAUD] | (self.mem[USART0_BAUD + 1] << 8)
+        # 10 bits per frame, BAUD = 64 * f_clk / (16 * rate)
+        return max(1, baud * 10 * 16 // 64)
+
+    def _update_irq(self):
+        m = self.mem
+        pending = []
+        if m[RTC_INTFLAGS] & m[RTC_INTCTRL] & 1:
+            pending.append(3)
+        if m[PORTA_INTFLAGS]:
+            pending.append(6)
+        if m[TCB0 + 6] & m[TCB0 + 5] & 1:
+            pending.append(13)
+        if m[SPI0_INTFLAGS] & 0x80 and m[SPI0_INTCTRL] & 1:
+            pending.append(16)
+        if self.uart_rx_data is not None and m[USART0_CTRLA] & 0x80:
+            pending.append(17)
+        if m[TCB1 + 6] & m[TCB1 + 5] & 1:
+            pending.append(25)
+        if m[NVMCTRL_INTCTRL] & 1:
+            pending.append(29)
+        self.vector = pending[0] if pending else 0
+
+    def uart_send(self, data, delay=0):
+        """Queue characters for USART0 RX, one per frame time."""
+        if isinstance(data, str):
+            data = data.encode()
+        if not self.uart_rx:
+            self.uart_rx_next = max(self.uart_rx_next, self.cycles + delay)
+        self.uart_rx.extend(data)
+        self._schedule()
+
+    def set_pins(self, value):
+        """Drive PORTA pins, raising pin change flags per PINnCTRL.ISC."""
+        changed = self.pins ^ value
+        for pin in range(8):
+            bit = 1 << pin
+            if not changed & bit:
+                continue
+            isc = self.mem[PORTA_PIN0CTRL + pin] & 7
+            rising = bool(value & bit)
+            if isc == 1 or (isc == 2 and rising) or (isc == 3 and not rising) \
+                    or (isc == 5 and not rising):
+                self.mem[PORTA_INTFLAGS] |= bit
+        self.pins = value
+        self._update_irq()
+
+    # ------------------  execution  ------------------
+
+    def push(self, v):
+        self.mem[self.sp] = v
+        self.sp -= 1
+
+    def pop(self):
+        self.sp += 1
+        return self.mem[self.sp]
+
+    def _enter_call(self, target):
+        if self.profile is not None:
+            self._frames.append((target, self.cycles, self.sp))
+        hook = self.on_call.get(target)
+        if hook:
+            hook(self)
+
+    def _leave(self):
+        if self.profile is not None and self._frames:
+            target, start, _ = self._frames.pop()
+            name = target if isinstance(target, str) else self.name_of(target)
+            spent = self.cycles - start
+            entry = self.profile.get(name)
+            if entry is None:
+                self.profile[name] = [1, spent, spent, spent]
+            else:
+                entry[0] += 1
+                entry[1] += spent
+                if spent < entry[2]:
+                    entry[2] = spent
+                if spent > entry[3]:
+                    entry[3] = spent
+
+    def _interrupt(self):
+        vec = self.vector
+        if self.profile is not None:
+            self._frames.append(("ISR %d %s" % (vec, VECTORS.get(vec, "?")), self.cycles, self.sp))
+        if vec == 16:
+            self.mem[SPI0_INTFLAGS] &= ~0x80  # Cleared when the vector runs
+            self._update_irq()
+        self.push(self.pc & 0xFF)
+        self.push(self.pc >> 8)
+        self.pc = vec * 2  # Two words per vector (JMP)
+        self.cycles += 3
+        self.lvl0ex = True
+
+    def run(self, max_cycles=None, until=None):
+        """Run until the cycle count reaches max_cycles, until() is true
+        (checked after each instruction) or the PC hits stop_pc."""
+        self.limit = self.cycles + max_cycles if max_cycles is not None else float("inf")
+        self._schedule()
+        decoded = self.decoded
+        stop_pc = self.stop_pc
+        while True:
+            if self.cycles >= self.next_event:
+                if self.cycles >= self.limit:
+                    return "cycles"
+                self._events()
+            if self.vector and self.sreg & I and not self.lvl0ex and not self.irq_hold:
+                self._interrupt()
+            self.irq_hold = False
+            op = decoded[self.pc]
+            if op is None:
+                op = self._decode(self.pc)
+                op = decoded[self.pc] = (op[0], op[1:])
+            op[0](*op[1])
+            if self.pc == stop_pc:
+                return "stop"
+            if until is not None and until():
+                return "until"
+
+    def call(self, func, *args, max_cycles=10_000_000, interrupts=False):
+        """Call a function with avr-gcc ABI arguments (8/16/32-bit values
+        given as (value, bytes) or plain ints treated as 8-bit); return
+        (cycles, r24:r25) including the CALL and RET."""
+        word = func if isinstance(func, int) else self.addr(func) // 2
+        reg = 26
+        for arg in args:
+            value, size = arg if isinstance(arg, tuple) else (arg, 1)
+            reg -= size + (size & 1)
+            for k in range(size):
+                self.r[reg + k] = (value >> (8 * k)) & 0xFF
+        saved = (self.sreg, self.stop_pc, self.pc)
+        if not interrupts:
+            self.sreg &= ~I
+        sentinel = len(self.prog) - 1
+        self.push(sentinel & 0xFF)
+        self.push(sentinel >> 8)
+        self.stop_pc = sentinel
+        start = self.cycles
+        self.cycles += 3  # The CALL that would have got us here
+        self.pc = word
+        self._enter_call(word)
+        if self.run(max_cycles=max_cycles) != "stop":
+            raise SimError("%s did not return within %d cycles" % (self.name_of(word), max_cycles))
+        spent = self.cycles - start
+        self.sreg = (self.sreg & ~I) | (saved[0] & I)
+        self.stop_pc, self.pc = saved[1], saved[2]
+        return spent, self.r[24] | (self.r[25] << 8)
+
+    def boot(self, max_cycles=5_000_000):
+        """Run the C runtime startup and stop at main()."""
+        main = self.addr("main") // 2
+        self.pc = 0
+        self.stop_pc = main
+        if self.run(max_cycles=max_cycles) != "stop":
+            raise SimError("startup did not reach main()")
+        self.stop_pc = None
+
+    # ------------------  decoding  ------------------
+
+    def _decode(self, pc):
+        w = self.prog[pc]
+        d5 = (w >> 4) & 0x1F
+        r5 = (w & 0xF) | ((w >> 5) & 0x10)
+        d4 = 16 + ((w >> 4) & 0xF)
+        k8 = (w & 0xF) | ((w >> 4) & 0xF0)
+        top6 = w >> 10
+        if w == 0:
+            return (self.op_nop,)
+        if top6 == 0x03:
+            return (self.op_add, d5, r5, 0)
+        if top6 == 0x07:
+            return (self.op_add, d5, r5, 1)
+        if top6 == 0x06:
+            return (self.op_sub, d5, r5, 0, True, False)
+        if top6 == 0x02:
+            return (self.op_sub, d5, r5, 1, True, False)
+        if top6 == 0x05:
+            return (self.op_sub, d5, r5, 0, False, False)
+        if top6 == 0x01:
+            return (self.op_sub, d5, r5, 1, False, False)
+        if w >> 12 == 0x3:
+            return (self.op_subi, d4, k8, 0, False)
+        if w >> 12 == 0x5:
+            return (self.op_subi, d4, k8, 0, True)
+        if w >> 12 == 0x4:
+            return (self.op_subi, d4, k8, 1, True)
+        if top6 == 0x08:
+            return (self.op_logic, d5, r5, 0)
+        if top6 == 0x0A:
+            return (self.op_logic, d5, r5, 1)
+        if top6 == 0x09:
+            return (self.op_logic, d5, r5, 2)
+        if w >> 12 == 0x7:
+            return (self.op_logici, d4, k8, 0)
+        if w >> 12 == 0x6:
+            return (self.op_logici, d4, k8, 1)
+        if top6 == 0x0B:
+            return (self.op_mov, d5, r5)
+        if w >> 12 == 0xE:
+            return (self.op_ldi, d4, k8)
+        if top6 == 0x04:
+            return (self.op_cpse, d5, r5)
+        if w >> 8 == 0x01:
+            return (self.op_movw, ((w >> 4) & 0xF) * 2, (w & 0xF) * 2)
+        if w >> 8 == 0x02:
+            return (self.op_mul, 16 + ((w >> 4) & 0xF), 16 + (w & 0xF), True, True, False)
+        if w & 0xFF88 == 0x0300:
+            return (self.op_mul, 16 + ((w >> 4) & 7), 16 + (w & 7), True, False, False)
+        if w & 0xFF88 == 0x0308:
+            return (self.op_mul, 16 + ((w >> 4) & 7), 16 + (w & 7), False, False, True)
+        if w & 0xFF88 == 0x0380:
+            return (self.op_mul, 16 + ((w >> 4) & 7), 16 + (w & 7), True, True, True)
+        if w & 0xFF88 == 0x0388:
+            return (self.op_mul, 16 + ((w >> 4) & 7), 16 + (w & 7), True, False, True)
+        if top6 == 0x27:
+            return (self.op_mul, d5, r5, False, False, False)
+        if w >> 12 == 0xC:
+            return (self.op_rjmp, self._rel12(w))
+        if w >> 12 == 0xD:
+            return (self.op_rcall, self._rel12(w))
+        if w >> 11 == 0x1E:  # BRBS/BRBC
+            k = (w >> 3) & 0x7F
+            if k & 0x40:
+                k -= 0x80
+            return (self.op_branch, 1 << (w & 7), bool((w >> 10) & 1), k)
+        if w & 0xFE0E == 0x940C:
+            k = ((((w >> 4) & 0x1F) << 1 | (w & 1)) << 16) | self.prog[pc + 1]
+            return (self.op_jmp, k)
+        if w & 0xFE0E == 0x940E:
+            k = ((((w >> 4) & 0x1F) << 1 | (w & 1)) << 16) | self.prog[pc + 1]
+            return (self.op_call, k)
+        if w == 0x9409:
+            return (self.op_ijmp,)
+        if w == 0x9509:
+            return (self.op_icall,)
+        if w == 0x9508:
+            return (self.op_ret, False)
+        if w == 0x9518:
+            return (self.op_ret, True)
+        if w & 0xFE0F == 0x9000:
+            return (self.op_lds, d5, self.prog[pc + 1])
+        if w & 0xFE0F == 0x9200:
+            return (self.op_sts, d5, self.prog[pc + 1])
+        if w & 0xFE0F == 0x900F:
+            return (self.op_pop, d5)
+        if w & 0xFE0F == 0x920F:
+            return (self.op_push, d5)
+        if w == 0x95C8:
+            return (self.op_lpm, 0, False)
+        if w & 0xFE0F == 0x9004:
+            return (self.op_lpm, d5, False)
+        if w & 0xFE0F == 0x9005:
+            return (self.op_lpm, d5, True)
+        if w & 0xFC00 == 0x9000 or w & 0xD000 == 0x8000:
+            return self._decode_ldst(w, d5)
+        if w & 0xFE00 == 0x9400:
+            low = w & 0xF
+            unary = {0: "com", 1: "neg", 2: "swap", 3: "inc", 5: "asr", 6: "lsr",
+                     7: "ror", 10: "dec"}
+            if low in unary:
+                return (self.op_unary, d5, unary[low])
+            if low == 8 and not w & 0x0100:
+                bit = 1 << ((w >> 4) & 7)
+                return (self.op_bset, bit, bool((w >> 7) & 1))
+            if w in (0x9588, 0x95A8, 0x9598):  # SLEEP, WDR, BREAK
+                return (self.op_nop,)
+        if w >> 9 == 0x4B:  # ADIW/SBIW
+            k = (w & 0xF) | ((w >> 2) & 0x30)
+            return (self.op_adiw, 24 + ((w >> 4) & 3) * 2, k, (w >> 8) & 1)
+        if w >> 10 == 0x26:  # CBI/SBI/SBIC/SBIS
+            kind = (w >> 8) & 3
+            return (self.op_bitio, (w >> 3) & 0x1F, 1 << (w & 7), kind)
+        if w >> 11 == 0x16:
+            return (self.op_in, d5, (w & 0xF) | ((w >> 5) & 0x30))
+        if w >> 11 == 0x17:
+            return (self.op_out, d5, (w & 0xF) | ((w >> 5) & 0x30))
+        if w & 0xFC08 == 0xF800:
+            return (self.op_bld_bst, d5, 1 << (w & 7), (w >> 9) & 1)
+        if w & 0xFC08 == 0xFC00:
+            return (self.op_sbrx, d5, 1 << (w & 7), (w >> 9) & 1)
+        raise SimError("unknown opcode 0x%04x at 0x%04x" % (w, pc * 2))
+
+    def decode(self, pc):
+        """(mnemonic handler name, operands, size in words) at a word address."""
+        op = self._decode(pc)
+        words = 2 if op[0] in (self.op_jmp, self.op_call, self.op_lds, self.op_sts) else 1
+        return op[0].__name__[3:], op[1:], words
+
+    @staticmethod
+    def _rel12(w):
+        k = w & 0xFFF
+        return k - 0x1000 if k & 0x800 else k
+
+    def _decode_ldst(self, w, d):
+        store = bool(w & 0x0200)
+        if w & 0xD000 == 0x8000:
+            # LDD/STD Y+q, Z+q (LD/ST Y, Z are q = 0)
+            q = (w & 7) | ((w >> 7) & 0x18) | ((w >> 8) & 0x20)
+            ptr = 28 if w & 0x08 else 30
+            return (self.op_ldst, d, ptr, 0, q, store)
+        mode = w & 0xF
+        table = {0x1: (30, 1), 0x2: (30, -1), 0x9: (28, 1), 0xA: (28, -1),
+                 0xC: (26, 0), 0xD: (26, 1), 0xE: (26, -1)}
+        if mode not in table:
+            raise SimError("unknown load/store 0x%04x" % w)
+        ptr, step = table[mode]
+        return (self.op_ldst, d, ptr, step, 0, store)
+
+    def skip_words(self):
+        """Size of the instruction after the current one (for skips)."""
+        w = self.prog[self.pc + 1]
+        return 2 if (w & 0xFE0E in (0x940C, 0x940E) or w & 0xFC0F == 0x9000) else 1
+
+    # ------------------  flags  ------------------
+
+    def _flags(self, r, mask, c=0, h=0, v=0):
+        """Set Z, N, S (and the given C/H/V) from an 8-bit result."""
+        s = self.sreg & ~mask
+        if r == 0:
+            s |= Z
+        n = r & 0x80
+        if n:
+            s |= N
+        if c:
+            s |= C
+        if h:
+            s |= H
+        if v:
+            s |= V
+        if bool(n) != bool(v):
+            s |= S
+        self.sreg = s
+
+    # ------------------  instructions  ------------------
+
+    def op_nop(self):
+        self.pc += 1
+        self.cycles += 1
+
+    def op_add(self, d, s, carry):
+        a, b = self.r[d], self.r[s]
+        c = self.sreg & C if carry else 0
+        res = a + b + c
+        r = res & 0xFF
+        self.r[d] = r
+        self._flags(r, C | Z | N | V | S | H, res > 0xFF, (a & 0xF) + (b & 0xF) + c > 0xF,
+                    (~(a ^ b) & (a ^ r)) & 0x80)
+        self.pc += 1
+        self.cycles += 1
+
+    def _subtract(self, a, b, carry, keep_z):
+        c = self.sreg & C if carry else 0
+        r = (a - b - c) & 0xFF
+        oldz = self.sreg & Z
+        self._flags(r, C | Z | N | V | S | H, b + c > a, (b & 0xF) + c > (a & 0xF),
+                    ((a ^ b) & (a ^ r)) & 0x80)
+        if keep_z and r == 0 and not oldz:
+            self.sreg &= ~Z
+        return r
+
+    def op_sub(self, d, s, carry, store, _unused):
+        r = self._subtract(self.r[d], self.r[s], carry, carry)
+        if store:
+            self.r[d] = r
+        self.pc += 1
+        self.cycles += 1
+
+    def op_subi(self, d, k, carry, store):
+        r = self._subtract(self.r[d], k, carry, carry)
+        if store:
+            self.r[d] = r
+        self.pc += 1
+        self.cycles += 1
+
+    def op_logic(self, d, s, kind):
+        a, b = self.r[d], self.r[s]
+        r = a & b if kind == 0 else a | b if kind == 1 else a ^ b
+        self.r[d] = r
+        self._flags(r, Z | N | V | S)
+        self.pc += 1
+        self.cycles += 1
+
+    def op_logici(self, d, k, kind):
+        r = self.r[d] & k if kind == 0 else self.r[d] | k
+        self.r[d] = r
+        self._flags(r, Z | N | V | S)
+        self.pc += 1
+        self.cycles += 1
+
+    def op_mov(self, d, s):
+        self.r[d] = self.r[s]
+        self.pc += 1
+        self.cycles += 1
+
+    def op_movw(self, d, s):
+        self.r[d], self.r[d + 1] = self.r[s], self.r[s + 1]
+        self.pc += 1
+        self.cycles += 1
+
+    def op_ldi(self, d, k):
+        self.r[d] = k
+        self.pc += 1
+        self.cycles += 1
+
+    def op_mul(self, d, s, d_signed, s_signed, fractional):
+        a, b = self.r[d], self.r[s]
+        if d_signed and a & 0x80:
+            a -= 0x100
+        if s_signed and b & 0x80:
+            b -= 0x100
+        p = (a * b) & 0xFFFF
+        c = p & 0x8000
+        if fractional:
+            p = (p << 1) & 0xFFFF
+        self.r[0], self.r[1] = p & 0xFF, p >> 8
+        s = self.sreg & ~(C | Z)
+        if c:
+            s |= C
+        if p == 0:
+            s |= Z
+        self.sreg = s
+        self.pc += 1
+        self.cycles += 2
+
+    def op_unary(self, d, kind):
+        a = self.r[d]
+        s = self.sreg
+        if kind == "com":
+            r = a ^ 0xFF
+            self._flags(r, C | Z | N | V | S, c=1)
+        elif kind == "neg":
+            r = (-a) & 0xFF
+            self._flags(r, C | Z | N | V | S | H, r != 0, (r | a) & 0x08, r == 0x80)
+        elif kind == "swap":
+            r = ((a << 4) | (a >> 4)) & 0xFF
+        elif kind == "inc":
+            r = (a + 1) & 0xFF
+            self._flags(r, Z | N | V | S, v=r == 0x80)
+        elif kind == "dec":
+            r = (a - 1) & 0xFF
+            self._flags(r, Z | N | V | S, v=r == 0x7F)
+        else:
+            c = a & 1
+            if kind == "asr":
+                r = (a >> 1) | (a & 0x80)
+            elif kind == "lsr":
+                r = a >> 1
+            else:
+                r = (a >> 1) | (0x80 if s & C else 0)
+            self._flags(r, C | Z | N | V | S, c, v=bool(c) != bool(r & 0x80))
+        self.r[d] = r
+        self.pc += 1
+        self.cycles += 1
+
+    def op_adiw(self, d, k, subtract):
+        a = self.r[d] | (self.r[d + 1] << 8)
+        res = a - k if subtract else a + k
+        r = res & 0xFFFF
+        self.r[d], self.r[d + 1] = r & 0xFF, r >> 8
+        if subtract:
+            v = a & ~r & 0x8000
+        else:
+            v = ~a & r & 0x8000
+        s = self.sreg & ~(C | Z | N | V | S)
+        if res < 0 or res > 0xFFFF:
+            s |= C
+        if r == 0:
+            s |= Z
+        if r & 0x8000:
+            s |= N
+        if v:
+            s |= V
+        if bool(r & 0x8000) != bool(v):
+            s |= S
+        self.sreg = s
+        self.pc += 1
+        self.cycles += 2
+
+    def op_bset(self, bit, clear):
+        if clear:
+            self.sreg &= ~bit
+        else:
+            self.sreg |= bit
+            if bit == I:
+                self.irq_hold = True  # The instruction after SEI always runs
+        self.pc += 1
+        self.cycles += 1
+
+    def op_bld_bst(self, d, bit, store):
+        if store:  # BST
+            self.sreg = (self.sreg | T) if self.r[d] & bit else (self.sreg & ~T)
+        else:
+            self.r[d] = (self.r[d] | bit) if self.sreg & T else (self.r[d] & ~bit)
+        self.pc += 1
+        self.cycles += 1
+
+    def _skip(self, taken):
+        if taken:
+            words = self.skip_words()
+            self.pc += 1 + words
+            self.cycles += 1 + words
+        else:
+            self.pc += 1
+            self.cycles += 1
+
+    def op_cpse(self, d, s):
+        self._skip(self.r[d] == self.r[s])
+
+    def op_sbrx(self, d, bit, if_set):
+        self._skip(bool(self.r[d] & bit) == bool(if_set))
+
+    def op_bitio(self, a, bit, kind):
+        if kind == 0:    # CBI
+            self.write(a, self.read(a) & ~bit)
+        elif kind == 2:  # SBI
+            self.write(a, self.read(a) | bit)
+        else:            # SBIC (1) / SBIS (3)
+            self._skip(bool(self.read(a) & bit) == (kind == 3))
+            return
+        self.pc += 1
+        self.cycles += 1
+
+    def op_in(self, d, a):
+        self.r[d] = self.read(a)
+        self.pc += 1
+        self.cycles += 1
+
+    def op_out(self, d, a):
+        self.write(a, self.r[d])
+        self.pc += 1
+        self.cycles += 1
+
+    def op_branch(self, bit, if_clear, k):
+        if bool(self.sreg & bit) != if_clear:
+            self.pc += 1 + k
+            self.cycles += 2
+        else:
+            self.pc += 1
+            self.cycles += 1
+
+    # A jump to a hooked function is a tail call: it still enters the
+    # function, though the profile counts it in its caller
+
+    def op_rjmp(self, k):
+        self.pc += 1 + k
+        self.cycles += 2
+        if self.pc in self.on_call:
+            self.on_call[self.pc](self)
+
+    def op_jmp(self, k):
+        self.pc = k
+        self.cycles += 3
+        if k in self.on_call:
+            self.on_call[k](self)
+
+    def op_ijmp(self):
+        self.pc = self.r[30] | (self.r[31] << 8)
+        self.cycles += 2
+        if self.pc in self.on_call:
+            self.on_call[self.pc](self)
+
+    def _call(self, ret, target, cycles):
+        self.push(ret & 0xFF)
+        self.push(ret >> 8)
+        self.cycles += cycles
+        self.pc = target
+        self._enter_call(target)
+
+    def op_rcall(self, k):
+        self._call(self.pc + 1, self.pc + 1 + k, 2)
+
+    def op_call(self, k):
+        self._call(self.pc + 2, k, 3)
+
+    def op_icall(self):
+        self._call(self.pc + 1, self.r[30] | (self.r[31] << 8), 2)
+
+    def op_ret(self, reti):
+        hi = self.pop()
+        self.pc = (hi << 8) | self.pop()
+        self.cycles += 4
+        if reti:
+            self.lvl0ex = False
+            self.irq_hold = True
+        self._leave()
+
+    def op_push(self, d):
+        self.push(self.r[d])
+        self.pc += 1
+        self.cycles += 1
+
+    def op_pop(self, d):
+        self.r[d] = self.pop()
+        self.pc += 1
+        self.cycles += 2
+
+    def _nvm_penalty(self, a):
+        return 1 if a >= MAPPED_FLASH or EEPROM_START <= a < EEPROM_START + EEPROM_SIZE else 0
+
+    def op_lds(self, d, a):
+        self.r[d] = self.read(a)
+        self.pc += 2
+        self.cycles += 3 + self._nvm_penalty(a)
+
+    def op_sts(self, d, a):
+        self.write(a, self.r[d])
+        self.pc += 2
+        self.cycles += 2
+
+    def op_ldst(self, d, ptr, step, q, store):
+        a = self.r[ptr] | (self.r[ptr + 1] << 8)
+        if step < 0:
+            a = (a - 1) & 0xFFFF
+        ea = (a + q) & 0xFFFF
+        if store:
+            self.write(ea, self.r[d])
+            self.cycles += 1
+        else:
+            self.r[d] = self.read(ea)
+            self.cycles += 2 + self._nvm_penalty(ea)
+        if step > 0:
+            a = (a + 1) & 0xFFFF
+        if step:
+            self.r[ptr], self.r[ptr + 1] = a & 0xFF, a >> 8
+        self.pc += 1
+
+    def op_lpm(self, d, inc):
+        z = self.r[30] | (self.r[31] << 8)
+        self.r[d] = self.flash[z] if z < len(self.flash) else 0
+        if inc:
+            z = (z + 1) & 0xFFFF
+            self.r[30], self.r[31] = z & 0xFF, z >> 8
+        self.pc += 1
+        self.cycles += 3
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Run AVR firmware in the ATtiny1626 simulator")
+    parser.add_argument("image", help="firmware ELF, or a listing with --listing")
+    parser.add_argument("--listing", action="store_true", help="image is an objdump -d listing")
+    parser.add_argument("--cycles", type=int, default=3_333_333, help="cycles to run (default 1 s)")
+    parser.add_argument("--uart", default="", help="characters to send over USART0")
+    parser.add_argument("--pot", type=int, default=0, help="ADC result (potentiometer)")
+    args = parser.parse_args(argv)
+
+    flash, symbols = (load_listing if args.listing else load_elf)(args.image)
+    sim = Avr(flash, symbols)
+    sim.adc_result = args.pot << 8 | args.pot
+    sim.boot()
+    sim.uart_send(args.uart.encode().decode("unicode_escape"), delay=100_000)
+    sim.run(max_cycles=args.cycles)
+    sys.stdout.write(sim.uart_out.decode("latin-1"))
+    sys.stdout.write("\n[%d cycles]\n" % sim.cycles)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Exact cycle counts for the firmware, measured in the AVRxt simulator.
+
+Usage: cycle_bench.py [firmware.elf] [--rounds 1,2,4,8] [--pot 0] [--json]
+
+Runs the built image (default .pio/build/QUTy/firmware.elf) in avrsim.py
+and plays a game over the UART: every step the game plays is answered with
+the matching '1'-'4', up to the longest requested round, then a wrong key
+ends the game and a name is entered. Reported, in CPU cycles at 3.333 MHz:
+
+  isr       every interrupt handler, from the interrupt response to RETI
+  play_tone each tone, called directly with interrupts off
+  handlers  each simon_state_t entry/exit/event action, and simon_task()
+  rounds    each requested round length, from SIMON_GENERATE to SUCCESS:
+            elapsed cycles, cycles inside simon_task() and inside ISRs
+
+Handler and task figures are inclusive of the functions they call and of
+any interrupt taken meanwhile; a tail call is counted in its caller. The
+numbers are deterministic, so two builds can be compared run for run.
+
+The game is followed through simon.c's static state and the entry action
+state_table holds for SIMON_GENERATE, checked against generate_entry
+before the game starts.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import avrsim  # noqa: E402
+
+DEFAULT_ELF = ".pio/build/QUTy/firmware.elf"
+SIMON_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include", "simon.h")
+
+F_CPU = avrsim.F_CPU
+# A player answering 10ms after the game starts waiting for input
+ANSWER_DELAY = F_CPU // 100
+# simon_state_handlers_t: entry, exit and on_event pointers, the events mask
+HANDLERS_SIZE = 7
+
+
+def simon_states(path=SIMON_H):
+    """simon_state_t names in enum order, read from simon.h."""
+    with open(path) as f:
+        text = f.read()
+    body = re.search(r"typedef enum \{(.*?)\}\s*simon_state_t;", text, re.S).group(1)
+    body = re.sub(r"//.*", "", body)
+    return [name.strip() for name in body.split(",") if name.strip()]
+
+
+class GameDriver:
+    """Answers the game over the UART while the simulator runs."""
+
+    def __init__(self, sim, states, longest):
+        self.sim = sim
+        self.states = states
+        self.longest = longest
+        self.state = None
+        self.sequence = []   # Tones played this round
+        self.answered = 0
+        self.rounds = {}     # length -> {elapsed, task, isr}
+        self.round_start = (0, 0, 0)
+        self.done = False
+        # Reached through state_table, by ICALL or a tail call's IJMP
+        generate = self._entry_action("SIMON_GENERATE")
+        if generate != sim.addr("generate_entry", "simon.c") // 2:
+            raise avrsim.SimError("state_table's SIMON_GENERATE entry is 0x%04x, not generate_entry;"
+                                  " has simon_state_handlers_t changed?" % (generate * 2))
+        sim.on_write[sim.addr("state", "simon.c")] = self._state_written
+        sim.on_call[generate] = self._generate
+        sim.on_call[sim.addr("play_tone") // 2] = self._play_tone
+
+    def _entry_action(self, name):
+        """Word address of state_table[name].entry."""
+        at = self.sim.addr("state_table", "simon.c") + self.states.index(name) * HANDLERS_SIZE
+        return self.sim.read(at) | (self.sim.read(at + 1) << 8)
+
+    def _totals(self):
+        profile = self.sim.profile
+        task = profile.get("simon_task", [0, 0])[1]
+        isr = sum(v[1] for k, v in profile.items() if k.startswith("ISR "))
+        return self.sim.cycles, task, isr
+
+    def _play_tone(self, sim):
+        if self.state == "SIMON_PLAY_ON":
+            self.sequence.append(sim.r[24])
+
+    def _generate(self, sim):
+        self.sequence = []
+        self.answered = 0
+        self.round_start = self._totals()
+
+    def _state_written(self, addr, value):
+        previous = self.state
+        self.state = self.states[value] if value < len(self.states) else str(value)
+        sim = self.sim
+        if self.state == "SIMON_GENERATE":
+            # A new game after the one we lost
+            self.done = previous in ("DISP_BLANK", "ENTER_NAME")
+        elif self.state == "AWAITING_INPUT":
+            length = len(self.sequence)
+            if self.answered >= length:
+                raise avrsim.SimError("input %d asked for after %d tones" % (self.answered + 1, length))
+            step = self.sequence[self.answered]
+            if length > self.longest:
+                step = (step + 1) % 4  # Lose on purpose
+            self.answered += 1
+            sim.uart_send("%d" % (step + 1), delay=ANSWER_DELAY)
+        elif self.state == "SUCCESS":
+            now = self._totals()
+            self.rounds[len(self.sequence)] = {
+                "elapsed": now[0] - self.round_start[0],
+                "task": now[1] - self.round_start[1],
+                "isr": now[2] - self.round_start[2],
+            }
+        elif self.state == "ENTER_NAME":
+            sim.uart_send("ab\n", delay=ANSWER_DELAY)
+
+
+def stats(entry):
+    calls, total, low, high = entry
+    return {"calls": calls, "min": low, "mean": round(total / calls, 1), "max": high}
+
+
+def bench(sim, lengths, pot):
+    states = simon_states()
+    sim.adc_result = pot << 8 | pot
+    sim.boot()
+    sim.profile = {}
+    driver = GameDriver(sim, states, max(lengths))
+
+    # Each step takes at most a few playback delays (2 s at full pot)
+    steps = max(lengths) * (max(lengths) + 1) // 2 + 2
+    budget = (steps * 3 + 20) * 2 * F_CPU
+    sim.run(max_cycles=budget, until=lambda: driver.done)
+    if not driver.done:
+        raise avrsim.SimError("game did not finish in %d cycles (stuck in %s)"
+                              % (budget, driver.state))
+
+    profile = sim.profile
+    handlers = {}
+    for name in sorted(profile):
+        if name == "simon_task" or name.endswith(("_entry", "_exit", "_event")):
+            handlers[name] = stats(profile[name])
+    isrs = {name[4:]: stats(v) for name, v in sorted(profile.items()) if name.startswith("ISR ")}
+
+    sim.profile = None
+    tones = {}
+    for tone in range(4):
+        cycles, _ = sim.call("play_tone", tone)
+        tones[tone] = cycles
+
+    rounds = {n: driver.rounds[n] for n in lengths if n in driver.rounds}
+    return {"isr": isrs, "play_tone": tones, "handlers": handlers, "rounds": rounds}
+
+
+def print_report(result, out=sys.stdout):
+    out.write("%-28s %6s %6s %8s %6s\n" % ("isr", "calls", "min", "mean", "max"))
+    for name, s in result["isr"].items():
+        out.write("%-28s %6d %6d %8.1f %6d\n" % (name, s["calls"], s["min"], s["mean"], s["max"]))
+    out.write("\n%-28s %6s\n" % ("play_tone", "cycles"))
+    for tone, cycles in result["play_tone"].items():
+        out.write("%-28s %6d\n" % ("tone %d" % tone, cycles))
+    out.write("\n%-28s %6s %6s %8s %6s\n" % ("handler", "calls", "min", "mean", "max"))
+    for name, s in result["handlers"].items():
+        out.write("%-28s %6d %6d %8.1f %6d\n" % (name, s["calls"], s["min"], s["mean"], s["max"]))
+    out.write("\n%-28s %10s %10s %10s\n" % ("round", "elapsed", "task", "isr"))
+    for length, r in result["rounds"].items():
+        out.write("%-28s %10d %10d %10d\n" % ("length %d" % length, r["elapsed"], r["task"], r["isr"]))
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", nargs="?", default=DEFAULT_ELF, help="firmware ELF")
+    parser.add_argument("--rounds", default="1,2,4,8", help="round lengths to report")
+    parser.add_argument("--pot", type=int, default=0, help="ADC result (0 = 250 ms playback)")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    args = parser.parse_args(argv)
+
+    lengths = sorted({int(n) for n in args.rounds.split(",")})
+    flash, symbols = avrsim.load_elf(args.elf)
+    result = bench(avrsim.Avr(flash, symbols), lengths, args.pot)
+    if args.json:
+        json.dump(result, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    else:
+        print_report(result)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
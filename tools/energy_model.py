@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Estimate energy per game from the firmware's health report ('H' command).
+
+Usage: energy_model.py serial.log [--volts 3.3] [--cpu-ma 1.0] ...
+
+Reads the last complete report in the log (built with HEALTH_ENERGY, see
+include/health.h) and splits the board's energy between CPU, buzzer and
+display, per game and per game state. Games are counted by entries to
+FAIL, so the report should cover whole games: send 'H' once before
+playing to clear the counters and once after.
+
+The main loop never sleeps, so idle passes draw active current. The
+savings section ranks candidate power optimisations by the energy each
+would save per game:
+  sleep when idle  idle time at --idle-ma (IDLE sleep) instead of --cpu-ma
+  display duty     segments lit for half as long (dimmer display)
+  shorter tones    tones cut to half their length
+The currents are estimates; measure the board and pass its figures.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from trace2json import load_state_names  # noqa: E402
+
+STATE_LINE = re.compile(r"HEALTH (\d+) (\d+) (\d+) (\d+) (\d+)$")
+
+
+def parse_report(lines):
+    """Return the last complete report as a dict, or None."""
+    report = None
+    current = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("HEALTH LOOP "):
+            current = dict(states={})
+            continue
+        if current is None:
+            continue
+        m = STATE_LINE.match(line)
+        if m:
+            state, entries, ms, _max_us, active_ms = (int(g) for g in m.groups())
+            current["states"][state] = dict(entries=entries, ms=ms, active_ms=active_ms)
+        elif line.startswith("HEALTH TONE "):
+            current["tone_ms"] = int(line.split()[2])
+        elif line.startswith("HEALTH DISPLAY "):
+            fields = line.split()
+            current["display_ms"] = int(fields[2])
+            current["segment_ms"] = int(fields[3])
+            report = current
+            current = None
+    return report
+
+
+def model(report, args, state_names):
+    """Energy in mJ by component and by state, for the whole report."""
+    mw = dict(cpu=args.volts * args.cpu_ma, idle=args.volts * args.idle_ma,
+              tone=args.volts * args.buzzer_ma,
+              segment=args.volts * args.segment_ma * args.display_duty)
+    parts = dict(cpu_active=0.0, cpu_idle=0.0)
+    per_state = []
+    total_ms = 0
+    idle_ms = 0
+    for state, s in sorted(report["states"].items()):
+        active = min(s["active_ms"], s["ms"])
+        idle = s["ms"] - active
+        total_ms += s["ms"]
+        idle_ms += idle
+        parts["cpu_active"] += active * mw["cpu"] / 1000
+        parts["cpu_idle"] += idle * mw["cpu"] / 1000
+        name = state_names.get(state, "STATE_%d" % state)
+        per_state.append((name, s["entries"], s["ms"], active, s["ms"] * mw["cpu"] / 1000))
+    parts["buzzer"] = report["tone_ms"] * mw["tone"] / 1000
+    parts["display"] = report["segment_ms"] * mw["segment"] / 1000
+    parts["board"] = total_ms * args.volts * args.board_ma / 1000
+
+    savings = {
+        "sleep when idle": idle_ms * (mw["cpu"] - mw["idle"]) / 1000,
+        "display duty": parts["display"] / 2,
+        "shorter tones": parts["buzzer"] / 2,
+    }
+    return parts, per_state, savings, total_ms
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="serial log containing an 'H' report")
+    parser.add_argument("--volts", type=float, default=3.3)
+    parser.add_argument("--cpu-ma", type=float, default=1.0,
+                        help="CPU running at 3.33 MHz (default 1.0)")
+    parser.add_argument("--idle-ma", type=float, default=0.4,
+                        help="CPU in IDLE sleep, peripherals running (default 0.4)")
+    parser.add_argument("--buzzer-ma", type=float, default=10.0,
+                        help="buzzer while a tone plays (default 10)")
+    parser.add_argument("--segment-ma", type=float, default=3.0,
+                        help="one LED segment while its digit is driven (default 3)")
+    parser.add_argument("--display-duty", type=float, default=0.5,
+                        help="fraction of the time each digit is driven (default 0.5)")
+    parser.add_argument("--board-ma", type=float, default=0.0,
+                        help="everything else, always on (default 0)")
+    args = parser.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        report = parse_report(f)
+    if report is None:
+        sys.exit("no complete HEALTH report with energy counters in %s" % args.log)
+
+    state_names = load_state_names()
+    fail = next((i for i, n in state_names.items() if n == "FAIL"), None)
+    games = report["states"].get(fail, {}).get("entries", 0)
+    parts, per_state, savings, total_ms = model(report, args, state_names)
+    total = sum(parts.values())
+    per = games if games else 1
+    unit = "mJ/game" if games else "mJ"
+
+    print("%d games, %.1f s" % (games, total_ms / 1000))
+    print("%-20s %10s %6s" % ("component", unit, "share"))
+    for name, mj in sorted(parts.items(), key=lambda p: -p[1]):
+        print("%-20s %10.2f %5.1f%%" % (name, mj / per, 100 * mj / total if total else 0))
+    print("%-20s %10.2f" % ("total", total / per))
+
+    print("\n%-20s %8s %10s %8s %10s" % ("state", "entries", "ms", "active", "cpu " + unit))
+    for name, entries, ms, active, mj in per_state:
+        print("%-20s %8d %10d %7.1f%% %10.2f" % (
+            name, entries, ms, 100 * active / ms if ms else 0, mj / per))
+
+    print("\n%-20s %10s %6s" % ("saving", unit, "of total"))
+    for name, mj in sorted(savings.items(), key=lambda s: -s[1]):
+        print("%-20s %10.2f %5.1f%%" % (name, mj / per, 100 * mj / total if total else 0))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Decode the firmware's main loop health frames ('M' command) to CSV.
+
+Usage: health_decode.py serial.log [-o health.csv]
+
+The serial log is read as raw bytes and may contain other output; frames
+are found by their mark and length and kept only if their CRC matches (see
+include/health.h for the layout). One row per frame: passes per second,
+mean and longest pass in microseconds, then entries and milliseconds for
+each game state, named from include/simon.h.
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from trace2json import load_state_names  # noqa: E402
+
+FRAME_MARK = 0x1F
+RTC_HZ = 32768
+
+
+def crc_ccitt_update(crc, data):
+    """avr-libc _crc_ccitt_update()."""
+    data ^= crc & 0xFF
+    data = (data ^ (data << 4)) & 0xFF
+    return (((data << 8) | (crc >> 8)) ^ (data >> 4) ^ (data << 3)) & 0xFFFF
+
+
+def find_frames(log, states):
+    """Yield the payload of each frame with a good CRC."""
+    size = 6 + 4 * states
+    i = 0
+    while True:
+        i = log.find(bytes([FRAME_MARK, size]), i)
+        if i < 0 or i + 2 + size + 2 > len(log):
+            return
+        body = log[i + 1:i + 2 + size]
+        crc = 0xFFFF
+        for b in body:
+            crc = crc_ccitt_update(crc, b)
+        if crc == struct.unpack_from("<H", log, i + 2 + size)[0]:
+            yield body[1:]
+            i += 2 + size + 2
+        else:
+            i += 1
+
+
+def decode(payload, states):
+    passes, second, longest = struct.unpack_from("<HHH", payload)
+    row = [
+        round(passes * RTC_HZ / second) if second else 0,
+        round(second * 1e6 / RTC_HZ / passes) if passes else 0,
+        round(longest * 1e6 / RTC_HZ),
+    ]
+    for s in range(states):
+        entries, time = struct.unpack_from("<HH", payload, 6 + 4 * s)
+        row += [entries, round(time * 1000 / 1024)]
+    return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="raw serial log containing health frames")
+    parser.add_argument("-o", "--output", help="output CSV file (default: stdout)")
+    args = parser.parse_args()
+
+    state_names = load_state_names()
+    if not state_names:
+        sys.exit("could not read the game states from include/simon.h")
+    states = len(state_names)
+
+    with open(args.log, "rb") as f:
+        log = f.read()
+    rows = [decode(p, states) for p in find_frames(log, states)]
+    if not rows:
+        sys.exit("no health frames found in %s" % args.log)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    header = ["passes_per_s", "mean_pass_us", "max_pass_us"]
+    for s in range(states):
+        header += [state_names[s] + "_entries", state_names[s] + "_ms"]
+    writer.writerow(header)
+    writer.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()
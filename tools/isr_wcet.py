@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+"""Static worst-case cycles and stack depth of every interrupt handler.
+
+Usage: isr_wcet.py [firmware.elf] [--listing] [--json] [--baseline old.json]
+                   [--strict]
+
+Decodes the image with avrsim.py, follows each __vector_N through its
+branches and calls, and takes the longest path using AVRxt instruction
+timings. Figures include the 3 cycle interrupt response, the JMP in the
+vector table and the RETI; stack depth includes the return address, pushes,
+the frame set up through SPL/SPH and the deepest callee. Loads through a
+pointer are counted as 3 cycles, as the pointer may reach mapped flash.
+
+Anything that stops the bound from being exact is flagged:
+  loop         a backward branch; its body is counted once, so the figure
+               is a lower bound (shown with a '+')
+  busy-wait    a loop that only polls an I/O register, e.g. uart_send()
+               waiting for DREIF; an ISR should never spin on hardware
+  indirect     ICALL/IJMP, whose targets are not followed
+  recursion    a call back into a function that is still on the path
+Each ISR also lists the functions it reaches, so a new call such as
+uart_print_high_scores() from the RX handler shows up in a diff of two
+reports. --baseline compares with a report saved by --json; --strict exits
+with status 1 if any ISR is flagged.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+import threading
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import avrsim  # noqa: E402
+
+DEFAULT_ELF = ".pio/build/QUTy/firmware.elf"
+
+# Interrupt response (PC pushed) and the vector table's JMP
+ENTRY_CYCLES = 3 + 3
+
+# Single-cycle instructions; everything else is timed in Analysis.edges()
+ONE_CYCLE = {"nop", "add", "sub", "subi", "logic", "logici", "mov", "movw", "ldi",
+             "unary", "bset", "bld_bst", "in", "out"}
+
+
+class Analysis:
+    def __init__(self, flash, symbols):
+        self.sim = avrsim.Avr(flash, symbols)
+        self.funcs = sorted((addr // 2, name) for name, (addr, kind) in symbols.items()
+                            if kind == "func")
+        self.starts = {word: name for word, name in reversed(self.funcs)}
+        self.memo = {}       # pc -> (cycles, stack, flags, callees)
+        self.active = set()  # pcs on the current path
+        self.frame = {}      # pc of an OUT to SPL -> bytes it allocates
+
+    def func_of(self, pc):
+        name = "?"
+        for word, n in self.funcs:
+            if word > pc:
+                break
+            name = n
+        return name
+
+    def where(self, pc):
+        return "%s+0x%x" % (self.func_of(pc), pc * 2 - self._start_of(pc) * 2)
+
+    def _start_of(self, pc):
+        start = 0
+        for word, _ in self.funcs:
+            if word > pc:
+                break
+            start = word
+        return start
+
+    def _scan_frames(self, entry):
+        """Find the frame size set up by the avr-gcc prologue (IN r28,SPL;
+        SBIW/SUBI+SBCI r28; OUT SPL,r28) and released by the epilogue."""
+        pc, adjust, end = entry, 0, len(self.sim.prog) - 1
+        while pc < end:
+            name, ops, words = self.sim.decode(pc)
+            if name == "in" and ops == (28, avrsim.SPL_ADDR):
+                adjust = 0
+            elif name == "adiw" and ops[0] == 28:
+                adjust = -ops[1] if not ops[2] else ops[1]
+            elif name == "subi" and ops[0] == 28 and not ops[2] and ops[3]:
+                adjust = ops[1]
+            elif name == "subi" and ops[0] == 29 and ops[2]:  # SBCI r29
+                adjust = (adjust & 0xFF) | ops[1] << 8
+                if adjust & 0x8000:
+                    adjust -= 0x10000
+            elif name == "out" and ops == (28, avrsim.SPL_ADDR):
+                self.frame.setdefault(pc, adjust)
+            elif name == "ret" or pc + words in self.starts:
+                break
+            pc += words
+
+    def edges(self, pc):
+        """[(cycles, next pc or None, stack change)], plus call target or
+        None and a flag for indirect control flow."""
+        name, ops, words = self.sim.decode(pc)
+        nxt = pc + words
+        if name in ONE_CYCLE:
+            if name == "out" and ops[1] == avrsim.SPL_ADDR:
+                return [(1, nxt, self.frame.get(pc, 0))], None, None
+            return [(1, nxt, 0)], None, None
+        if name in ("mul", "adiw"):
+            return [(2, nxt, 0)], None, None
+        if name in ("cpse", "sbrx") or (name == "bitio" and ops[2] in (1, 3)):
+            skip = self.sim.decode(nxt)[2]
+            return [(1, nxt, 0), (1 + skip, nxt + skip, 0)], None, None
+        if name == "bitio":
+            return [(1, nxt, 0)], None, None
+        if name == "branch":
+            return [(1, nxt, 0), (2, nxt + ops[2], 0)], None, None
+        if name == "rjmp":
+            return [(2, nxt + ops[0], 0)], None, None
+        if name == "jmp":
+            return [(3, ops[0], 0)], None, None
+        if name == "rcall":
+            if ops[0] == 0:  # RCALL .+0 reserves two bytes of frame
+                return [(2, nxt, 2)], None, None
+            return [(2, nxt, 0)], nxt + ops[0], None
+        if name == "call":
+            return [(3, nxt, 0)], ops[0], None
+        if name == "icall":
+            return [(2, nxt, 0)], None, "indirect call"
+        if name == "ijmp":
+            return [(2, None, 0)], None, "indirect jump"
+        if name == "ret":
+            return [(4, None, 0)], None, None
+        if name == "push":
+            return [(1, nxt, 1)], None, None
+        if name == "pop":
+            return [(2, nxt, -1)], None, None
+        if name == "lds":
+            nvm = ops[1] >= avrsim.MAPPED_FLASH or \
+                avrsim.EEPROM_START <= ops[1] < avrsim.EEPROM_START + avrsim.EEPROM_SIZE
+            return [(3 + nvm, nxt, 0)], None, None
+        if name == "sts":
+            return [(2, nxt, 0)], None, None
+        if name == "ldst":
+            return [(1 if ops[4] else 3, nxt, 0)], None, None
+        if name == "lpm":
+            return [(3, nxt, 0)], None, None
+        raise avrsim.SimError("no timing for %s at 0x%04x" % (name, pc * 2))
+
+    def reads_io(self, pc):
+        name, ops, _ = self.sim.decode(pc)
+        if name == "lds":
+            return ops[1] if ops[1] < avrsim.IO_END else None
+        if name == "in" and ops[1] not in (avrsim.SPL_ADDR, avrsim.SPH_ADDR, avrsim.SREG_ADDR):
+            return ops[1]
+        if name == "bitio" and ops[2] in (1, 3):
+            return ops[0]
+        return None
+
+    def writes(self, pc):
+        name, ops, _ = self.sim.decode(pc)
+        return name in ("sts", "push", "call", "rcall", "icall") or \
+            (name == "ldst" and ops[4]) or (name == "bitio" and ops[2] in (0, 2))
+
+    def function(self, entry):
+        """(cycles, stack, flags, callees) of a call to entry, from the
+        first instruction to its RET."""
+        if entry in self.active:
+            return 0, 0, {"recursion into %s" % self.func_of(entry)}, set()
+        self._scan_frames(entry)
+        return self.path(entry, [])
+
+    def path(self, pc, trail):
+        """Longest path from pc to the return of the function it is in."""
+        if pc in self.memo:
+            return self.memo[pc]
+        if pc in self.active:
+            if pc not in trail:  # Jumped back into a caller
+                return 0, 0, {"recursion into %s" % self.func_of(pc)}, set()
+            # Backward branch: report it once, at the loop head
+            body = trail[trail.index(pc):]
+            io = [self.reads_io(p) for p in body if self.reads_io(p) is not None]
+            if io and not any(self.writes(p) for p in body):
+                flag = "busy-wait at %s on 0x%04x" % (self.where(pc), io[0])
+            else:
+                flag = "loop at %s" % self.where(pc)
+            return 0, 0, {flag}, set()
+
+        self.active.add(pc)
+        trail.append(pc)
+        outs, target, indirect = self.edges(pc)
+        flags = {"%s at %s" % (indirect, self.where(pc))} if indirect else set()
+        callees = set()
+        call_cycles = call_stack = 0
+        if target is not None:
+            callees.add(self.func_of(target))
+            c, s, f, sub = self.function(target)
+            call_cycles, call_stack = c, 2 + s
+            flags |= f
+            callees |= sub
+
+        cycles = stack = 0
+        for cost, nxt, delta in outs:
+            c = s = 0
+            if nxt is not None:
+                c, s, f, sub = self.path(nxt, trail)
+                flags |= f
+                callees |= sub
+            cycles = max(cycles, cost + call_cycles + c)
+            stack = max(stack, call_stack, delta + s, delta)
+
+        trail.pop()
+        self.active.discard(pc)
+        result = self.memo[pc] = (cycles, max(stack, 0), flags, callees)
+        return result
+
+    def isrs(self):
+        report = {}
+        for word, name in self.funcs:
+            m = re.match(r"__vector_(\d+)$", name)
+            if not m:
+                continue
+            vec = int(m.group(1))
+            cycles, stack, flags, callees = self.function(word)
+            report["%d %s" % (vec, avrsim.VECTORS.get(vec, "?"))] = {
+                "cycles": ENTRY_CYCLES + cycles,
+                "stack": 2 + stack,
+                "bounded": not any(f.startswith(("loop", "busy-wait", "recursion",
+                                                 "indirect")) for f in flags),
+                "flags": sorted(flags),
+                "calls": sorted(callees),
+            }
+        return dict(sorted(report.items(), key=lambda kv: int(kv[0].split()[0])))
+
+
+def print_report(report, baseline=None, out=sys.stdout):
+    out.write("%-24s %9s %6s\n" % ("isr", "cycles", "stack"))
+    for name, r in report.items():
+        cycles = "%d%s" % (r["cycles"], "" if r["bounded"] else "+")
+        line = "%-24s %9s %6d" % (name, cycles, r["stack"])
+        old = (baseline or {}).get(name)
+        if old:
+            line += "   (%+d cycles, %+d stack)" % (r["cycles"] - old["cycles"],
+                                                    r["stack"] - old["stack"])
+        elif baseline is not None:
+            line += "   (new)"
+        out.write(line + "\n")
+        for flag in r["flags"]:
+            out.write("    ! %s\n" % flag)
+        if r["calls"]:
+            out.write("    calls: %s\n" % " ".join(r["calls"]))
+        if old:
+            for added in sorted(set(r["calls"]) - set(old["calls"])):
+                out.write("    + now calls %s\n" % added)
+            for flag in sorted(set(r["flags"]) - set(old["flags"])):
+                out.write("    + new flag: %s\n" % flag)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", nargs="?", default=DEFAULT_ELF,
+                        help="firmware ELF, or a listing with --listing")
+    parser.add_argument("--listing", action="store_true", help="image is an objdump -d listing")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    parser.add_argument("--baseline", help="JSON report of an earlier build to compare with")
+    parser.add_argument("--strict", action="store_true", help="exit 1 if any ISR is flagged")
+    args = parser.parse_args(argv)
+
+    flash, symbols = (avrsim.load_listing if args.listing else avrsim.load_elf)(args.image)
+    result = {}
+
+    def analyse():
+        result["report"] = Analysis(flash, symbols).isrs()
+
+    # The path search recurses once per instruction on the longest path
+    sys.setrecursionlimit(100_000)
+    threading.stack_size(256 << 20)
+    worker = threading.Thread(target=analyse)
+    worker.start()
+    worker.join()
+    report = result["report"]
+
+    if args.json:
+        json.dump(report, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    else:
+        baseline = None
+        if args.baseline:
+            with open(args.baseline) as f:
+                baseline = json.load(f)
+        print_report(report, baseline)
+    if args.strict and any(r["flags"] for r in report.values()):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
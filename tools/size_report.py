@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Break firmware flash and SRAM use down by module, and enforce headroom.
+
+Usage: size_report.py firmware.map [--ram 2048] [--flash 16384]
+                      [--sram-headroom 256] [--flash-headroom 0]
+
+Reads the GNU ld map file written at link time and sums the input sections
+of each object file (simon.c, uart.c, ...; library members are grouped by
+library) into the flash and SRAM output sections. SRAM headroom is what is
+left for the stack once .data, .bss and .noinit are placed; the exit status
+is 1 if it, or the flash headroom, is below the threshold.
+
+Also works as a PlatformIO extra script (see platformio.ini): it adds
+-Wl,-Map to the link, prints the report after every link and fails the
+build on a headroom violation. Thresholds come from the environment options
+custom_sram_headroom and custom_flash_headroom. The stack is painted at boot
+(stackmon.c), so the 'S' command shows how much of the headroom is used.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# Output sections and the memories they occupy. .data lives in SRAM and
+# its initial values are copied from flash.
+FLASH_SECTIONS = (".text", ".rodata", ".data")
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+
+# ATtiny1626
+DEFAULT_RAM = 2048
+DEFAULT_FLASH = 16384
+DEFAULT_SRAM_HEADROOM = 256
+
+INPUT_RE = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+CONT_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+OUTPUT_RE = re.compile(r"^(\.\S+)")
+
+
+def module_name(path):
+    """simon.c for .pio/build/QUTy/src/simon.c.o, libc.a for libc.a(x.o)."""
+    path = path.strip()
+    lib = re.match(r"(.*\.a)\(.*\)$", path)
+    if lib:
+        return os.path.basename(lib.group(1))
+    name = os.path.basename(path)
+    return name[:-2] if name.endswith(".o") else name
+
+
+def parse_map(path):
+    """Return {module: {output_section: bytes}} for the placed sections."""
+    modules = {}
+    with open(path, errors="replace") as f:
+        lines = f.read().splitlines()
+
+    # Sections listed before the memory map were discarded (gc-sections)
+    try:
+        start = lines.index("Linker script and memory map") + 1
+    except ValueError:
+        start = 0
+
+    output = None
+    pending = None  # Input section whose address/size wrapped to the next line
+    for line in lines[start:]:
+        m = OUTPUT_RE.match(line)
+        if m:
+            output = m.group(1)
+            pending = None
+            continue
+        if output not in FLASH_SECTIONS + RAM_SECTIONS:
+            continue
+
+        m = INPUT_RE.match(line)
+        if m:
+            name, size, obj = m.group(1), int(m.group(3), 16), m.group(4)
+        elif pending:
+            m = CONT_RE.match(line)
+            pending, name = None, pending
+            if not m:
+                continue
+            size, obj = int(m.group(2), 16), m.group(3)
+        else:
+            m = re.match(r"^ (\.\S+|COMMON)$", line)
+            pending = m.group(1) if m else None
+            continue
+
+        # Symbol lines and linker fill have no object file
+        if size == 0 or name == "*fill*" or not obj.endswith((".o", ")")):
+            continue
+        sections = modules.setdefault(module_name(obj), {})
+        sections[output] = sections.get(output, 0) + size
+    return modules
+
+
+def report(modules, ram, flash, sram_headroom, flash_headroom, out=sys.stdout):
+    """Print the per-module table; return False if a threshold is crossed."""
+    rows = []
+    for name, sections in modules.items():
+        f = sum(sections.get(s, 0) for s in FLASH_SECTIONS)
+        r = sum(sections.get(s, 0) for s in RAM_SECTIONS)
+        rows.append((name, f, r))
+    rows.sort(key=lambda row: (-row[2], -row[1], row[0]))
+
+    out.write("%-24s %7s %7s\n" % ("module", "flash", "sram"))
+    for name, f, r in rows:
+        out.write("%-24s %7d %7d\n" % (name, f, r))
+    flash_used = sum(row[1] for row in rows)
+    ram_used = sum(row[2] for row in rows)
+    out.write("%-24s %7d %7d\n" % ("total", flash_used, ram_used))
+
+    ok = True
+    for label, size, used, minimum in (("SRAM", ram, ram_used, sram_headroom),
+                                       ("Flash", flash, flash_used, flash_headroom)):
+        left = size - used
+        out.write("%s: %d of %d bytes used, %d free (minimum %d)\n"
+                  % (label, used, size, left, minimum))
+        if left < minimum:
+            out.write("error: %s headroom %d is below %d bytes\n" % (label, left, minimum))
+            ok = False
+    return ok
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="GNU ld map file")
+    parser.add_argument("--ram", type=int, default=DEFAULT_RAM)
+    parser.add_argument("--flash", type=int, default=DEFAULT_FLASH)
+    parser.add_argument("--sram-headroom", type=int, default=DEFAULT_SRAM_HEADROOM)
+    parser.add_argument("--flash-headroom", type=int, default=0)
+    args = parser.parse_args(argv)
+    ok = report(parse_map(args.map), args.ram, args.flash,
+                args.sram_headroom, args.flash_headroom)
+    return 0 if ok else 1
+
+
+def pio_setup(env):
+    map_file = "$BUILD_DIR/${PROGNAME}.map"
+    env.Append(LINKFLAGS=["-Wl,-Map," + map_file])
+
+    board = env.BoardConfig()
+    ram = int(board.get("upload.maximum_ram_size", DEFAULT_RAM))
+    flash = int(board.get("upload.maximum_size", DEFAULT_FLASH))
+    sram_headroom = int(env.GetProjectOption("custom_sram_headroom", DEFAULT_SRAM_HEADROOM))
+    flash_headroom = int(env.GetProjectOption("custom_flash_headroom", 0))
+
+    def size_report(target, source, env):
+        modules = parse_map(env.subst(map_file))
+        if not report(modules, ram, flash, sram_headroom, flash_headroom):
+            return 1
+        return 0
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report)
+
+
+if "Import" in globals():
+    Import("env")  # noqa: F821 (provided by SCons)
+    pio_setup(env)  # noqa: F821
+elif __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Automated player for turbo tempo soak tests.
+
+Usage: soak_player.py [port] [--length 20] [--games 0] [--delay 8]
+                      [--seed 12236632] [--report 60]
+
+Switches the board to turbo tempo ('Z'), sets the seed and resets the game,
+then plays it over the UART: every round is answered from the firmware's
+LFSR, up to --length rounds, after which a wrong key ends the game (a name
+is entered if the leaderboard asks for one) and the next game continues
+from the chained seed. --delay must match SIMON_TURBO_DELAY_MS.
+
+The game only reports SUCCESS and GAME OVER, so presses are paced from
+those lines: one press may be sent ahead (the firmware keeps the latest
+UART button until it awaits input), the next only once the previous one
+has been taken. A round that ends differently from what the player expects
+is counted as a desync and play resumes from what the board reported.
+Every --report seconds, and at the end, the board's 'z' counters are
+printed alongside the player's own.
+"""
+
+import argparse
+import os
+import queue
+import sys
+import termios
+import threading
+import time
+import tty
+
+DEFAULT_PORT = "/dev/ttyACM0"
+
+# Must match simon.c
+LFSR_MASK = 0xE2025CAB
+INITIAL_SEED = 0x12236632
+
+# Allowance for USB latency and the 9600 baud line
+MARGIN_S = 0.03
+
+
+def lfsr_steps(seed, count):
+    """First count steps (0-3) from seed, and the LFSR state after them."""
+    steps = []
+    state = seed
+    for _ in range(count):
+        bit = state & 1
+        state >>= 1
+        if bit:
+            state ^= LFSR_MASK
+        steps.append(state & 3)
+    return steps, state
+
+
+class Port:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            tty.setraw(self.fd)
+            attrs = termios.tcgetattr(self.fd)
+            attrs[4] = attrs[5] = termios.B9600
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.lines = queue.Queue()
+        threading.Thread(target=self._reader, daemon=True).start()
+
+    def _reader(self):
+        pending = b""
+        while True:
+            data = os.read(self.fd, 256)
+            if not data:
+                break
+            pending += data
+            # The name prompt has no newline
+            pending = pending.replace(b"Enter name: ", b"Enter name:\n")
+            *done, pending = pending.split(b"\n")
+            for line in done:
+                self.lines.put(line.decode("ascii", "replace").strip())
+
+    def send(self, text):
+        os.write(self.fd, text.encode("ascii"))
+
+    def expect(self, prefixes, timeout):
+        """Next line starting with one of prefixes (and the line after it
+        for SUCCESS and GAME OVER), or None on timeout."""
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                line = self.lines.get(timeout=max(0.0, deadline - time.monotonic()))
+            except queue.Empty:
+                return None, None
+            if line.startswith(prefixes):
+                if line in ("SUCCESS", "GAME OVER"):
+                    try:
+                        return line, int(self.lines.get(timeout=1.0))
+                    except (queue.Empty, ValueError):
+                        return line, None
+                return line, None
+
+    def drain(self):
+        while not self.lines.empty():
+            self.lines.get_nowait()
+
+
+class Player:
+    def __init__(self, port, args):
+        self.port = port
+        self.delay = args.delay / 1000
+        self.length = args.length
+        self.seed = args.seed
+        self.rounds = 0
+        self.games = 0
+        self.desyncs = 0
+        self.start = time.monotonic()
+
+    def play_round(self, n):
+        """Answer round n; True if it ended as expected."""
+        steps, _ = lfsr_steps(self.seed, n)
+        lose = n > self.length
+        if lose:
+            steps[-1] = (steps[-1] + 1) % 4
+        # The first press waits in the firmware through SUCCESS and playback
+        self.port.send(str(steps[0] + 1))
+        time.sleep(self.delay * (n + 1) + MARGIN_S)
+        for step in steps[1:]:
+            time.sleep(self.delay / 2 + MARGIN_S)
+            self.port.send(str(step + 1))
+
+        result, reached = self.port.expect(("SUCCESS", "GAME OVER"), 5 + n * self.delay * 3)
+        self.rounds += 1
+        expected = "GAME OVER" if lose else "SUCCESS"
+        if result == expected and reached == n:
+            return True
+        self.desyncs += 1
+        sys.stderr.write("round %d: expected %s, got %s %s\n" % (n, expected, result, reached))
+        return False
+
+    def finish_game(self, n):
+        """After GAME OVER at round n, enter a name if asked; the next game
+        starts from the chained seed."""
+        _, self.seed = lfsr_steps(self.seed, n)
+        prompt, _ = self.port.expect(("Enter name",), self.delay * 3 + 0.5)
+        if prompt:
+            self.port.send("soak\n")
+            time.sleep(0.5)  # High score table
+        self.port.drain()
+        self.games += 1
+
+    def report(self):
+        elapsed = time.monotonic() - self.start
+        self.port.drain()
+        self.port.send("z")
+        line, _ = self.port.expect(("TURBO",), 2)
+        sys.stdout.write("%.0fs games %d rounds %d (%.0f/h) desyncs %d | %s\n"
+                         % (elapsed, self.games, self.rounds,
+                            self.rounds * 3600 / elapsed if elapsed else 0,
+                            self.desyncs, line or "no TURBO reply"))
+        sys.stdout.flush()
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", nargs="?", default=DEFAULT_PORT, help="serial device")
+    parser.add_argument("--length", type=int, default=20, help="rounds won before losing on purpose")
+    parser.add_argument("--games", type=int, default=0, help="games to play (0 = until interrupted)")
+    parser.add_argument("--delay", type=int, default=8, help="SIMON_TURBO_DELAY_MS of the build")
+    parser.add_argument("--seed", type=lambda s: int(s, 16), default=INITIAL_SEED,
+                        help="first game's seed in hex")
+    parser.add_argument("--report", type=float, default=60, help="seconds between reports")
+    args = parser.parse_args(argv)
+
+    port = Port(args.port)
+    player = Player(port, args)
+    # Turbo on (it toggles, so check), seed, reset
+    port.send("z")
+    line, _ = port.expect(("TURBO",), 2)
+    if line is None:
+        sys.stderr.write("no reply to 'z' (built with SIMON_TURBO=0?)\n")
+        return 1
+    if line.split()[1] != "1":
+        port.send("Z")
+    port.send("9%08x" % args.seed)
+    time.sleep(0.05)
+    port.send("0")
+    time.sleep(0.1)
+    port.drain()
+
+    last_report = time.monotonic()
+    try:
+        while not args.games or player.games < args.games:
+            n = 1
+            while True:
+                ok = player.play_round(n)
+                if not ok or n > args.length:
+                    break
+                n += 1
+            if ok:
+                player.finish_game(n)
+            else:
+                # Start over from a known seed and game
+                time.sleep(1)
+                port.send("9%08x" % player.seed)
+                time.sleep(0.05)
+                port.send("0")
+                time.sleep(0.1)
+                port.drain()
+            if time.monotonic() - last_report >= args.report:
+                player.report()
+                last_report = time.monotonic()
+    except KeyboardInterrupt:
+        pass
+    player.report()
+    return 1 if player.desyncs else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Convert a firmware trace dump ('T' command) to Chrome trace JSON.
+
+Usage: trace2json.py serial.log [-o trace.json]
+
+The serial log may contain other output; every block between a
+"TRACE <count>" line and the following "END" line is converted. Open the
+result in chrome://tracing or https://ui.perfetto.dev.
+
+Timestamps are the firmware's RTC count (32.768 kHz), extended to 32 bits
+by its overflow interrupt, so they need no unwrapping.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+TRACE_STATE = 1
+TRACE_INPUT = 2
+TRACE_TONE_START = 3
+TRACE_TONE_STOP = 4
+TRACE_UART_CMD = 5
+
+TONE_NAMES = ["E(high)", "C#", "A", "E(low)"]
+
+SIMON_H = os.path.join(os.path.dirname(__file__), "..", "include", "simon.h")
+
+
+def load_state_names(path=SIMON_H):
+    """Read the simon_state_t enumerators so names track the firmware."""
+    try:
+        with open(path) as f:
+            text = f.read()
+    except OSError:
+        return {}
+    body = re.search(r"typedef enum\s*{(.*?)}\s*simon_state_t;", text, re.S)
+    if not body:
+        return {}
+    names = re.findall(r"^\s*([A-Z_]+)\s*,?", body.group(1), re.M)
+    return dict(enumerate(names))
+
+
+RTC_HZ = 32768
+
+
+def parse_blocks(lines):
+    """Yield lists of (rtc count, type, arg) for each dumped block."""
+    block = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE "):
+            block = []
+        elif line == "END" and block is not None:
+            yield block
+            block = None
+        elif block is not None:
+            fields = line.split()
+            if len(fields) == 3 and all(f.isdigit() for f in fields):
+                block.append(tuple(int(f) for f in fields))
+
+
+def to_us(records):
+    """Turn RTC counts into microseconds."""
+    for count, kind, arg in records:
+        yield count * 1000000 // RTC_HZ, kind, arg
+
+
+def convert(block, state_names, pid):
+    events = []
+    open_state = None
+    open_tone = None
+    end_us = 0
+    for ts, kind, arg in to_us(block):
+        end_us = ts
+        if kind == TRACE_STATE:
+            if open_state is not None:
+                events.append(dict(ph="E", name=open_state, ts=ts, pid=pid, tid=1))
+            open_state = state_names.get(arg, "STATE_%d" % arg)
+            events.append(dict(ph="B", name=open_state, ts=ts, pid=pid, tid=1))
+        elif kind == TRACE_TONE_START:
+            if open_tone is not None:
+                events.append(dict(ph="E", name=open_tone, ts=ts, pid=pid, tid=2))
+            open_tone = TONE_NAMES[arg] if arg < len(TONE_NAMES) else "tone %d" % arg
+            events.append(dict(ph="B", name=open_tone, ts=ts, pid=pid, tid=2))
+        elif kind == TRACE_TONE_STOP:
+            if open_tone is not None:
+                events.append(dict(ph="E", name=open_tone, ts=ts, pid=pid, tid=2))
+                open_tone = None
+        elif kind == TRACE_INPUT:
+            events.append(dict(ph="i", s="t", name="S%d" % arg, ts=ts, pid=pid, tid=3))
+        elif kind == TRACE_UART_CMD:
+            name = "'%s'" % chr(arg) if 32 <= arg < 127 else "0x%02x" % arg
+            events.append(dict(ph="i", s="t", name=name, ts=ts, pid=pid, tid=4))
+    # Close anything still open at the end of the dump
+    if open_state is not None:
+        events.append(dict(ph="E", name=open_state, ts=end_us, pid=pid, tid=1))
+    if open_tone is not None:
+        events.append(dict(ph="E", name=open_tone, ts=end_us, pid=pid, tid=2))
+
+    for tid, name in ((1, "state"), (2, "tone"), (3, "buttons"), (4, "uart")):
+        events.append(dict(ph="M", name="thread_name", pid=pid, tid=tid, args=dict(name=name)))
+    events.append(dict(ph="M", name="process_name", pid=pid, args=dict(name="dump %d" % pid)))
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="serial log containing one or more trace dumps")
+    parser.add_argument("-o", "--output", help="output JSON file (default: stdout)")
+    args = parser.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        blocks = list(parse_blocks(f))
+    if not blocks:
+        sys.exit("no TRACE ... END block found in %s" % args.log)
+
+    state_names = load_state_names()
+    events = []
+    for pid, block in enumerate(blocks, 1):
+        events.extend(convert(block, state_names, pid))
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    json.dump(dict(traceEvents=events, displayTimeUnit="ms"), out, indent=1)
+    out.write("\n")
+
+
+if __name__ == "__main__":
+    main()